@@ -0,0 +1,36 @@
+# Generates one translation unit per field count, each building an `HMap` with
+# that many fields (given in reverse order, so they all need sorting) and looking
+# up every one of them, then times compiling each with `compile-timer`.
+#
+# Expects: TIMER, CXX, INCLUDE_DIR, WORK_DIR, and FIELDS (a comma-separated list).
+
+string(REPLACE "," ";" FIELDS "${FIELDS}")
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(TYPES "int" "double" "std::string" "char")
+
+foreach(N ${FIELDS})
+	set(VALUES "")
+	set(LOOKUPS "")
+	math(EXPR LAST "${N} - 1")
+	foreach(I RANGE ${LAST})
+		math(EXPR J "${LAST} - ${I}")
+		math(EXPR T "${J} % 4")
+		list(GET TYPES ${T} TYPE)
+		if(NOT I EQUAL 0)
+			string(APPEND VALUES ",")
+		endif()
+		string(APPEND VALUES "\n\t\t(TK(\"field${J}\",${TYPE}), ${TYPE}())")
+		string(APPEND LOOKUPS "\tstatic_cast<void>(myMap[TK(\"field${J}\",${TYPE})]);\n")
+	endforeach()
+	set(SOURCE ${WORK_DIR}/hmap-${N}.cc)
+	file(WRITE ${SOURCE} "#include <hmap/hmap.hpp>\n#include <string>\n\nint main() {\n\tauto myMap = make_hmap(${VALUES});\n${LOOKUPS}\treturn 0;\n}\n")
+	execute_process(COMMAND ${TIMER} ${CXX} -std=c++17 -I${INCLUDE_DIR} -c ${SOURCE} -o ${WORK_DIR}/hmap-${N}.o
+	                OUTPUT_VARIABLE RESULT
+	                ERROR_VARIABLE ERRORS
+	                RESULT_VARIABLE FAILED
+	                OUTPUT_STRIP_TRAILING_WHITESPACE)
+	if(FAILED)
+		message(FATAL_ERROR "Compiling ${N} fields failed:\n${ERRORS}")
+	endif()
+	message(STATUS "${N} fields: ${RESULT}")
+endforeach()
@@ -0,0 +1,57 @@
+/************************************************************************************
+ * @file compile-timer.cc Runs a command (typically, a compiler invocation), then
+ * reports its wall-clock time and peak resident memory. Used by the
+ * `hmap-compile-bench` target.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+int main(int argc, char* argv[]) {
+	if(argc < 2) {
+		std::fprintf(stderr, "Usage: %s command [args...]\n", argv[0]);
+		return 2;
+	}
+	const auto start = std::chrono::steady_clock::now();
+	const pid_t child = fork();
+	if(child < 0) {
+		std::perror("fork");
+		return 2;
+	} else if(child == 0) {
+		execvp(argv[1], argv + 1);
+		std::perror("execvp");
+		_exit(127);
+	}
+	int status = 0;
+	struct rusage usage = {};
+	if(wait4(child, &status, 0, &usage) < 0) {
+		std::perror("wait4");
+		return 2;
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	// `ru_maxrss` is in KiB on Linux (and bytes on macOS).
+	std::printf("%.3f s, %ld KiB peak\n", elapsed.count(), static_cast<long>(usage.ru_maxrss));
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,350 @@
+/************************************************************************************
+ * @file hmap-bench.cc Runtime benchmarks (Google Benchmark) of the dynamic and
+ * static maps, against `std::unordered_map<std::string, std::any>` and hand-written
+ * structs. Every benchmark also reports heap allocations per iteration ("allocs").
+ * Built by the `hmap-bench` target.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <hmap/hmap.hpp>
+#include <hmap/dynamic-hmap.hpp>
+
+#include <any>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+	std::atomic<std::size_t> allocations{0};
+}
+
+// `countedAlloc` and `countedFree` are kept out of line: once `malloc` and `free` are inlined into
+// `operator new` and `operator delete`, and those into their callers, GCC flags the pair as mismatched.
+namespace {
+	/// Count, then make, one heap allocation, aligned to `align` if it is stricter than `malloc`'s. @return `nullptr` on failure.
+	[[gnu::noinline]] void* countedAlloc(std::size_t n, std::size_t align = 0) {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		n = n ? n : 1;
+		if(align > alignof(std::max_align_t)) {
+			// `aligned_alloc` requires a multiple of the alignment.
+			return std::aligned_alloc(align, (n + align - 1) / align * align);
+		}
+		return std::malloc(n);
+	}
+	/// Release an allocation made by `countedAlloc`.
+	[[gnu::noinline]] void countedFree(void *p) {
+		std::free(p);
+	}
+}
+
+// Count every heap allocation in the process, including over-aligned and non-throwing ones
+// (the array forms forward to these).
+void* operator new(std::size_t n) {
+	if(void *p = countedAlloc(n)) {
+		return p;
+	}
+	detail::fail(std::bad_alloc());
+}
+void* operator new(std::size_t n, std::align_val_t align) {
+	if(void *p = countedAlloc(n, std::size_t(align))) {
+		return p;
+	}
+	detail::fail(std::bad_alloc());
+}
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept {
+	return countedAlloc(n);
+}
+void* operator new(std::size_t n, std::align_val_t align, const std::nothrow_t&) noexcept {
+	return countedAlloc(n, std::size_t(align));
+}
+void operator delete(void *p) noexcept {
+	countedFree(p);
+}
+void operator delete(void *p, std::size_t) noexcept {
+	countedFree(p);
+}
+void operator delete(void *p, std::align_val_t) noexcept {
+	countedFree(p);
+}
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+	countedFree(p);
+}
+void operator delete(void *p, const std::nothrow_t&) noexcept {
+	countedFree(p);
+}
+void operator delete(void *p, std::align_val_t, const std::nothrow_t&) noexcept {
+	countedFree(p);
+}
+
+namespace {
+	/// Reports the allocations made while it is alive as the "allocs" counter, per iteration.
+	class AllocationCounter {
+		benchmark::State &state_;
+		const std::size_t start_;
+
+	  public:
+		explicit AllocationCounter(benchmark::State &state)
+		: state_(state), start_(allocations.load(std::memory_order_relaxed)) {}
+		~AllocationCounter() {
+			state_.counters["allocs"] = benchmark::Counter(double(allocations.load(std::memory_order_relaxed) - start_), benchmark::Counter::kAvgIterations);
+		}
+	};
+
+	/// Sizes from 8 to 100k keys.
+	void Sizes(benchmark::internal::Benchmark *b) {
+		b->RangeMultiplier(8)->Range(8, 100000);
+	}
+
+	std::vector<std::string> names(std::size_t n) {
+		std::vector<std::string> result;
+		result.reserve(n);
+		for(std::size_t i = 0; i < n; ++i) {
+			result.push_back("key." + std::to_string(i));
+		}
+		return result;
+	}
+
+	std::vector<detail::Key<int> > keys(std::size_t n) {
+		std::vector<detail::Key<int> > result;
+		result.reserve(n);
+		for(const std::string &name : names(n)) {
+			result.emplace_back(name);
+		}
+		return result;
+	}
+
+	template<typename Map>
+	Map filled(const std::vector<detail::Key<int> > &ks) {
+		Map m;
+		for(std::size_t i = 0; i < ks.size(); ++i) {
+			m[ks[i]] = int(i);
+		}
+		return m;
+	}
+
+	std::unordered_map<std::string, std::any> filledBaseline(const std::vector<std::string> &ns) {
+		std::unordered_map<std::string, std::any> m;
+		for(std::size_t i = 0; i < ns.size(); ++i) {
+			m[ns[i]] = int(i);
+		}
+		return m;
+	}
+
+	template<typename Map>
+	void BM_Insert(benchmark::State &state) {
+		const auto ks = keys(state.range(0));
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			Map m;
+			for(std::size_t i = 0; i < ks.size(); ++i) {
+				m.insert_or_assign(ks[i], int(i));
+			}
+			benchmark::DoNotOptimize(m);
+		}
+		state.SetItemsProcessed(state.iterations() * ks.size());
+	}
+
+	template<typename Map>
+	void BM_Find(benchmark::State &state) {
+		const auto ks = keys(state.range(0));
+		const Map m = filled<Map>(ks);
+		std::size_t i = 0;
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(m(ks[i]));
+			i = (i + 1 == ks.size()) ? 0 : i + 1;
+		}
+	}
+
+	template<typename Map>
+	void BM_Subscript(benchmark::State &state) {
+		const auto ks = keys(state.range(0));
+		Map m = filled<Map>(ks);
+		std::size_t i = 0;
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(m[ks[i]] += 1);
+			i = (i + 1 == ks.size()) ? 0 : i + 1;
+		}
+	}
+
+	template<typename Map>
+	void BM_MultiFind(benchmark::State &state) {
+		const auto ks = keys(state.range(0));
+		const Map m = filled<Map>(ks);
+		const std::size_t n = ks.size();
+		std::size_t i = 0;
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(m(Map::multi, ks[i], ks[(i + n / 3) % n], ks[(i + 2 * n / 3) % n]));
+			i = (i + 1 == n) ? 0 : i + 1;
+		}
+	}
+
+	/// Move an entry out of the map and back in.
+	template<typename Map>
+	void BM_ExtractInsert(benchmark::State &state) {
+		const auto ks = keys(state.range(0));
+		Map m = filled<Map>(ks);
+		std::size_t i = 0;
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			m.insert(m.extract(ks[i]), ks[i]);
+			i = (i + 1 == ks.size()) ? 0 : i + 1;
+		}
+	}
+
+	template<typename Map>
+	void BM_Copy(benchmark::State &state) {
+		const Map m = filled<Map>(keys(state.range(0)));
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			Map copy(m);
+			benchmark::DoNotOptimize(copy);
+		}
+		state.SetItemsProcessed(state.iterations() * m.size());
+	}
+
+	void BM_BaselineInsert(benchmark::State &state) {
+		const auto ns = names(state.range(0));
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			std::unordered_map<std::string, std::any> m;
+			for(std::size_t i = 0; i < ns.size(); ++i) {
+				m.insert_or_assign(ns[i], int(i));
+			}
+			benchmark::DoNotOptimize(m);
+		}
+		state.SetItemsProcessed(state.iterations() * ns.size());
+	}
+
+	void BM_BaselineFind(benchmark::State &state) {
+		const auto ns = names(state.range(0));
+		const auto m = filledBaseline(ns);
+		std::size_t i = 0;
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			const auto found = m.find(ns[i]);
+			benchmark::DoNotOptimize(std::any_cast<int>(&found->second));
+			i = (i + 1 == ns.size()) ? 0 : i + 1;
+		}
+	}
+
+	void BM_BaselineSubscript(benchmark::State &state) {
+		const auto ns = names(state.range(0));
+		auto m = filledBaseline(ns);
+		std::size_t i = 0;
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(*std::any_cast<int>(&m[ns[i]]) += 1);
+			i = (i + 1 == ns.size()) ? 0 : i + 1;
+		}
+	}
+
+	void BM_BaselineCopy(benchmark::State &state) {
+		const auto m = filledBaseline(names(state.range(0)));
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			auto copy(m);
+			benchmark::DoNotOptimize(copy);
+		}
+		state.SetItemsProcessed(state.iterations() * m.size());
+	}
+
+	/// The hand-written equivalent of the static maps below, and the floor for any lookup.
+	struct HandWritten {
+		int foo;
+		double bar;
+		std::string baz;
+		char bang;
+	};
+
+	void BM_StructConstruct(benchmark::State &state) {
+		int i = 0;
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			HandWritten s{i++, 2., "short", 'b'};
+			benchmark::DoNotOptimize(s);
+		}
+	}
+
+	void BM_StaticConstruct(benchmark::State &state) {
+		int i = 0;
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			auto m = make_hmap((TK("foo", int), i++), (TK("bar", double), 2.), (TK("baz", std::string), "short"), (TK("bang", char), 'b'));
+			benchmark::DoNotOptimize(m);
+		}
+	}
+
+	void BM_StructAccess(benchmark::State &state) {
+		HandWritten s{1, 2., "short", 'b'};
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(s);
+			benchmark::DoNotOptimize(s.foo += 1);
+			benchmark::DoNotOptimize(s.bar);
+		}
+	}
+
+	void BM_StaticAccess(benchmark::State &state) {
+		auto m = make_hmap((TK("foo", int), 1), (TK("bar", double), 2.), (TK("baz", std::string), "short"), (TK("bang", char), 'b'));
+		AllocationCounter counter(state);
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(m);
+			benchmark::DoNotOptimize(m[IK("foo")] += 1);
+			benchmark::DoNotOptimize(m[IK("bar")]);
+		}
+	}
+}
+
+BENCHMARK_TEMPLATE(BM_Insert, DynamicHMap)->Apply(Sizes);
+BENCHMARK_TEMPLATE(BM_Insert, HashedDynamicHMap)->Apply(Sizes);
+BENCHMARK(BM_BaselineInsert)->Apply(Sizes);
+
+BENCHMARK_TEMPLATE(BM_Find, DynamicHMap)->Apply(Sizes);
+BENCHMARK_TEMPLATE(BM_Find, HashedDynamicHMap)->Apply(Sizes);
+BENCHMARK(BM_BaselineFind)->Apply(Sizes);
+
+BENCHMARK_TEMPLATE(BM_Subscript, DynamicHMap)->Apply(Sizes);
+BENCHMARK_TEMPLATE(BM_Subscript, HashedDynamicHMap)->Apply(Sizes);
+BENCHMARK(BM_BaselineSubscript)->Apply(Sizes);
+
+BENCHMARK_TEMPLATE(BM_MultiFind, DynamicHMap)->Apply(Sizes);
+BENCHMARK_TEMPLATE(BM_MultiFind, HashedDynamicHMap)->Apply(Sizes);
+
+BENCHMARK_TEMPLATE(BM_ExtractInsert, DynamicHMap)->Apply(Sizes);
+BENCHMARK_TEMPLATE(BM_ExtractInsert, HashedDynamicHMap)->Apply(Sizes);
+
+BENCHMARK_TEMPLATE(BM_Copy, DynamicHMap)->Apply(Sizes);
+BENCHMARK_TEMPLATE(BM_Copy, HashedDynamicHMap)->Apply(Sizes);
+BENCHMARK(BM_BaselineCopy)->Apply(Sizes);
+
+BENCHMARK(BM_StructConstruct);
+BENCHMARK(BM_StaticConstruct);
+BENCHMARK(BM_StructAccess);
+BENCHMARK(BM_StaticAccess);
+
+BENCHMARK_MAIN();
@@ -1,9 +1,26 @@
 #include <hmap/hmap.hpp>
+#include <hmap/flat-hmap.hpp>
+#include <hmap/htable.hpp>
 #include <hmap/dynamic-hmap.hpp>
 #include <hmap/key-convert.hpp>
+#include <hmap/concurrent-dynamic-hmap.hpp>
+#include <hmap/persistent-dynamic-hmap.hpp>
+#include <hmap/frozen-dynamic-hmap.hpp>
+#include <hmap/slab-dynamic-hmap.hpp>
+#include <hmap/mapped-dynamic-hmap.hpp>
+#include <hmap/json-loader.hpp>
+#include <hmap/dynamic-hmap-batch.hpp>
+#include <hmap/shaped-dynamic-hmap.hpp>
+#include <hmap/lazy-value.hpp>
+#include <hmap/tracked-dynamic-hmap.hpp>
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
 #include <string>
+#include <vector>
 
 using namespace std::string_literals;
 
@@ -38,6 +55,27 @@ int main(int argc, const char* argv[]) {
 		/////////////////////////////////////////////////
 		
 	}
+	// Verify static hmaps can be written to by runtime key names
+	{
+		auto myMap = make_hmap((TK("foo",int), 1), (TK("bar",float), 2.), (TK("baz",std::string), "hello"));
+		
+		std::cout << myMap.set_from("foo", 3) << myMap.set_from("baz", "goodbye") << myMap.set_from("foo", "bad type") << myMap.set_from("bang", 1) << std::endl;
+		myMap.visit_key("baz", [](const auto& v) { std::cout << v << std::endl; });
+		// Lossy conversions are rejected, rather than silently truncating
+		auto flags = make_hmap((TK("on",bool), false));
+		std::cout << myMap.set_from("foo", 3.7) << flags.set_from("on", "yes") << flags.set_from("on", true) << " " << myMap[IK("foo")] << std::endl;
+	}
+	// Verify the flat layout is as tight as a hand-written struct
+	{
+		auto myMap = make_flat_hmap((TK("foo",char), 'a'), (TK("bar",double), 2.), (TK("baz",int), 3), (TK("bang",char), 'b'));
+		struct HandWritten { double bar; int baz; char bang; char foo; };
+		static_assert(sizeof(myMap) == sizeof(HandWritten) && sizeof(myMap) == decltype(myMap)::packed_size);
+		
+		myMap[IK("baz")] += 1;
+		std::cout << myMap[TK("foo",char)] << " " << myMap[IK("bar")] << " " << myMap[IK("baz")] << std::endl;
+		//std::cout << myMap[TK("foo",int)] << std::endl;
+		//std::cout << myMap[IK("bing")] << std::endl;
+	}
 	// Verify proper functionality of dynamic hmap
 	{
 		auto myMap = make_dynamic_hmap((dK<int>("foo"), 1), (dK<float>("bar"), 2.), (dK<std::string>("baz"),"hello"));
@@ -62,6 +100,41 @@ int main(int argc, const char* argv[]) {
 		myMap.optCheckIn(std::move(tup), dK<std::string>("cusp"),
 		                                 dK<std::string>("baz"));
 	}
+	// Verify the hash-table backend behaves like the ordered one
+	{
+		auto myMap = make_dynamic_hmap<HashedDynamicHMap>((dK<int>("foo"), 1), (dK<float>("bar"), 2.), (dK<std::string>("baz"),"hello"));
+		
+		std::cout << myMap[dK<int>("foo")] << std::endl;
+		std::cout << (myMap.find(dK<float>("foo")) == myMap.end<float>()) << std::endl;
+		std::cout << myMap.erase(dK<int>("foo")) << std::endl;
+		std::cout << myMap.size() << std::endl;
+		
+		auto myOrderedMap = make_dynamic_hmap();
+		myOrderedMap.insert(myMap.extract(dK<std::string>("baz")), dK<std::string>("baz"));
+		std::cout << myOrderedMap.at(dK<std::string>("baz")) << std::endl;
+	}
+	// Verify the hash table spreads keys over all of its slots, even when their hashes share low bits
+	{
+		detail::FlatHashMap<size_t, size_t, std::hash<size_t> > table;
+		table.reserve(600);
+		std::vector<bool> homes(table.bucket_count());
+		size_t distinct = 0, even = 0;
+		for(size_t i = 0; i < 600; ++i) {
+			table.try_emplace(i * 64, i);
+			const size_t b = table.bucket(i * 64);
+			distinct += !homes[b];
+			even += !homes[b] && b % 2 == 0;
+			homes[b] = true;
+		}
+		for(size_t i = 0; i < 600; i += 2) {
+			table.erase(i * 64);
+		}
+		size_t found = 0;
+		for(size_t i = 1; i < 600; i += 2) {
+			found += table.count(i * 64);
+		}
+		std::cout << (distinct * 4 > table.bucket_count() * 2) << " " << (even * 4 > distinct) << " " << found << std::endl;
+	}
     {
 		auto myMap = make_dynamic_hmap((dSK<std::string>("baz"),std::make_shared<std::string>("goodbye")));
 		auto myMap2 = make_dynamic_hmap();
@@ -81,6 +154,295 @@ int main(int argc, const char* argv[]) {
 		std::cout << ((boost::none != optCusp) ? **optCusp : "\"cusp\" is not in map"s) << std::endl;
 		std::cout << ((boost::none != optBaz) ? **optBaz : "\"baz\" is not in map"s) << std::endl;
 	}
+	// Test lookup by string_view + tag, without building a Key
+	{
+		auto myMap = make_dynamic_hmap((dK<int>("foo"), 1), (dK<float>("foo"), 2.));
+		const std::string buffer = "foo,bar";
+		const std::string_view name = std::string_view(buffer).substr(0, 3);
+		
+		std::cout << *myMap(name, KeyTag<float>::tag()) << std::endl;
+		std::cout << (myMap.find(name, KeyTag<std::string>::tag()) == myMap.end<std::string>()) << std::endl;
+		std::cout << myMap.at(staticKeyName(TK("foo",int)), KeyTag<int>::tag()) << std::endl;
+		std::cout << (myMap.find(staticToKeyView(TK("foo",int))) != myMap.cend()) << std::endl;
+	}
+	// Verify per-type slab storage
+	{
+		SlabDynamicHMap myMap;
+		myMap[dK<double>("height")] = 10.;
+		myMap.try_emplace(dK<double>("width"), 20.);
+		myMap.insert_or_assign(dK<std::string>("name"), "box");
+		std::cout << myMap.erase(dK<double>("height")) << std::endl;
+		std::cout << *myMap(dK<double>("width")) << std::endl;
+		std::cout << myMap.values<double>().size() << " " << myMap.size() << std::endl;
+		myMap[dK<bool>("visible")] = true;
+		myMap.try_emplace(dK<bool>("hidden"), false);
+		bool &visible = myMap.at(dK<bool>("visible"));
+		visible = !visible;
+		std::cout << myMap.erase(dK<bool>("visible")) << *myMap(dK<bool>("hidden")) << myMap.values<bool>().size() << std::endl;
+	}
+	// Verify maps can allocate from a shared arena, and splice nodes between them
+	{
+		std::pmr::monotonic_buffer_resource arena;
+		PmrDynamicHMap myMap(&arena), myMap2(&arena);
+		myMap[dK<std::pmr::string>("baz")] = "a string long enough to need its own allocation";
+		myMap2.insert(myMap.extract(dK<std::pmr::string>("baz")), dK<std::pmr::string>("baz"));
+		std::cout << (myMap2(dK<std::pmr::string>("baz"))->get_allocator().resource() == &arena) << std::endl;
+	}
+	// Verify the sharded concurrent map
+	{
+		ConcurrentDynamicHMap myMap;
+		myMap.try_emplace(dK<int>("foo"), 1);
+		myMap.insert_or_assign(dK<std::string>("baz"), "hello");
+		auto tup = myMap.optCheckOut(dK<int>("foo"), dK<std::string>("baz"));
+		std::get<0>(tup).value() += 1;
+		myMap.optCheckIn(std::move(tup), dK<int>("foo"), dK<std::string>("baz"));
+		std::cout << *myMap(dK<int>("foo")) << " " << *myMap.at(dK<std::string>("baz")) << std::endl;
+	}
+	// Verify persistent maps share structure between versions
+	{
+		PersistentDynamicHMap base(make_dynamic_hmap((dK<int>("foo"), 1), (dK<std::string>("baz"), "hello")));
+		PersistentDynamicHMap next = base.with(dK<int>("foo"), 2).without(dK<std::string>("baz"));
+		std::cout << base.at(dK<int>("foo")) << " " << next.at(dK<int>("foo")) << " "
+		          << base.size() << " " << next.toMutable().size() << " "
+		          << base.toMutable().at(dK<std::string>("baz")) << " " << base.toMutable<HashedDynamicHMap>().at(dK<int>("foo")) << std::endl;
+	}
+	// Verify frozen maps answer the same lookups as the maps they were built from
+	{
+		FrozenDynamicHMap myMap = freeze(make_dynamic_hmap((dK<int>("foo"), 1), (dK<float>("bar"), 2.), (dK<std::string>("baz"), "hello")));
+		std::cout << myMap.at(dK<int>("foo")) << " " << *myMap(dK<std::string>("baz")) << " "
+		          << (myMap.find(dK<int>("bar")) == myMap.cend<int>()) << std::endl;
+	}
+	// Verify newline-delimited JSON loads straight into dynamic maps
+	{
+		std::istringstream in("{\"foo\": 1, \"bar\": 2.5, \"baz\": \"hello\", \"nested\": {\"ok\": true}, \"list\": [1, null], \"none\": null}\n"
+		                       "\n"
+		                       "{\"foo\": -7, \"foo\": 8, \"baz\": \"caf\\u00e9\"}\n");
+		JsonLoader loader;
+		const size_t count = loader.loadLines(in, [](DynamicHMap&& m) {
+			std::cout << m.at(dK<std::int64_t>("foo")) << " " << m.at(dK<std::string>("baz")) << " " << m.size();
+			if(const auto nested = m(dK<DynamicHMap>("nested"))) {
+				std::cout << " " << nested->at(dK<bool>("ok")) << " " << m.at(dK<double>("bar"))
+				          << " " << m.at(dK<JsonLoader::array_type>("list")).size();
+			}
+			std::cout << std::endl;
+		});
+		std::cout << count << std::endl;
+#ifndef HMAP_NO_EXCEPTIONS
+		// Verify input which isn't valid JSON is rejected
+		size_t rejected = 0;
+		for(const std::string& bad : std::vector<std::string>{"{\"n\": 01}", "{\"n\": 1.}", "{\"n\": -}", "{\"n\": 1e}", "{\"s\": \"a\tb\"}",
+		                             "{\"s\": \"\\ud800\"}", "{\"s\": \"\\udc00\"}", std::string("{\"a\": ") + std::string(100000, '[')}) {
+			try {
+				loader.load(bad);
+			} catch(const std::invalid_argument&) {
+				++rejected;
+			}
+		}
+		std::cout << rejected << " " << loader.load("{\"n\": -0.5e+1, \"z\": 0}").at(dK<double>("n")) << std::endl;
+#endif
+	}
+	// Verify maps can be written out, and read back in place from a mapped file
+	{
+		struct Point { double x, y; };
+		TypeRegistry::add<Point>(TypeRegistry::kFirstUserId);
+		std::string records;
+		serialize(make_dynamic_hmap((dK<int>("foo"), 1), (dK<Point>("origin"), Point{0., 0.}), (dK<std::string>("baz"), "hello")), records);
+		serialize(make_dynamic_hmap<HashedDynamicHMap>((dK<int>("foo"), 2), (dK<float>("foo"), 3.)), records);
+		std::ofstream("test-hmap-records.bin", std::ios::binary) << records;
+		{
+			MappedFile file("test-hmap-records.bin");
+			MappedDynamicHMapView first(file.data(), file.size());
+			MappedDynamicHMapView second(file.data() + first.record_size(), file.size() - first.record_size());
+			std::cout << first.at(dK<int>("foo")) << " " << first(dK<Point>("origin"))->y << " " << *first.get(dK<std::string>("baz")) << " "
+			          << *second(dK<float>("foo")) << " " << second.toMutable().at(dK<int>("foo")) << " "
+			          << (first.find(dK<float>("foo")) == first.cend()) << std::endl;
+		}
+		std::remove("test-hmap-records.bin");
+	}
+	// Verify batched lookups of static keys in a dynamic map
+	{
+		auto myMap = make_dynamic_hmap((dK<int>("foo"), 1), (dK<float>("bar"), 2.), (dK<std::string>("baz"), "hello"));
+		auto [baz, foo, bang] = lookupStatic(myMap, TK("baz",std::string), TK("foo",int), TK("bang",int));
+		std::cout << *baz << " " << *foo << " " << bool(bang) << std::endl;
+	}
+	// Verify bulk loading resolves repeated keys by policy
+	{
+		std::vector<std::pair<detail::Key<int>, int> > rows{{dK<int>("foo"), 1}, {dK<int>("bar"), 2}, {dK<int>("foo"), 3}};
+		DynamicHMap myMap(rows.begin(), rows.end(), DynamicHMap::first_wins);
+		std::cout << myMap.at(dK<int>("foo")) << " ";
+		myMap.insert_bulk(std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()), DynamicHMap::last_wins);
+		std::cout << myMap.at(dK<int>("foo")) << " " << myMap.size() << std::endl;
+	}
+	// Verify rows sharing a schema can be stored by column
+	{
+		DynamicHMapBatch batch(dK<int>("foo"), dK<std::string>("baz"));
+		batch.append(make_dynamic_hmap((dK<int>("foo"), 1), (dK<std::string>("baz"), "hello")));
+		batch.append(make_dynamic_hmap((dK<int>("foo"), 2), (dK<float>("bar"), 3.)));
+		const std::vector<int>& foos = batch.column(dK<int>("foo"));
+		std::cout << foos[0] + foos[1] << " " << batch[0].at(dK<std::string>("baz")) << " " << bool(batch[1](dK<std::string>("baz"))) << " "
+		          << *batch[1](dK<float>("bar")) << " " << batch[1].toMap().size() << std::endl;
+		DynamicHMapBatch flags(dK<bool>("on"));
+		flags.append(make_dynamic_hmap((dK<bool>("on"), true)));
+		flags.append(DynamicHMap());
+		std::cout << *flags[0](dK<bool>("on")) << " " << bool(flags[1](dK<bool>("on"))) << " " << flags.column(dK<bool>("on"))[0] << std::endl;
+	}
+	// Verify maps with the same keys share a shape
+	{
+		ShapedDynamicHMap first, second;
+		first[dK<int>("foo")] = 1;
+		first.insert_or_assign(dK<std::string>("baz"), "hello");
+		second.try_emplace(dK<std::string>("baz"), "world");
+		second[dK<int>("foo")] = 2;
+		std::cout << (&first.shape() == &second.shape()) << " " << first.at(dK<std::string>("baz")) << " ";
+		second.erase(dK<std::string>("baz"));
+		std::cout << (&first.shape() == &second.shape()) << " " << *second(dK<int>("foo")) << " " << first.toMap().size() << std::endl;
+	}
+	// Verify iteration over the entries of a single type
+	{
+		auto myMap = make_dynamic_hmap<TagIndexedDynamicHMap>((dK<int>("foo"), 1), (dK<float>("bar"), 2.), (dK<int>("baz"), 3));
+		for(auto [k, v] : myMap.range<int>()) {
+			v *= 2;
+		}
+		for(auto [k, v] : myMap.const_range<int>()) {
+			std::cout << k.key << "=" << v << " ";
+		}
+		std::cout << myMap.count<int>() << " " << make_dynamic_hmap((dK<float>("bar"), 2.)).count<int>() << std::endl;
+	}
+	// Verify range queries by key string, across types
+	{
+		auto myMap = make_dynamic_hmap((dK<int>("geom.x"), 1), (dK<float>("geom.x"), 2.), (dK<int>("geom.y"), 3), (dK<int>("geometry"), 4));
+		const auto count = [](const auto& range) { return std::distance(range.begin(), range.end()); };
+		std::cout << count(myMap.equal_range("geom.x")) << " " << count(myMap.prefix_range("geom.")) << " " << count(myMap.prefix_range("geom")) << std::endl;
+	}
+	// Verify equal names are ordered by compile-time type id, not by address
+	{
+		auto myMap = make_dynamic_hmap((dK<float>("foo"), 2.), (dK<int>("foo"), 1));
+		const std::type_info& first = (detail::typeId<int> < detail::typeId<float>) ? typeid(int) : typeid(float);
+		std::cout << (myMap.cbegin()->first.info() == first) << " " << (KeyTag<int>::tag().id == detail::typeId<int>) << " "
+		          << (KeyTagRegistry::find(detail::typeId<int>) == std::vector<const detail::KeyTagBase*>{&KeyTag<int>::tag()}) << " " << KeyTagRegistry::collisions().empty() << std::endl;
+	}
+	// Verify entries can be dispatched on their types through a jump table
+	{
+		auto myMap = make_dynamic_hmap((dK<int>("foo"), 1), (dK<float>("bar"), 2.), (dK<std::string>("baz"), "hello"));
+		struct Printer {
+			void operator()(const detail::KeyBase& k, const int& v) const { std::cout << k.key << "=" << v << " "; }
+			void operator()(const detail::KeyBase& k, const std::string& v) const { std::cout << k.key << "='" << v << "' "; }
+			void operator()(const detail::KeyBase& k, const std::any&) const { std::cout << k.key << "=? "; }
+		};
+		myMap.visit<int, std::string>(Printer{});
+		std::cout << std::endl;
+	}
+	// Verify lookups can report misses without throwing
+	{
+		auto myMap = make_dynamic_hmap((dK<int>("foo"), 1), (dK<std::string>("baz"), "hello"));
+		const auto found = myMap.try_at(dK<int>("foo"));
+		const auto missing = myMap.try_at(dK<int>("bar"));
+		const auto mismatched = detail::Key<float>::try_rehydrate(std::nothrow, static_cast<const detail::KeyBase&>(dK<int>("foo")));
+		std::cout << *found << " " << (missing.error() == LookupError::KeyNotFound) << " " << (mismatched.error() == LookupError::TypeMismatch) << " " << myMap.try_at("baz", KeyTag<std::string>::tag()).value_or("?")
+		          << " " << myMap.try_at("bang", KeyTag<std::string>::tag()).value_or("fallback") << std::endl;
+	}
+	// Verify maps count their own operations when built with HMAP_ENABLE_STATS (and cost nothing otherwise)
+	{
+		DynamicHMap myMap;
+		myMap.set_stats_label("example");
+		myMap[dK<int>("foo")] = 1;
+		myMap[dK<int>("foo")] = 2;
+		myMap.find(dK<int>("bar"));
+		const DynamicHMapStats stats = myMap.stats();
+#ifdef HMAP_ENABLE_STATS
+		const bool expected = stats.inserts == 2 && stats.nodes == 1 && stats.lookups == 1 && stats.misses == 1 && DynamicHMapStatsRegistry::labelled().size() == 1;
+#else
+		const bool expected = stats.inserts == 0 && sizeof(DynamicHMap) == sizeof(detail::OrderedStore);
+#endif
+		std::cout << expected << std::endl;
+	}
+	// Verify maps can be merged in one pass, resolving shared keys by policy
+	{
+		auto defaults = make_dynamic_hmap((dK<int>("retries"), 3), (dK<std::string>("path"), "/usr"), (dK<int>("timeout"), 10));
+		auto site = make_dynamic_hmap((dK<int>("retries"), 5), (dK<std::string>("path"), "/local"));
+		auto keepLeft = defaults;
+		keepLeft.merge(site, keepLeft.first_wins);
+		defaults.merge(std::move(site), defaults.combine_with<std::string>([](const detail::KeyBase&, auto& left, auto&& right) {
+			if constexpr (std::is_same_v<std::decay_t<decltype(left)>, std::string>) {
+				left += ":" + right;
+			} else {
+				left = std::move(right);
+			}
+		}));
+		std::cout << keepLeft[dK<int>("retries")] << " " << defaults[dK<int>("retries")] << " " << defaults[dK<std::string>("path")] << " " << site.empty() << std::endl;
+		// Values merged from a map with another memory resource are rebuilt with ours
+		std::pmr::monotonic_buffer_resource arena, otherArena;
+		PmrDynamicHMap ours(&arena), theirs(&otherArena), overrides(&otherArena);
+		theirs[dK<std::pmr::string>("baz")] = "a string long enough to need its own allocation";
+		overrides[dK<std::pmr::string>("bar")] = "another string long enough to need its own allocation";
+		ours[dK<std::pmr::string>("bar")] = "short";
+		ours.merge(std::move(theirs), ours.first_wins);
+		ours.merge(overrides, ours.last_wins);
+		std::cout << (ours(dK<std::pmr::string>("baz"))->get_allocator().resource() == &arena)
+		          << (ours(dK<std::pmr::string>("bar"))->get_allocator().resource() == &arena) << std::endl;
+	}
+	// Verify static maps can be walked, transformed, compared and hashed field by field at compile-time
+	{
+		auto myMap = make_hmap((TK("foo", int), 1), (TK("bar", double), 2.), (TK("baz", std::string), "hello"));
+		auto sameMap = make_hmap((TK("baz", std::string), "hello"), (TK("foo", int), 1), (TK("bar", double), 2.));
+		myMap.for_each([](auto name, const auto& v) { std::cout << decltype(name)::c_str() << "=" << v << " "; });
+		const auto sizes = myMap.transform([](auto, const auto& v) { return sizeof(v); });
+		std::cout << (myMap == sameMap) << " " << (std::hash<decltype(myMap)>()(myMap) == std::hash<decltype(sameMap)>()(sameMap)) << " " << sizes[IK("foo")] << std::endl;
+	}
+	// Verify records can be stored column-by-column, and scanned one field at a time
+	{
+		auto table = make_htable(TK("x", float), TK("id", int));
+		for(int i = 0; i < 4; ++i) {
+			table.push_back(make_hmap((TK("id", int), i), (TK("x", float), i * .5f)));
+		}
+		float total = 0;
+		for(float x : table[TK("x", float)]) {
+			total += x;
+		}
+		table[2][IK("id")] = 7;
+		std::cout << table.size() << " " << total << " " << table[IK("id")][2] << " " << table[3].to_hmap()[IK("x")] << std::endl;
+		// Flags get real `bool` columns, and fields needn't be default-constructible
+		struct Id { int v; explicit Id(int v) : v(v) {} };
+		auto flagged = make_htable(TK("on", bool), TK("id", Id));
+		flagged.push_back(make_hmap((TK("on", bool), true), (TK("id", Id), Id(1))));
+		flagged.push_back(make_hmap((TK("on", bool), false), (TK("id", Id), Id(2))));
+		flagged[1][IK("on")] = true;
+		const bool *on = flagged[IK("on")].data();
+		std::cout << on[0] << on[1] << " " << flagged[1].to_hmap()[IK("id")].v << std::endl;
+	}
+	// Verify lazy values are computed once, on first read, and that changes can be replayed as patches
+	{
+		int computed = 0;
+		DynamicHMap myMap;
+		myMap.try_emplace(dK<Lazy<int> >("area"), [&computed] { ++computed; return 6; });
+		const int before = computed;
+		const int area = myMap.at(dK<Lazy<int> >("area"));
+		const int again = myMap.at(dK<Lazy<int> >("area"));
+		TrackedDynamicHMap tracked(make_dynamic_hmap((dK<int>("foo"), 1), (dK<std::string>("baz"), "hello")));
+		DynamicHMap replica = tracked.map();
+		tracked[dK<int>("foo")] = 2;
+		tracked.erase(dK<std::string>("baz"));
+		const DynamicHMapPatch patch = tracked.diff();
+		apply_patch(replica, patch);
+		std::cout << before << " " << area + again << " " << computed << " " << tracked.dirty().size() << " " << replica.at(dK<int>("foo")) << " " << replica.size() << std::endl;
+		// Erasures survive serialization, and a moved-from lazy value still reads
+		std::string wire;
+		serialize(patch, wire);
+		DynamicHMap remote = make_dynamic_hmap((dK<int>("foo"), 1), (dK<std::string>("baz"), "hello"));
+		const auto [received, used] = deserialize_patch(wire.data(), wire.size());
+		apply_patch(remote, received);
+		Lazy<int> lazy([] { return 7; });
+		Lazy<int> moved(std::move(lazy));
+		std::cout << received.erased.size() << " " << remote.size() << " " << remote.at(dK<int>("foo")) << " " << (used == wire.size()) << " " << lazy.get() + moved.get() << std::endl;
+	}
+	// Verify static maps can be moved to dynamic maps and back
+	{
+		auto myMap = make_hmap((TK("foo",int), 1), (TK("bar",float), 2.), (TK("baz",std::string), "hello"));
+		DynamicHMap myDynamicMap = toDynamic(std::move(myMap));
+		myDynamicMap[dK<int>("foo")] += 1;
+		auto myMap2 = fromDynamic<decltype(myMap)>(std::move(myDynamicMap));
+		std::cout << myMap2[IK("foo")] << " " << myMap2[IK("baz")] << " " << myDynamicMap.size() << std::endl;
+	}
 	// Test turning static keys into dynamic keys
 	{
 		auto keys = std::make_tuple(TK("foo",int), TK("bar",float), TK("baz",std::string));
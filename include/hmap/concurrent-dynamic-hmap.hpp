@@ -0,0 +1,439 @@
+#pragma once
+/************************************************************************************
+ * @file concurrent-dynamic-hmap.hpp A thread-safe, sharded @ref dynamic-hmap.hpp
+ * for sharing read-mostly heterogeneous maps between many threads.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/optional/optional.hpp>
+
+#include <hmap/dynamic-hmap.hpp>
+
+namespace detail {
+	constexpr std::size_t kReaderSlots = 64; ///< Reader counters per concurrent map; threads beyond this many share them.
+
+	/// This thread's reader counter, the same for every concurrent map. Assigned round-robin, on first use.
+	inline std::size_t readerSlot() {
+		static std::atomic<std::size_t> next{0};
+		thread_local const std::size_t slot = next.fetch_add(1, std::memory_order_relaxed) % kReaderSlots;
+		return slot;
+	}
+}
+
+/******************************************************
+ * A `BasicDynamicHMap` which may be read and written
+ * concurrently from many threads.
+ *
+ * Keys are distributed across `Shards` shards by their
+ * cached hash. Each shard publishes an immutable
+ * snapshot through a `std::atomic<const Map*>`
+ * (RCU-style). Readers are wait-free: a lookup loads
+ * the current epoch and the shard's pointer, and
+ * increments (then, when its result is dropped,
+ * decrements) a reader counter which is private to the
+ * calling thread, unless more than `detail::kReaderSlots`
+ * threads have read from concurrent maps. Readers never
+ * take a lock, nor write to memory written by writers.
+ *
+ * Writers serialize on a per-shard mutex, copy the
+ * shard, modify the copy, and publish it. Replaced
+ * snapshots are reclaimed by epochs: readers count
+ * themselves in under the parity of the current epoch,
+ * and a writer advances the epoch only once no readers
+ * remain under the other parity, so a snapshot retired
+ * in epoch `e` is no longer visible to any reader by
+ * epoch `e + 2`. Writers never wait for readers either:
+ * each write advances the epoch as far as it can, and
+ * frees what it may, so snapshots held by long-lived
+ * results are reclaimed by a later write (or by the map's
+ * destructor).
+ *
+ * Since a value may be replaced at any time, lookups
+ * return a `Pinned<const V>`, which keeps the snapshot
+ * it was found in alive, rather than a reference. It can
+ * be tested and dereferenced just like the
+ * `boost::optional<const V&>` returned by
+ * `BasicDynamicHMap::operator()`.
+ *
+ * @note Writes copy a whole shard, so this suits
+ * read-mostly maps (e.g. configuration). Multi-key
+ * operations are atomic with respect to other writers,
+ * but a reader looking up keys from several shards may
+ * observe some shards before and some after the update.
+ *
+ * @warning Every `Pinned` must be dropped before the
+ * map is destroyed. Holding one delays the reclamation
+ * of every snapshot replaced after it was taken.
+ *
+ * @tparam Backend As for `BasicDynamicHMap`.
+ * @tparam Shards The number of independently locked
+ * shards.
+ ******************************************************/
+template<typename Backend, std::size_t Shards = 32>
+class BasicConcurrentDynamicHMap : public detail::DynamicHMapBase {
+	static_assert(Shards > 0, "Need at least one shard");
+  public:
+	using Map = BasicDynamicHMap<Backend>; ///< Type of each shard's snapshots.
+
+  private:
+	/// Padded to avoid false sharing between neighbouring shards.
+	struct alignas(64) Shard {
+		std::mutex writeMutex; ///< Serializes writers, never taken by readers.
+		std::atomic<const Map*> current{new Map()}; ///< Owned; replaced (and retired) only while holding `writeMutex`.
+	};
+
+	/// Readers active under each parity of `epoch_`. Padded, so threads with different slots never share a line.
+	struct alignas(64) ReaderSlot {
+		std::atomic<std::size_t> readers[2] = {};
+	};
+
+	/// A snapshot no longer published, and the epoch in which it was replaced.
+	struct Retired {
+		std::unique_ptr<const Map> snapshot;
+		std::uint64_t epoch;
+	};
+
+	std::array<Shard, Shards> shards_;
+	alignas(64) std::atomic<std::uint64_t> epoch_{0}; ///< Only advanced by writers, holding `reclaimMutex_`.
+	mutable std::array<ReaderSlot, detail::kReaderSlots> readers_;
+	std::mutex reclaimMutex_; ///< Guards `retired_`, and advancing `epoch_`.
+	std::vector<Retired> retired_;
+
+	/// Pick a shard from the high bits of a remixed hash, so that the keys in each shard still differ in the bits its `FlatHashMap` takes slots from.
+	static std::size_t shardOf(const detail::KeyBase& k) {
+		const std::uint64_t mixed = std::uint64_t(k.hash) * 0xD6E8FEB86659FD93ull;
+		return std::size_t(((mixed >> 32) * Shards) >> 32);
+	}
+
+	/// A read-side critical section: no snapshot published while it lasts is reclaimed until it ends.
+	class ReadGuard {
+		std::atomic<std::size_t> *readers_ = nullptr;
+
+	  public:
+		explicit ReadGuard(const BasicConcurrentDynamicHMap& owner) {
+			// Sequentially consistent, so a writer which sees no readers here also sees this thread's later loads.
+			const std::uint64_t epoch = owner.epoch_.load(std::memory_order_seq_cst);
+			readers_ = &owner.readers_[detail::readerSlot()].readers[epoch & 1];
+			readers_->fetch_add(1, std::memory_order_seq_cst);
+		}
+		ReadGuard(ReadGuard&& g) noexcept : readers_(std::exchange(g.readers_, nullptr)) {}
+		ReadGuard& operator=(ReadGuard&& g) noexcept {
+			if(this != &g) {
+				release();
+				readers_ = std::exchange(g.readers_, nullptr);
+			}
+			return *this;
+		}
+		~ReadGuard() { release(); }
+
+		void release() {
+			if(readers_) {
+				readers_->fetch_sub(1, std::memory_order_release);
+				readers_ = nullptr;
+			}
+		}
+
+		/// The snapshot `shard` publishes, which lives at least as long as this guard.
+		const Map& load(const Shard& shard) const {
+			return *shard.current.load(std::memory_order_seq_cst);
+		}
+	};
+
+  public:
+	/****************************************************
+	 * A pointer to a `T` found in one of the map's
+	 * snapshots, which keeps that snapshot alive. Null if
+	 * nothing was found. Move-only.
+	 ****************************************************/
+	template<typename T>
+	class Pinned {
+		friend class BasicConcurrentDynamicHMap;
+		ReadGuard guard_;
+		T *ptr_;
+
+		Pinned(ReadGuard &&guard, T *ptr) : guard_(std::move(guard)), ptr_(ptr) {
+			if(!ptr_) {
+				guard_.release();
+			}
+		}
+
+	  public:
+		Pinned(Pinned&&) noexcept = default;
+		Pinned& operator=(Pinned&&) noexcept = default;
+
+		T* get() const { return ptr_; }
+		T& operator*() const { return *ptr_; }
+		T* operator->() const { return ptr_; }
+		explicit operator bool() const { return ptr_ != nullptr; }
+	};
+
+  private:
+	/****************************************************
+	 * Writer-side, holding the write lock of each shard
+	 * with a non-null `replacements` entry: publish those
+	 * entries, retire the snapshots they replace, and
+	 * reclaim whatever no reader can still see.
+	 *
+	 * Space for the retired snapshots is reserved before
+	 * anything is published, so either every replacement
+	 * is published or (if that throws) none is.
+	 ****************************************************/
+	void publish(std::array<std::unique_ptr<Map>, Shards> &replacements) {
+		std::lock_guard<std::mutex> lock(reclaimMutex_);
+		retired_.reserve(retired_.size() + std::size_t(std::count_if(replacements.begin(), replacements.end(), [](const std::unique_ptr<Map>& r) {
+			return r != nullptr;
+		})));
+		const std::uint64_t retiredIn = epoch_.load(std::memory_order_relaxed);
+		for(std::size_t shard = 0; shard < Shards; ++shard) {
+			if(replacements[shard]) {
+				retired_.push_back(Retired{std::unique_ptr<const Map>(shards_[shard].current.exchange(replacements[shard].release(), std::memory_order_seq_cst)), retiredIn});
+			}
+		}
+		// Two advances make the snapshots just retired reclaimable, if no reader is still active.
+		for(int i = 0; i < 2 && tryAdvance(); ++i) {}
+		const std::uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+		retired_.erase(std::remove_if(retired_.begin(), retired_.end(), [epoch](const Retired& r) {
+			return r.epoch + 2 <= epoch;
+		}), retired_.end());
+	}
+
+	/// Caller must hold `reclaimMutex_`. Advance `epoch_`, if every reader counted under the next epoch's parity (i.e. the previous epoch's) has left.
+	bool tryAdvance() {
+		const std::uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+		for(const ReaderSlot& slot : readers_) {
+			if(slot.readers[(epoch + 1) & 1].load(std::memory_order_seq_cst) != 0) {
+				return false;
+			}
+		}
+		epoch_.store(epoch + 1, std::memory_order_seq_cst);
+		return true;
+	}
+
+	/// Write-side RAII: locks each shard involved (in index order, to avoid deadlock). Modified copies are published by `commit()`, and otherwise discarded.
+	template<std::size_t N>
+	class Transaction {
+		BasicConcurrentDynamicHMap& owner_;
+		std::array<std::size_t, N> involved_; ///< Sorted, possibly with duplicates.
+		std::array<std::unique_lock<std::mutex>, N> locks_;
+		std::array<std::unique_ptr<Map>, Shards> copies_; ///< Populated on first write to each shard.
+
+		/// The published snapshot of `shard`, which can't be replaced while this transaction holds its lock.
+		const Map& published(std::size_t shard) const {
+			return *owner_.shards_[shard].current.load(std::memory_order_relaxed);
+		}
+
+	  public:
+		Transaction(BasicConcurrentDynamicHMap& owner, std::array<std::size_t, N> shards)
+		: owner_(owner), involved_(shards) {
+			std::sort(involved_.begin(), involved_.end());
+			for(std::size_t i = 0; i < N; ++i) {
+				if(i == 0 || involved_[i] != involved_[i - 1]) {
+					locks_[i] = std::unique_lock<std::mutex>(owner_.shards_[involved_[i]].writeMutex);
+				}
+			}
+		}
+		/// Copy-on-write access to the shard for `k`.
+		Map& shardFor(const detail::KeyBase& k) {
+			const std::size_t shard = shardOf(k);
+			if(!copies_[shard]) {
+				copies_[shard] = std::make_unique<Map>(published(shard));
+			}
+			return *copies_[shard];
+		}
+		/// Read access to the shard for `k`, reflecting earlier writes in this transaction.
+		const Map& peekFor(const detail::KeyBase& k) const {
+			const std::size_t shard = shardOf(k);
+			return copies_[shard] ? *copies_[shard] : published(shard);
+		}
+		/// Publish all modified shards, while still holding every lock. Call once every write has succeeded.
+		void commit() {
+			owner_.publish(copies_);
+		}
+	};
+
+	template<typename ...Keys>
+	Transaction<sizeof...(Keys)> transaction(const Keys& ...ks) {
+		return Transaction<sizeof...(Keys)>(*this, {shardOf(ks)...});
+	}
+
+	template <typename Tx, typename... Types, typename... Vs, size_t... Is>
+	void optCheckInHelper(Tx& tx, std::tuple<Types...>&& tup, std::index_sequence<Is...>, const detail::Key<Vs>& ...ks) {
+		(static_cast<void>(tx.shardFor(ks).optCheckIn(std::make_tuple(std::move(std::get<Is>(tup))), ks)), ...);
+	}
+
+  public:
+	BasicConcurrentDynamicHMap() = default;
+	BasicConcurrentDynamicHMap(const BasicConcurrentDynamicHMap&) = delete;
+	BasicConcurrentDynamicHMap& operator=(const BasicConcurrentDynamicHMap&) = delete;
+
+	/// Distribute the contents of `m` across shards.
+	explicit BasicConcurrentDynamicHMap(const Map& m) {
+		std::array<std::unique_ptr<Map>, Shards> copies;
+		for(auto& copy : copies) {
+			copy = std::make_unique<Map>();
+		}
+		for(auto it = m.cbegin(); it != m.cend(); ++it) {
+			copies[shardOf(it->first)]->unsafe_insert_or_assign(it->first, it->second);
+		}
+		for(std::size_t shard = 0; shard < Shards; ++shard) {
+			delete shards_[shard].current.exchange(copies[shard].release(), std::memory_order_relaxed);
+		}
+	}
+
+	/// No readers (or `Pinned` results) may remain.
+	~BasicConcurrentDynamicHMap() {
+		for(Shard& shard : shards_) {
+			delete shard.current.load(std::memory_order_relaxed);
+		}
+	}
+
+	/// Find the `V` mapped by `k`, if present. Wait-free.
+	template<typename V>
+	Pinned<const V> operator()(const detail::Key<V>& k) const {
+		ReadGuard guard(*this);
+		const boost::optional<const V&> found = guard.load(shards_[shardOf(k)])(k);
+		return Pinned<const V>(std::move(guard), found ? &*found : nullptr);
+	}
+
+	/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of pinned pointers.
+	template <typename... Vs>
+	auto operator()(multi_tag, const detail::Key<Vs>& ...ks) const {
+		return std::make_tuple((*this)(ks)...);
+	}
+
+	/// Find the type-erased value mapped by `kb`, if present. Wait-free.
+	Pinned<const std::any> find(const detail::KeyBase& kb) const {
+		ReadGuard guard(*this);
+		const Map& snapshot = guard.load(shards_[shardOf(kb)]);
+		const auto found = snapshot.find(kb);
+		return Pinned<const std::any>(std::move(guard), (snapshot.cend() != found) ? &found->second : nullptr);
+	}
+
+	/// As for `operator()`, but throws if `k` is not present.
+	template<typename V>
+	Pinned<const V> at(const detail::Key<V>& k) const {
+		Pinned<const V> found = (*this)(k);
+		if(!found) {
+			keyNotFound(k);
+		}
+		return found;
+	}
+
+	/// cf. `std::map::try_emplace`. @return `true` if a value was inserted.
+	template<typename V, typename ...Args>
+	bool try_emplace(const detail::Key<V>& k, Args&& ...args) {
+		auto tx = transaction(k);
+		if(tx.peekFor(k)(k)) {
+			return false;
+		}
+		tx.shardFor(k).try_emplace(k, std::forward<Args>(args)...);
+		tx.commit();
+		return true;
+	}
+
+	/// cf. `std::map::insert_or_assign`. @return `true` if a value was inserted rather than assigned.
+	template<typename V, typename ...Args>
+	bool insert_or_assign(const detail::Key<V>& k, Args&& ...args) {
+		auto tx = transaction(k);
+		const bool inserted = tx.shardFor(k).insert_or_assign(k, std::forward<Args>(args)...).second;
+		tx.commit();
+		return inserted;
+	}
+
+	/// cf. `std::map::erase`.
+	template<typename V>
+	size_t erase(const detail::Key<V>& k) {
+		auto tx = transaction(k);
+		if(!tx.peekFor(k)(k)) {
+			return 0;
+		}
+		const size_t erased = tx.shardFor(k).erase(k);
+		tx.commit();
+		return erased;
+	}
+
+	/// Atomically extract several key-value pairs, returning optionals that contain the values.
+	template <typename... Vs>
+	std::tuple<boost::optional<Vs>...> optCheckOut(const detail::Key<Vs>& ...ks) {
+		auto tx = transaction(ks...);
+		auto checkOut = [&tx](const auto& k) {
+			return tx.peekFor(k)(k) ? std::get<0>(tx.shardFor(k).optCheckOut(k)) : boost::none;
+		};
+		// Braced initialization guarantees left-to-right evaluation.
+		std::tuple<boost::optional<Vs>...> retval{checkOut(ks)...};
+		tx.commit();
+		return retval;
+	}
+
+	/// Atomically insert values from boost::optional objects into the map as directed by the corresponding keys.
+	template<typename ...Types, typename ...Vs>
+	void optCheckIn(std::tuple<Types...> &&tup, const detail::Key<Vs>& ...ks) {
+		auto tx = transaction(ks...);
+		optCheckInHelper(tx, std::move(tup), std::index_sequence_for<Vs...>{}, ks...);
+		tx.commit();
+	}
+
+	/// A consistent copy of each shard, merged. Not atomic across shards.
+	Map snapshot() const {
+		Map merged;
+		const ReadGuard guard(*this);
+		for(const Shard& shard : shards_) {
+			const Map& s = guard.load(shard);
+			for(auto it = s.cbegin(); it != s.cend(); ++it) {
+				merged.unsafe_insert_or_assign(it->first, it->second);
+			}
+		}
+		return merged;
+	}
+
+	/// Number of entries. Not atomic across shards.
+	size_t size() const {
+		size_t total = 0;
+		const ReadGuard guard(*this);
+		for(const Shard& shard : shards_) {
+			total += guard.load(shard).size();
+		}
+		return total;
+	}
+	bool empty() const { return size() == 0; } ///< `true` if `size() == 0`, `false` otherwise.
+
+	/// Clear the map. Not atomic across shards.
+	void clear() {
+		for(std::size_t shard = 0; shard < Shards; ++shard) {
+			std::lock_guard<std::mutex> lock(shards_[shard].writeMutex);
+			std::array<std::unique_ptr<Map>, Shards> replacements;
+			replacements[shard] = std::make_unique<Map>();
+			publish(replacements);
+		}
+	}
+};
+
+/// `BasicConcurrentDynamicHMap` with hashed shards.
+using ConcurrentDynamicHMap = BasicConcurrentDynamicHMap<detail::HashedStore>;
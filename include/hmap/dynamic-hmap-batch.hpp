@@ -0,0 +1,455 @@
+#pragma once
+/************************************************************************************
+ * @file dynamic-hmap-batch.hpp Columnar storage for many maps of @ref dynamic-hmap.hpp
+ * which share (mostly) the same keys.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <any>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/iterator/counting_iterator.hpp>
+#include <boost/iterator/transform_iterator.hpp>
+#include <boost/optional/optional.hpp>
+
+#include <hmap/dynamic-hmap.hpp>
+
+namespace detail {
+	/// Type-erased base class for `BatchColumn`.
+	struct BatchColumnBase {
+		std::vector<std::uint8_t> present; ///< One flag per row, or empty while every row has a value.
+
+		virtual ~BatchColumnBase() = default;
+		virtual std::unique_ptr<BatchColumnBase> clone() const = 0;
+		/// Append a value for the next row. @pre `v` holds the column's type.
+		virtual void push(const std::any &v) = 0;
+		/// Append a value for the next row. @pre `v` holds the column's type.
+		virtual void push(std::any &&v) = 0;
+		/// Append a (default-constructed) placeholder for a row with no value.
+		virtual void pushMissing() = 0;
+		/// Copy out the value at `row`. @pre `has(row)`.
+		virtual std::any get(std::size_t row) const = 0;
+		virtual void reserve(std::size_t rows) = 0;
+		/// Drop every row from `rows` onwards.
+		virtual void truncate(std::size_t rows) = 0;
+
+		bool has(std::size_t row) const { return present.empty() || present[row]; }
+	};
+
+	/// A `bool` stored in a `BatchColumn<bool>`, which would otherwise be a `std::vector<bool>`, whose elements can't be referenced.
+	struct BatchBool {
+		bool value = false;
+
+		BatchBool() = default;
+		BatchBool(bool v) : value(v) {}
+		operator bool() const { return value; }
+	};
+
+	/// How a `BatchColumn<V>` stores each `V`: as itself, except for `bool`.
+	template<typename V>
+	struct BatchStorage {
+		using type = V;
+		static const V& get(const V& v) { return v; }
+	};
+	template<>
+	struct BatchStorage<bool> {
+		using type = BatchBool;
+		static const bool& get(const BatchBool& b) { return b.value; }
+	};
+
+	/// Contiguous storage for one key's values across every row of a `DynamicHMapBatch`.
+	template<typename V>
+	struct BatchColumn : BatchColumnBase {
+		static_assert(std::is_default_constructible_v<V>, "DynamicHMapBatch: schema types must be default-constructible, to fill rows which lack them.");
+
+		std::vector<typename BatchStorage<V>::type> values; ///< `values[row]`, which is default-constructed where `!has(row)`.
+
+		/// The value at `row`.
+		const V& at(std::size_t row) const { return BatchStorage<V>::get(values[row]); }
+
+		std::unique_ptr<BatchColumnBase> clone() const override {
+			return std::make_unique<BatchColumn<V> >(*this);
+		}
+		void push(const std::any &v) override {
+			values.push_back(*std::any_cast<V>(&v));
+			if(!present.empty()) {
+				present.push_back(1);
+			}
+		}
+		void push(std::any &&v) override {
+			values.push_back(std::move(*std::any_cast<V>(&v)));
+			if(!present.empty()) {
+				present.push_back(1);
+			}
+		}
+		void pushMissing() override {
+			if(present.empty()) {
+				present.assign(values.size(), 1);
+			}
+			values.emplace_back();
+			present.push_back(0);
+		}
+		std::any get(std::size_t row) const override {
+			return std::any{at(row)};
+		}
+		void reserve(std::size_t rows) override {
+			values.reserve(rows);
+		}
+		void truncate(std::size_t rows) override {
+			values.erase(values.begin() + std::min(rows, values.size()), values.end());
+			if(rows == 0) {
+				present.clear();
+			} else if(present.size() > rows) {
+				present.resize(rows);
+			}
+		}
+	};
+}
+
+/******************************************************
+ * A sequence of rows, each read like a `DynamicHMap`,
+ * which share a schema: a fixed set of keys chosen up
+ * front. The schema is stored once, and each of its keys
+ * owns a `detail::BatchColumn<V>`, a contiguous
+ * `std::vector<V>` holding that key's value for every
+ * row, so a row costs about `sizeof(V)` per key in place
+ * of a tree node, `detail::KeyBase`, and `std::any` each.
+ * (`bool`s are held one per byte, as `detail::BatchBool`s,
+ * rather than in a `std::vector<bool>`.)
+ *
+ * Rows are appended from maps. Keys outside the schema
+ * are kept in a sparse overflow `DynamicHMap` for just the
+ * rows which have them, and schema keys missing from a row
+ * are marked absent, in a per-column mask which is only
+ * allocated once some row lacks that key.
+ *
+ * `column<V>` and `mask` expose a key's values for scans
+ * across all rows, e.g.
+ * <pre class="markdeep">
+ * ```c++
+ * DynamicHMapBatch batch(dK<double>("height"), dK<std::string>("name"));
+ * batch.append(myMap);
+ * const std::vector<double>& heights = batch.column(dK<double>("height"));
+ * ```
+ * </pre>
+ *
+ * @warning As with `std::vector`, references obtained
+ * from rows or columns are invalidated by `append`.
+ * @note Schema types must be default-constructible.
+ ******************************************************/
+class DynamicHMapBatch : public detail::DynamicHMapBase {
+	std::vector<detail::KeyBase> schema_; ///< Sorted by `detail::KeyBase::operator<`.
+	std::vector<std::unique_ptr<detail::BatchColumnBase> > columns_; ///< `columns_[i]` holds the values of `schema_[i]`.
+	std::vector<std::pair<std::size_t, DynamicHMap> > overflow_; ///< Keys outside the schema, for the rows which have any, by ascending row.
+	std::size_t rows_ = 0;
+	std::vector<std::uint8_t> filled_; ///< Scratch space for `appendEntries`.
+	std::vector<std::pair<detail::KeyBase, std::any> > extra_; ///< Scratch space for `appendEntries`.
+
+	/// `K` is a `detail::KeyBase` or `detail::KeyView`. @return The index of `k` in the schema, or `schema_.size()` if it is absent.
+	template<typename K>
+	std::size_t columnOf(const K& k) const {
+		const auto found = std::lower_bound(schema_.cbegin(), schema_.cend(), k, detail::KeyBaseLess());
+		return (schema_.cend() != found && detail::KeyBaseEqual()(*found, k)) ? std::size_t(found - schema_.cbegin()) : schema_.size();
+	}
+
+	/// @return The overflow map for `row`, or `nullptr` if it has none.
+	const DynamicHMap* overflowOf(std::size_t row) const {
+		const auto found = std::lower_bound(overflow_.cbegin(), overflow_.cend(), row,
+		                                    [](const std::pair<std::size_t, DynamicHMap>& o, std::size_t row) { return o.first < row; });
+		return (overflow_.cend() != found && found->first == row) ? &found->second : nullptr;
+	}
+
+	/// `K` is a `detail::KeyBase` or `detail::KeyView`.
+	template<typename V, typename K>
+	boost::optional<const V&> lookup(std::size_t row, const K& k) const {
+		const std::size_t c = columnOf(k);
+		if(c != schema_.size()) {
+			// No check required: columns are only ever built against their own key's type.
+			const auto& column = static_cast<const detail::BatchColumn<V>&>(*columns_[c]);
+			return column.has(row) ? boost::optional<const V&>(column.at(row)) : boost::none;
+		}
+		const DynamicHMap *extra = overflowOf(row);
+		if(!extra) {
+			return boost::none;
+		}
+		const auto it = extra->find(k);
+		return (extra->cend() != it) ? boost::optional<const V&>(std::any_cast<const V&>(it->second)) : boost::none;
+	}
+
+	/// Append a row from the type-erased key-value pairs in `[first, last)`, moving their values if `Move`.
+	template<bool Move, typename It>
+	std::size_t appendEntries(It first, It last) {
+		filled_.assign(schema_.size(), 0);
+		extra_.clear();
+		// Should anything below throw, leave every column as long as the rows already appended.
+		struct Rollback {
+			DynamicHMapBatch *batch;
+			~Rollback() {
+				if(batch) {
+					for(auto& column : batch->columns_) {
+						column->truncate(batch->rows_);
+					}
+				}
+			}
+		} rollback{this};
+		for(; first != last; ++first) {
+			const std::size_t c = columnOf(first->first);
+			if constexpr (Move) {
+				if(c == schema_.size()) {
+					extra_.emplace_back(first->first, std::move(first->second));
+				} else {
+					columns_[c]->push(std::move(first->second));
+					filled_[c] = 1;
+				}
+			} else {
+				if(c == schema_.size()) {
+					extra_.emplace_back(first->first, first->second);
+				} else {
+					columns_[c]->push(first->second);
+					filled_[c] = 1;
+				}
+			}
+		}
+		for(std::size_t c = 0; c < schema_.size(); ++c) {
+			if(!filled_[c]) {
+				columns_[c]->pushMissing();
+			}
+		}
+		if(!extra_.empty()) {
+			overflow_.emplace_back(rows_, DynamicHMap(std::make_move_iterator(extra_.begin()), std::make_move_iterator(extra_.end()), first_wins));
+		}
+		rollback.batch = nullptr;
+		return rows_++;
+	}
+
+	/// Functor for use with boost::transform_iterator
+	struct RowMaker;
+
+  public:
+	/// A read-only view of one row of a `DynamicHMapBatch`, with the lookup API of a `const DynamicHMap`.
+	class Row {
+		const DynamicHMapBatch *batch_;
+		std::size_t row_;
+
+	  public:
+		Row(const DynamicHMapBatch &batch, std::size_t row)
+		: batch_(&batch), row_(row) {}
+
+		/// Find the `V` mapped by `k`, if present.
+		template<typename V>
+		boost::optional<const V&> operator()(const detail::Key<V>& k) const {
+			return batch_->lookup<V>(row_, static_cast<const detail::KeyBase&>(k));
+		}
+
+		/// Find the `V` mapped by `(k, tag)`, if present, without building a `detail::Key`.
+		template<typename V>
+		boost::optional<const V&> operator()(std::string_view k, const KeyTag<V>& tag) const {
+			return batch_->lookup<V>(row_, detail::KeyView(k, tag));
+		}
+
+		/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of optional references.
+		template <typename... Vs>
+		auto operator()(multi_tag, const detail::Key<Vs>& ...ks) const {
+			return std::make_tuple((*this)(ks)...);
+		}
+
+		/// Find a matching key value pair and return a reference to the value
+		template<typename V>
+		const V& at(const detail::Key<V>& k) const {
+			const boost::optional<const V&> found = (*this)(k);
+			if(!found) {
+				keyNotFound(k);
+			}
+			return *found;
+		}
+		/// Find a matching key value pair and return a reference to the value
+		template<typename V>
+		const V& at(std::string_view k, const KeyTag<V>& tag) const {
+			const boost::optional<const V&> found = (*this)(k, tag);
+			if(!found) {
+				keyNotFound(detail::KeyBase(k, tag));
+			}
+			return *found;
+		}
+
+		/// `1` if `kb` is present in this row, `0` otherwise.
+		size_t count(const detail::KeyBase& kb) const {
+			const std::size_t c = batch_->columnOf(kb);
+			if(c != batch_->schema_.size()) {
+				return batch_->columns_[c]->has(row_);
+			}
+			const DynamicHMap *extra = batch_->overflowOf(row_);
+			return extra && extra->cend() != extra->find(kb);
+		}
+
+		/// Copy this row out into a `DynamicHMap`, e.g. to iterate over it.
+		DynamicHMap toMap() const {
+			std::vector<std::pair<detail::KeyBase, std::any> > entries;
+			for(std::size_t c = 0; c < batch_->schema_.size(); ++c) {
+				if(batch_->columns_[c]->has(row_)) {
+					entries.emplace_back(batch_->schema_[c], batch_->columns_[c]->get(row_));
+				}
+			}
+			const std::size_t inSchema = entries.size();
+			if(const DynamicHMap *extra = batch_->overflowOf(row_)) {
+				entries.insert(entries.end(), extra->cbegin(), extra->cend());
+			}
+			// Both halves are already sorted, and disjoint.
+			std::inplace_merge(entries.begin(), entries.begin() + inSchema, entries.end(),
+			                   [](const auto& l, const auto& r) { return l.first < r.first; });
+			return DynamicHMap(sorted_unique, std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+		}
+
+		/// Number of entries in this row. O(number of schema keys).
+		size_t size() const {
+			size_t n = 0;
+			for(const auto& column : batch_->columns_) {
+				n += column->has(row_);
+			}
+			const DynamicHMap *extra = batch_->overflowOf(row_);
+			return n + (extra ? extra->size() : 0);
+		}
+		bool empty() const { return size() == 0; } ///< `true` if `size() == 0`, `false` otherwise.
+
+		std::size_t index() const { return row_; } ///< The index of this row in its batch.
+	};
+
+	using const_iterator = boost::transform_iterator<RowMaker, boost::counting_iterator<std::size_t> >; ///< const iterator over rows.
+
+	/// Create an empty batch whose schema is `schema`. Repeated keys are ignored.
+	template<typename... Vs>
+	explicit DynamicHMapBatch(const detail::Key<Vs>& ...schema) {
+		std::vector<std::pair<detail::KeyBase, std::unique_ptr<detail::BatchColumnBase> > > staging;
+		staging.reserve(sizeof...(Vs));
+		(staging.emplace_back(schema, std::make_unique<detail::BatchColumn<Vs> >()), ...);
+		std::stable_sort(staging.begin(), staging.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+		for(auto& [key, column] : staging) {
+			if(schema_.empty() || schema_.back() != key) {
+				schema_.push_back(key);
+				columns_.push_back(std::move(column));
+			}
+		}
+	}
+
+	DynamicHMapBatch(DynamicHMapBatch &&) = default;
+	DynamicHMapBatch& operator=(DynamicHMapBatch &&) = default;
+	DynamicHMapBatch(const DynamicHMapBatch &other)
+	: schema_(other.schema_), overflow_(other.overflow_), rows_(other.rows_) {
+		columns_.reserve(other.columns_.size());
+		for(const auto& column : other.columns_) {
+			columns_.push_back(column->clone());
+		}
+	}
+	DynamicHMapBatch& operator=(const DynamicHMapBatch &other) {
+		if(this != &other) {
+			DynamicHMapBatch copy(other);
+			*this = std::move(copy);
+		}
+		return *this;
+	}
+
+	/// Append a copy of `m` as a new row. @return The index of the new row.
+	template<typename Backend>
+	std::size_t append(const BasicDynamicHMap<Backend>& m) {
+		return appendEntries<false>(m.cbegin(), m.cend());
+	}
+
+	/// Move the values of `m` into a new row, leaving `m` empty. @return The index of the new row.
+	template<typename Backend>
+	std::size_t append(BasicDynamicHMap<Backend>&& m) {
+		const std::size_t row = appendEntries<true>(m.map_.begin(), m.map_.end());
+		m.map_.clear();
+		return row;
+	}
+
+	/// A view of row `i`. @pre `i < size()`.
+	Row operator[](std::size_t i) const { return Row(*this, i); }
+	/// A view of row `i`. @throws std::out_of_range if `i >= size()`.
+	Row at(std::size_t i) const {
+		if(i >= rows_) {
+			detail::fail(std::out_of_range("DynamicHMapBatch: row index out of range"));
+		}
+		return Row(*this, i);
+	}
+
+	/// The values of `k` for every row, by row index. Rows without `k` hold a default-constructed `V` (cf. `mask`). `bool`s are `detail::BatchBool`s, which convert to `bool`.
+	template<typename V>
+	const std::vector<typename detail::BatchStorage<V>::type>& column(const detail::Key<V>& k) const {
+		const std::size_t c = columnOf(k);
+		if(c == schema_.size()) {
+			keyNotFound(k);
+		}
+		return static_cast<const detail::BatchColumn<V>&>(*columns_[c]).values;
+	}
+
+	/// A flag for every row, by row index, which is `1` if `kb` is present, or empty if `kb` is present in every row.
+	const std::vector<std::uint8_t>& mask(const detail::KeyBase& kb) const {
+		const std::size_t c = columnOf(kb);
+		if(c == schema_.size()) {
+			keyNotFound(kb);
+		}
+		return columns_[c]->present;
+	}
+
+	/// The schema's keys, in ascending order.
+	const std::vector<detail::KeyBase>& schema() const { return schema_; }
+
+	const_iterator cbegin() const;
+	const_iterator cend() const;
+
+	/// Reserve space in every column for `rows` rows.
+	void reserve(std::size_t rows) {
+		for(auto& column : columns_) {
+			column->reserve(rows);
+		}
+	}
+
+	size_t size() const { return rows_; } ///< Number of rows
+	bool empty() const { return rows_ == 0; } ///< `true` if `size() == 0`, `false` otherwise.
+	/// Remove every row, retaining the schema and column capacity.
+	void clear() {
+		for(auto& column : columns_) {
+			column->truncate(0);
+		}
+		overflow_.clear();
+		rows_ = 0;
+	}
+};
+
+struct DynamicHMapBatch::RowMaker {
+	const DynamicHMapBatch *batch;
+	Row operator()(std::size_t i) const { return Row(*batch, i); }
+};
+
+inline DynamicHMapBatch::const_iterator DynamicHMapBatch::cbegin() const {
+	return const_iterator(boost::counting_iterator<std::size_t>(0), RowMaker{this});
+}
+inline DynamicHMapBatch::const_iterator DynamicHMapBatch::cend() const {
+	return const_iterator(boost::counting_iterator<std::size_t>(rows_), RowMaker{this});
+}
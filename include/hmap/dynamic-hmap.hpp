@@ -26,83 +26,210 @@
 #include <algorithm>
 #include <any>
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <iterator>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <new>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <typeinfo>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include <boost/container_hash/hash.hpp>
+#include <boost/iterator/filter_iterator.hpp>
+#include <boost/iterator/indirect_iterator.hpp>
 #include <boost/iterator/transform_iterator.hpp>
 #include <boost/optional/optional.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include <hmap/flat-hash-map.hpp>
+#include <hmap/hmap-stats.hpp>
+#include <hmap/key-atom.hpp>
+#include <hmap/lookup-result.hpp>
+#include <hmap/type-id.hpp>
 
 namespace detail {
-	/// Polymorphic base class for `KeyTag`s.
+	/****************************************************
+	 * Polymorphic base class for `KeyTag`s.
+	 * 
+	 * Tags are constant-initialized singletons which are
+	 * never destroyed, so the destructor is trivial (and
+	 * protected, rather than virtual).
+	 ****************************************************/
 	struct KeyTagBase {
-		virtual ~KeyTagBase() = default;
+		const std::uint64_t id; ///< `typeId<V>` for the tagged type `V`: the same in every process.
+
 		virtual const std::type_info& info() const = 0;
+		/// Copy `v`, which holds the tagged type, into a new value built with `resource` if it is allocator-aware (cf. `makeValue`).
+		virtual std::any rebuild(const std::any &v, std::pmr::memory_resource *resource) const = 0;
+		/// As above, moving from `v`.
+		virtual std::any rebuild(std::any &&v, std::pmr::memory_resource *resource) const = 0;
+
+		/// Order by `id`; the address only breaks ties if two types' ids collide.
+		inline bool operator<(const KeyTagBase &t) const {
+			return id < t.id || (id == t.id && this < &t);
+		}
+
+	  protected:
+		constexpr explicit KeyTagBase(std::uint64_t i)
+		: id(i) {}
+		~KeyTagBase() = default;
+	};
+
+	/****************************************************
+	 * Records every tag's `id` when the program starts,
+	 * so that distinct types whose ids collide can be
+	 * reported. A collision is not an error: such types
+	 * are still distinct keys, ordered by address (cf.
+	 * `KeyTagBase::operator<`). It is expected for types
+	 * spelled the same way in different translation units,
+	 * e.g. same-named types in anonymous namespaces, or
+	 * local classes.
+	 * 
+	 * Collisions are listed by `KeyTagRegistry`, rather
+	 * than reported as they are found, since most are
+	 * found during static initialization.
+	 ****************************************************/
+	struct TypeIdRegistration {
+		explicit TypeIdRegistration(const KeyTagBase &tag);
 	};
 }
 
 /****************************************************
- * Each `KeyTag<V>` is a singleton. The address of 
- * each `detail::KeyTagBase` base object will give 
- * us a total ordering on types.
+ * Each `KeyTag<V>` is a singleton, and so has a 
+ * unique address per-type. Its `id` gives a total
+ * ordering on types which is the same in every
+ * process, for types whose spelling is unique in the
+ * program. Types spelled alike (e.g. same-named types
+ * in anonymous namespaces of different translation
+ * units) share an `id`, and are ordered among
+ * themselves by address, which may differ between
+ * processes.
  * 
- * Contains nothing and has no other purpose except
- * to provide a unique memory location per-type.
+ * The singleton is constant-initialized, so `tag()`
+ * never checks a guard variable.
  ****************************************************/
 template<typename V>
 class KeyTag : public detail::KeyTagBase {
-	KeyTag() = default;
+	constexpr KeyTag()
+	: KeyTagBase(detail::typeId<V>) {}
 	KeyTag(const KeyTag&) = delete;
 	KeyTag(KeyTag&&) = delete;
 
 	const std::type_info& info() const override {
 		return typeid(V);
 	}
+	std::any rebuild(const std::any &v, std::pmr::memory_resource *resource) const override;
+	std::any rebuild(std::any &&v, std::pmr::memory_resource *resource) const override;
+
+	static const KeyTag<V> theTag_;
+	static const detail::TypeIdRegistration registration_;
 
   public:
 	/// Obtain the singleton
-	static const KeyTag<V>& tag() {
-		static KeyTag<V> theTag_ = KeyTag<V>();
+	static constexpr const KeyTag<V>& tag() {
+		static_cast<void>(&registration_); // Instantiates (and so runs) the registration of every tag in use.
 		return theTag_;
 	}
 };
 
+template<typename V>
+const KeyTag<V> KeyTag<V>::theTag_;
+
+template<typename V>
+const detail::TypeIdRegistration KeyTag<V>::registration_{KeyTag<V>::theTag_};
+
+/******************************************************
+ * Process-wide view of every `KeyTag` in use (i.e.
+ * whose `tag()` is referenced anywhere in the program,
+ * or in a library it has loaded), by `id`.
+ ******************************************************/
+class KeyTagRegistry {
+  public:
+	/// The tag of each distinct type whose id is `id`: usually one, or none if no such type is in use.
+	static std::vector<const detail::KeyTagBase*> find(std::uint64_t id);
+	/// Each pair of distinct types found to share an id, in the order they were registered. Such types are ordered by address, which may differ between processes.
+	static std::vector<std::pair<const detail::KeyTagBase*, const detail::KeyTagBase*> > collisions();
+};
+
+namespace detail {
+#if defined(__GLIBCXX__)
+	constexpr std::size_t kAnyBufferSize = sizeof(void*); ///< Size of `std::any`'s small buffer.
+#else
+	constexpr std::size_t kAnyBufferSize = 3 * sizeof(void*); ///< Size of `std::any`'s small buffer (libc++'s, and no more than MSVC's).
+#endif
+	/// `true` if a `std::any` holding a `V` must store it on the heap, rather than in its small buffer.
+	template<typename V>
+	constexpr bool spillsFromAny = !(std::is_nothrow_move_constructible_v<V> && sizeof(V) <= kAnyBufferSize && alignof(V) <= alignof(void*));
+
+	/// Count a `V` about to be stored in a `std::any`, if it spills to the heap (only with `HMAP_ENABLE_STATS`).
+	template<typename V>
+	void countSpill() {
+#ifdef HMAP_ENABLE_STATS
+		if constexpr (spillsFromAny<V>) {
+			static std::atomic<std::uint64_t>& spills = spillCounter(KeyTag<V>::tag());
+			spills.fetch_add(1, std::memory_order_relaxed);
+		}
+#endif
+	}
+}
+
 namespace detail {
-	/// Polymorphic base class for `Key`, stores the string id + reference to type tag's base object.
+	/// Polymorphic base class for `Key`, stores the interned string id + reference to type tag's base object.
 	struct KeyBase {
-		std::string key; ///< The string we're looking up.
+		KeyAtom key; ///< The (interned) string we're looking up.
 		std::reference_wrapper<const KeyTagBase> tag; ///< A "type tag" which is guaranteed to have a unique address for each unique type.
+		/// Cached result of `hashOf(key, tag)`. @warning Stale if `key` or `tag` are reassigned directly.
+		std::size_t hash;
 		
-		KeyBase(const std::string &ki, const KeyTagBase &ti)
-		    : key(ki), tag(std::cref(ti)) {}
+		KeyBase(std::string_view ki, const KeyTagBase &ti)
+		    : KeyBase(KeyAtom(ki), ti) {}
+		KeyBase(const KeyAtom &ki, const KeyTagBase &ti)
+		    : key(ki), tag(std::cref(ti)), hash(hashOf(ki, ti)) {}
 		KeyBase(const KeyBase&) = default;
 		KeyBase(KeyBase&&) = default;
 		KeyBase& operator= (const KeyBase&) = default;
 		KeyBase& operator= (KeyBase&&) = default;
 		virtual ~KeyBase() = default;
 		
-		/// Compare lexicographically first, then by type tag.
+		/// Compare lexicographically first, then by type tag. Identical atoms skip the string comparison.
 		inline bool operator<(const KeyBase &k) const {
 			return key < k.key ||
-		           (key == k.key && &(tag.get()) < &(k.tag.get()));
+		           (key == k.key && tag.get() < k.tag.get());
 		}
 
-		/// @return `true` if both fields are identical, `false` otherwise
+		/// @return `true` if both fields are identical, `false` otherwise. Only compares hashes and addresses.
 		inline bool operator==(const KeyBase &k) const {
-			return key == k.key &&
-			       &(tag.get()) == &(k.tag.get());
+			return hash == k.hash &&
+			       &(tag.get()) == &(k.tag.get()) &&
+			       key == k.key;
 		}
 	
 		/// @return `false` if both fields are identical, `true` otherwise
 		inline bool operator!=(const KeyBase &k) const {
-			return key != k.key || &(tag.get()) != &(k.tag.get());
+			return !(*this == k);
+		}
+
+		/// Hash a (string, type tag) pair. Mixes the tag's `id` rather than its address, so is stable across processes.
+		static std::size_t hashOf(std::string_view k, const KeyTagBase &ti) {
+			std::size_t seed = std::hash<std::string_view>{}(k);
+			boost::hash_combine(seed, ti.id);
+			return seed;
+		}
+		/// Equivalent to `hashOf(k.view(), ti)`, reusing the hash cached in the atom.
+		static std::size_t hashOf(const KeyAtom &k, const KeyTagBase &ti) {
+			std::size_t seed = k.hash();
+			boost::hash_combine(seed, ti.id);
+			return seed;
 		}
 
 		/// @return The typeid of template parameter used to instatiate the type tag.
@@ -114,7 +241,10 @@ namespace detail {
 	/// A key mapping a string to a value of type `V`.
 	template<typename V>
 	struct Key : KeyBase {
-		Key(const std::string &k)
+		Key(std::string_view k)
+		: KeyBase(k, KeyTag<V>::tag()) {}
+
+		Key(const KeyAtom &k)
 		: KeyBase(k, KeyTag<V>::tag()) {}
 		
 		Key(const Key<V> &k)
@@ -128,6 +258,7 @@ namespace detail {
 		template<class A>
 		std::pair<KeyBase, std::any>
 		operator,(A&& a) const {
+			countSpill<V>();
 			return {std::piecewise_construct,
 			    std::forward_as_tuple(std::cref(*((KeyBase *)this))),
 			    std::forward_as_tuple(std::any{std::in_place_type<V>,
@@ -136,32 +267,555 @@ namespace detail {
 
 	private:
 		/// Unsafe constructor for use with `Key::try_rehydrate`.
-		template<typename FwdKeyBase, std::enable_if_t<std::is_same_v<std::remove_reference_t<std::remove_cv_t<FwdKeyBase>>, KeyBase>, bool> = true>
+		template<typename FwdKeyBase, std::enable_if_t<std::is_same_v<std::remove_cv_t<std::remove_reference_t<FwdKeyBase>>, KeyBase>, bool> = true>
 		Key(FwdKeyBase && fwdKeyBase) 
 		: KeyBase(std::forward<FwdKeyBase>(fwdKeyBase)) {}
 	
 	public:
-		/// "Upcast" a `KeyBase` back into `Key<V>` if the type-tags match.
-		template<typename FwdKeyBase, std::enable_if_t<std::is_same_v<std::remove_reference_t<std::remove_cv_t<FwdKeyBase>>, KeyBase>, bool> = true>
+		/// "Upcast" a `KeyBase` back into `Key<V>` if the type-tags match. @throws std::invalid_argument otherwise.
+		template<typename FwdKeyBase, std::enable_if_t<std::is_same_v<std::remove_cv_t<std::remove_reference_t<FwdKeyBase>>, KeyBase>, bool> = true>
 		static Key<V> try_rehydrate(FwdKeyBase&& fwdKeyBase) {
-			if(&(fwdKeyBase.tag.get()) == &static_cast<const KeyTagBase&>(KeyTag<V>::tag())) {
-				return Key<V>(std::forward<FwdKeyBase>(fwdKeyBase));
+			if(&(fwdKeyBase.tag.get()) != &static_cast<const KeyTagBase&>(KeyTag<V>::tag())) {
+				fail(std::invalid_argument("Cannot rehydrate: mismatched KeyTagBase addresses"));
+			}
+			return Key<V>(std::forward<FwdKeyBase>(fwdKeyBase));
+		}
+		/// As for `try_rehydrate(fwdKeyBase)`, but reports `LookupError::TypeMismatch` rather than throwing.
+		template<typename FwdKeyBase, std::enable_if_t<std::is_same_v<std::remove_cv_t<std::remove_reference_t<FwdKeyBase>>, KeyBase>, bool> = true>
+		static LookupResult<Key<V> > try_rehydrate(std::nothrow_t, FwdKeyBase&& fwdKeyBase) {
+			if(&(fwdKeyBase.tag.get()) != &static_cast<const KeyTagBase&>(KeyTag<V>::tag())) {
+				return LookupError::TypeMismatch;
+			}
+			return Key<V>(std::forward<FwdKeyBase>(fwdKeyBase));
+		}
+
+	};
+
+	/******************************************************
+	 * A non-owning, non-interning stand-in for a `KeyBase`,
+	 * used as a probe for heterogeneous lookup. Building one
+	 * hashes `key`, but never allocates.
+	 * @warning Must not outlive the characters viewed by `key`.
+	 ******************************************************/
+	struct KeyView {
+		std::string_view key; ///< The string we're looking up.
+		std::reference_wrapper<const KeyTagBase> tag; ///< As for `KeyBase::tag`.
+		std::size_t hash; ///< Matches `KeyBase::hash` for an equal `KeyBase`.
+
+		KeyView(std::string_view ki, const KeyTagBase &ti)
+		: key(ki), tag(std::cref(ti)), hash(KeyBase::hashOf(ki, ti)) {}
+		KeyView(const KeyBase &kb)
+		: key(kb.key.view()), tag(kb.tag), hash(kb.hash) {}
+
+		/// @return The typeid of template parameter used to instatiate the type tag.
+		inline const std::type_info& info() const {
+			return tag.get().info();
+		}
+	};
+
+	/// Hash functor for `KeyBase`, which just returns the cached hash.
+	struct KeyHash {
+		std::size_t operator()(const KeyBase &k) const {
+			return k.hash;
+		}
+		std::size_t operator()(const KeyView &k) const {
+			return k.hash;
+		}
+	};
+
+	/// Probe for the entries of an ordered store whose key is `name`, of any type. Never allocates.
+	struct NameProbe {
+		std::string_view name;
+	};
+
+	/// Probe for the entries of an ordered store whose key starts with `prefix`, of any type. Never allocates.
+	struct PrefixProbe {
+		std::string_view prefix;
+	};
+
+	/// Transparent `KeyBase::operator<`, permitting lookup by `KeyView`, and ranges by `NameProbe` or `PrefixProbe`.
+	struct KeyBaseLess {
+		using is_transparent = void;
+
+		bool operator()(const KeyBase &l, const KeyBase &r) const {
+			return l < r;
+		}
+		bool operator()(const KeyBase &l, const KeyView &r) const {
+			const int c = l.key.view().compare(r.key);
+			return c < 0 || (c == 0 && l.tag.get() < r.tag.get());
+		}
+		bool operator()(const KeyView &l, const KeyBase &r) const {
+			const int c = l.key.compare(r.key.view());
+			return c < 0 || (c == 0 && l.tag.get() < r.tag.get());
+		}
+		bool operator()(const KeyBase &l, const NameProbe &r) const {
+			return l.key.view() < r.name;
+		}
+		bool operator()(const NameProbe &l, const KeyBase &r) const {
+			return l.name < r.key.view();
+		}
+		// Keys starting with the prefix are equivalent to the probe, and sort between those before and after it.
+		bool operator()(const KeyBase &l, const PrefixProbe &r) const {
+			return l.key.view().substr(0, r.prefix.size()) < r.prefix;
+		}
+		bool operator()(const PrefixProbe &l, const KeyBase &r) const {
+			return l.prefix < r.key.view().substr(0, l.prefix.size());
+		}
+	};
+
+	/// Transparent `KeyBase::operator==`, permitting lookup by `KeyView`.
+	struct KeyBaseEqual {
+		using is_transparent = void;
+
+		bool operator()(const KeyBase &l, const KeyBase &r) const {
+			return l == r;
+		}
+		bool operator()(const KeyBase &l, const KeyView &r) const {
+			return l.hash == r.hash &&
+			       &(l.tag.get()) == &(r.tag.get()) &&
+			       l.key == r.key;
+		}
+	};
+
+	/// `true` if `Store` is ordered (i.e. a `std::map`), so that a multi-key operation can visit its keys in one sweep.
+	template<typename Store, typename = void>
+	struct IsOrderedStore : std::false_type {};
+	template<typename Store>
+	struct IsOrderedStore<Store, std::void_t<typename Store::key_compare> > : std::true_type {};
+
+	/// The value type of a `Key`.
+	template<typename K> struct KeyValue;
+	template<typename V> struct KeyValue<Key<V> > { using type = V; };
+
+	/// `true` for `DynamicHMapBase::first_wins_tag` and `DynamicHMapBase::last_wins_tag`.
+	template<typename Policy, typename Base>
+	constexpr bool isDuplicatePolicy = std::is_same_v<Policy, typename Base::first_wins_tag> || std::is_same_v<Policy, typename Base::last_wins_tag>;
+
+	/// Merge policy resolving keys present in both maps with `combine`, dispatched on `Ts...` (cf. `DynamicHMapBase::combine_with`).
+	template<typename Combiner, typename... Ts>
+	struct MergeCombiner {
+		Combiner combine;
+	};
+
+	/// `true` for every `MergeCombiner`.
+	template<typename Policy> struct IsMergeCombiner : std::false_type {};
+	template<typename Combiner, typename... Ts> struct IsMergeCombiner<MergeCombiner<Combiner, Ts...> > : std::true_type {};
+
+	/// `true` for the policies accepted by `BasicDynamicHMap::merge`.
+	template<typename Policy, typename Base>
+	constexpr bool isMergePolicy = isDuplicatePolicy<Policy, Base> || IsMergeCombiner<Policy>::value;
+
+	/// Grants `lookupStatic` access to `BasicDynamicHMap::lookupInOrder`.
+	struct StaticLookup;
+
+	/// Ordered backing store for `DynamicHMap`.
+	using OrderedStore = std::map<KeyBase, std::any, KeyBaseLess>;
+	/// Hashed backing store for `HashedDynamicHMap`.
+	using HashedStore = FlatHashMap<KeyBase, std::any, KeyHash, KeyBaseEqual>;
+	/// Ordered backing store for `PmrDynamicHMap`.
+	using PmrOrderedStore = std::pmr::map<KeyBase, std::any, KeyBaseLess>;
+	/// Hashed backing store for `PmrHashedDynamicHMap`.
+	using PmrHashedStore = FlatHashMap<KeyBase, std::any, KeyHash, KeyBaseEqual,
+	                                   std::pmr::polymorphic_allocator<std::pair<const KeyBase, std::any> > >;
+
+	/******************************************************
+	 * An ordered `Store` (e.g. `OrderedStore`) which also
+	 * maintains a secondary index of its entries by type
+	 * tag, so that the entries of one type can be counted
+	 * in O(1) time and visited in time proportional to
+	 * their number, rather than to `size()`.
+	 *
+	 * Each insertion or erasure also updates the index, in
+	 * O(log(number of entries of that type)) time. Since
+	 * the index holds iterators, `Store` must never move
+	 * its entries (so hashed stores are unsuitable).
+	 ******************************************************/
+	template<typename Store>
+	class TagIndexedStore : private Store {
+		static_assert(IsOrderedStore<Store>::value, "TagIndexedStore: the index requires a store whose iterators are never invalidated by other insertions or erasures.");
+
+	  public:
+		using typename Store::key_type;
+		using typename Store::mapped_type;
+		using typename Store::value_type;
+		using typename Store::key_compare;
+		using typename Store::allocator_type;
+		using typename Store::iterator;
+		using typename Store::const_iterator;
+		using typename Store::node_type;
+		using typename Store::insert_return_type;
+
+		/// Orders the (same-typed) entries of one tag by key.
+		struct ByKey {
+			using is_transparent = void;
+			bool operator()(const iterator &l, const iterator &r) const { return l->first.key < r->first.key; }
+			bool operator()(const iterator &l, const KeyBase &r) const { return l->first.key < r.key; }
+			bool operator()(const KeyBase &l, const iterator &r) const { return l.key < r->first.key; }
+		};
+		using Members = std::set<iterator, ByKey>; ///< The entries of one tag, in key order.
+
+	  private:
+		std::vector<std::pair<const KeyTagBase*, Members> > index_; ///< Searched linearly, since there are typically only a handful of types.
+
+		Members& members(const KeyTagBase &tag) {
+			for(auto& [indexTag, m] : index_) {
+				if(indexTag == &tag) {
+					return m;
+				}
+			}
+			return index_.emplace_back(&tag, Members()).second;
+		}
+		void indexed(iterator it) {
+			members(it->first.tag.get()).insert(it);
+		}
+		void unindexed(const_iterator it) {
+			Members& m = members(it->first.tag.get());
+			m.erase(m.find(it->first));
+		}
+		void reindex() {
+			index_.clear();
+			for(auto it = Store::begin(); it != Store::end(); ++it) {
+				indexed(it);
+			}
+		}
+
+	  public:
+		using Store::at;
+		using Store::begin;
+		using Store::end;
+		using Store::cbegin;
+		using Store::cend;
+		using Store::find;
+		using Store::lower_bound;
+		using Store::equal_range;
+		using Store::key_comp;
+		using Store::get_allocator;
+		using Store::size;
+		using Store::empty;
+
+		TagIndexedStore() = default;
+		explicit TagIndexedStore(const allocator_type &alloc)
+		: Store(alloc) {}
+		TagIndexedStore(const TagIndexedStore &other)
+		: Store(other) {
+			reindex();
+		}
+		TagIndexedStore(TagIndexedStore &&other) = default; ///< Moving a `Store` moves its nodes wholesale, so the index remains valid.
+		TagIndexedStore& operator=(const TagIndexedStore &other) {
+			Store::operator=(other);
+			reindex();
+			return *this;
+		}
+		TagIndexedStore& operator=(TagIndexedStore &&other) {
+			Store::operator=(std::move(other));
+			// Unequal, non-propagating allocators move entries one by one, invalidating the other index.
+			if constexpr (std::allocator_traits<allocator_type>::is_always_equal::value
+			              || std::allocator_traits<allocator_type>::propagate_on_container_move_assignment::value) {
+				index_ = std::move(other.index_);
 			} else {
-				throw std::invalid_argument("Cannot rehydrate: mismatched KeyTagBase addresses");
+				reindex();
 			}
+			other.index_.clear();
+			return *this;
 		}
 
+		template<typename ...Args>
+		iterator emplace_hint(const_iterator hint, Args&& ...args) {
+			const size_t before = size();
+			const iterator it = Store::emplace_hint(hint, std::forward<Args>(args)...);
+			if(size() != before) {
+				indexed(it);
+			}
+			return it;
+		}
+		template<typename ...Args>
+		std::pair<iterator, bool> try_emplace(const key_type &k, Args&& ...args) {
+			const auto result = Store::try_emplace(k, std::forward<Args>(args)...);
+			if(result.second) {
+				indexed(result.first);
+			}
+			return result;
+		}
+		mapped_type& operator[](const key_type &k) {
+			return try_emplace(k).first->second;
+		}
+		template<typename M>
+		std::pair<iterator, bool> insert_or_assign(const key_type &k, M&& m) {
+			const auto result = Store::insert_or_assign(k, std::forward<M>(m));
+			if(result.second) {
+				indexed(result.first);
+			}
+			return result;
+		}
+		insert_return_type insert(node_type &&nh) {
+			insert_return_type result = Store::insert(std::move(nh));
+			if(result.inserted) {
+				indexed(result.position);
+			}
+			return result;
+		}
+		iterator insert(const_iterator hint, node_type &&nh) {
+			const size_t before = size();
+			const iterator it = Store::insert(hint, std::move(nh));
+			if(size() != before) {
+				indexed(it);
+			}
+			return it;
+		}
+		node_type extract(const_iterator pos) {
+			unindexed(pos);
+			return Store::extract(pos);
+		}
+		node_type extract(iterator pos) {
+			return extract(const_iterator(pos));
+		}
+		template<typename K>
+		node_type extract(const K &k) {
+			const const_iterator found = Store::find(k);
+			return (Store::cend() != found) ? extract(found) : node_type();
+		}
+		iterator erase(const_iterator pos) {
+			unindexed(pos);
+			return Store::erase(pos);
+		}
+		iterator erase(iterator pos) {
+			return erase(const_iterator(pos));
+		}
+		void clear() {
+			Store::clear();
+			index_.clear();
+		}
+
+		/// The entries whose tag is `tag`, in key order.
+		const Members& tagged(const KeyTagBase &tag) const {
+			static const Members none;
+			for(const auto& [indexTag, m] : index_) {
+				if(indexTag == &tag) {
+					return m;
+				}
+			}
+			return none;
+		}
+	};
+
+	/// `true` if `Store` is a `TagIndexedStore`.
+	template<typename Store, typename = void>
+	struct HasTagIndex : std::false_type {};
+	template<typename Store>
+	struct HasTagIndex<Store, std::void_t<decltype(std::declval<const Store&>().tagged(std::declval<const KeyTagBase&>()))> > : std::true_type {};
+
+	/// Ordered backing store for `TagIndexedDynamicHMap`.
+	using TagIndexedOrderedStore = TagIndexedStore<OrderedStore>;
+
+	/// Predicate for use with boost::filter_iterator, matching entries of type `V`.
+	template<typename V>
+	struct HasTag {
+		template<typename Entry>
+		bool operator()(const Entry &e) const {
+			return &(e.first.tag.get()) == &KeyTag<V>::tag();
+		}
 	};
+
+	/******************************************************
+	 * Construct a `V` in a `std::any`. If `Alloc` is
+	 * stateful (e.g. a `std::pmr::polymorphic_allocator`)
+	 * and `V` is allocator-aware
+	 * (cf. [`std::uses_allocator`](https://en.cppreference.com/w/cpp/memory/uses_allocator)),
+	 * `V` is passed `alloc` so that its own allocations come
+	 * from the same resource as the map's nodes.
+	 ******************************************************/
+	template<typename V, typename Alloc, typename ...Args>
+	std::any makeValue(const Alloc& alloc, Args&& ...args) {
+		countSpill<V>();
+		if constexpr (std::allocator_traits<Alloc>::is_always_equal::value
+		              || !std::uses_allocator_v<V, Alloc>) {
+			return std::any{std::in_place_type<V>, std::forward<Args>(args)...};
+		} else if constexpr (std::is_constructible_v<V, std::allocator_arg_t, const Alloc&, Args...>) {
+			return std::any{std::in_place_type<V>, std::allocator_arg, alloc, std::forward<Args>(args)...};
+		} else {
+			return std::any{std::in_place_type<V>, std::forward<Args>(args)..., alloc};
+		}
+	}
 }
 
+// Types which can't be copied can't be held by a `std::any` either, so are never rebuilt.
+template<typename V>
+std::any KeyTag<V>::rebuild(const std::any &v, std::pmr::memory_resource *resource) const {
+	if constexpr (std::is_copy_constructible_v<V>) {
+		return detail::makeValue<V>(std::pmr::polymorphic_allocator<std::byte>(resource), std::any_cast<const V&>(v));
+	} else {
+		detail::fail(std::logic_error("KeyTag: cannot copy a non-copyable value"));
+	}
+}
+template<typename V>
+std::any KeyTag<V>::rebuild(std::any &&v, std::pmr::memory_resource *resource) const {
+	if constexpr (std::is_copy_constructible_v<V>) {
+		return detail::makeValue<V>(std::pmr::polymorphic_allocator<std::byte>(resource), std::any_cast<V&&>(std::move(v)));
+	} else {
+		detail::fail(std::logic_error("KeyTag: cannot move a non-copyable value"));
+	}
+}
+
+namespace detail {
+
+	/// Non-template members shared by every `BasicDynamicHMap` instantiation.
+	class DynamicHMapBase {
+	  public:
+		static constexpr struct multi_tag {} multi {}; ///< [tag-dispatch](https://en.wikibooks.org/wiki/More_C%2B%2B_Idioms/Tag_Dispatching) for `operator()`.
+		static constexpr struct sorted_unique_tag {} sorted_unique {}; ///< Tag-dispatch for constructors taking input already sorted by key, without duplicates.
+		static constexpr struct first_wins_tag {} first_wins {}; ///< Bulk-loading policy: of repeated keys, keep the first value (cf. `std::map::try_emplace`).
+		static constexpr struct last_wins_tag {} last_wins {}; ///< Bulk-loading policy: of repeated keys, keep the last value (cf. `std::map::insert_or_assign`).
+
+		/**************************************************
+		 * Merge policy: of keys in both maps, update the
+		 * left (destination) value in place by calling
+		 * `combine(key, left, right)`, with `left` as a
+		 * `T&` and `right` as a `T&&` (or `const T&`) if
+		 * the key's type is one of `Ts`, and both as
+		 * `std::any` otherwise.
+		 **************************************************/
+		template<typename... Ts, typename Combiner>
+		static MergeCombiner<std::decay_t<Combiner>, Ts...> combine_with(Combiner&& combine) {
+			return {std::forward<Combiner>(combine)};
+		}
+
+	  protected:
+		[[noreturn]] static void keyNotFound(const KeyBase& k);
+		[[noreturn]] static void keyNotFound(const KeyView& k);
+	};
+}
+
+namespace detail {
+	/// Compile-time open-addressed set of `N` type ids, for `TypeSwitch`.
+	template<std::size_t N>
+	struct TypeIdTable {
+		/// log2 of the table size, which is at least twice `N`, so that probes always reach an empty slot.
+		static constexpr unsigned Bits = [] {
+			unsigned b = 1;
+			while((std::size_t(1) << b) < 2 * N) {
+				++b;
+			}
+			return b;
+		}();
+		static constexpr std::size_t Size = std::size_t(1) << Bits;
+
+		std::array<std::uint64_t, Size> ids{};
+		std::array<std::size_t, Size> cases{}; ///< Index into the constructor's `ids`, or `N` for an empty slot.
+
+		/// Fibonacci hashing: the high bits of the product mix every bit of `id`.
+		static constexpr std::size_t slotOf(std::uint64_t id) {
+			return std::size_t((id * 0x9E3779B97F4A7C15ull) >> (64 - Bits));
+		}
+
+		constexpr explicit TypeIdTable(const std::array<std::uint64_t, N> &typeIds) {
+			for(std::size_t &c : cases) {
+				c = N;
+			}
+			for(std::size_t i = 0; i < N; ++i) {
+				std::size_t s = slotOf(typeIds[i]);
+				while(cases[s] != N && ids[s] != typeIds[i]) {
+					s = (s + 1) & (Size - 1);
+				}
+				ids[s] = typeIds[i];
+				cases[s] = i;
+			}
+		}
+
+		/// @return The index of `id` in the constructor's `ids`, or `N` if absent.
+		constexpr std::size_t find(std::uint64_t id) const {
+			for(std::size_t s = slotOf(id);; s = (s + 1) & (Size - 1)) {
+				if(cases[s] == N || ids[s] == id) {
+					return cases[s];
+				}
+			}
+		}
+	};
+}
+
+/******************************************************
+ * Dispatches type-erased `(detail::KeyBase, std::any)`
+ * entries to a visitor overloaded on value types, in
+ * place of a cascade of `typeid` comparisons (or Mach7
+ * pattern matching) per entry.
+ * 
+ * An open-addressed table of the `Ts`' type ids is built
+ * at compile-time, and a table of handlers once per
+ * visitor type, so dispatching an entry hashes its tag's
+ * `id`, (almost always) probes one slot, and makes one
+ * indirect call.
+ * 
+ * The visitor is called as `vis(key, value)`, with the
+ * value as a `T&` (or `const T&`) if its type `T` is
+ * one of `Ts`, and as the `std::any&` (or
+ * `const std::any&`) otherwise.
+ ******************************************************/
+template<typename ...Ts>
+class TypeSwitch {
+	static constexpr std::size_t N = sizeof...(Ts);
+	static constexpr detail::TypeIdTable<N> table_{{{detail::typeId<Ts>...}}};
+
+	template<typename T, typename Visitor, typename Any>
+	static void handle(Visitor &vis, const detail::KeyBase &k, Any &v) {
+		// Checked, since a distinct type may share `T`'s id (cf. `detail::TypeIdRegistration`).
+		if(auto *t = std::any_cast<T>(&v)) {
+			vis(k, *t);
+		} else {
+			vis(k, v);
+		}
+	}
+	template<typename Visitor, typename Any>
+	static void fallback(Visitor &vis, const detail::KeyBase &k, Any &v) {
+		vis(k, v);
+	}
+
+	template<typename Visitor, typename Any>
+	static void dispatch(Visitor &vis, const detail::KeyBase &k, Any &v) {
+		using Handler = void (*)(Visitor&, const detail::KeyBase&, Any&);
+		static constexpr Handler handlers[N + 1] = {&handle<Ts, Visitor, Any>..., &fallback<Visitor, Any>};
+		handlers[index(k.tag.get())](vis, k, v);
+	}
+
+  public:
+	/// @return The index in `Ts` of the type tagged by `tag`, or `sizeof...(Ts)` if it is none of them.
+	static std::size_t index(const detail::KeyTagBase &tag) {
+		return table_.find(tag.id);
+	}
+
+	/// Call `vis(k, value)` with `v` as a `const T&` if `k`'s type `T` is one of `Ts`, or as `v` otherwise.
+	template<typename Visitor>
+	static void visit(Visitor &&vis, const detail::KeyBase &k, const std::any &v) {
+		dispatch<std::remove_reference_t<Visitor>, const std::any>(vis, k, v);
+	}
+	/// Call `vis(k, value)` with `v` as a `T&` if `k`'s type `T` is one of `Ts`, or as `v` otherwise.
+	template<typename Visitor>
+	static void visit(Visitor &&vis, const detail::KeyBase &k, std::any &v) {
+		dispatch<std::remove_reference_t<Visitor>, std::any>(vis, k, v);
+	}
+};
+
+class FrozenDynamicHMap;
 
 /******************************************************
  * A "dynamic" `HMap`. It is dynamic in the sense that
  * the presence of individual keys is determined at
  * run-time, rather than at compile-time.
  * 
- * Backed by a `std::map`, with the various performance
- * guarantees that entails. 
+ * Backed by `Backend`, which must be a `std::map`-like
+ * container from `detail::KeyBase` to `std::any`, with
+ * the various performance guarantees that entails.
+ * Use `DynamicHMap` for a `std::map` (ordered) backing
+ * store, or `HashedDynamicHMap` for an open-addressing
+ * `detail::FlatHashMap`, which compares cached key hashes
+ * before comparing strings. `PmrDynamicHMap` and
+ * `PmrHashedDynamicHMap` allocate their nodes (and the
+ * contents of allocator-aware values) from a
+ * `std::pmr::memory_resource`, such as a per-batch
+ * `std::pmr::monotonic_buffer_resource`.
+ * 
+ * @note Key strings are interned (`detail::KeyAtom`),
+ * so are never allocated per-map. `std::any` does not
+ * support allocators, so values too large for its small
+ * buffer are still boxed on the global heap.
  * 
  * Also supports a functional-style lookup operation via
  * `operator(const Key<V>&)`, which returns a 
@@ -177,23 +831,56 @@ namespace detail {
  * @note Doesn't currently support various "fancy" operations
  * from `std::map`. PRs happily accepted.
  ******************************************************/
-class DynamicHMap {
-	std::map<detail::KeyBase, std::any> map_; ///< Backing store
+template<typename Backend>
+class BasicDynamicHMap : public detail::DynamicHMapBase, private detail::InstanceStats {
+	Backend map_; ///< Backing store
+	friend class FrozenDynamicHMap; ///< Moves nodes out of `map_` when freezing.
+	friend class DynamicHMapBatch; ///< Moves values out of `map_` when appending rows.
+	friend struct detail::StaticLookup; ///< Passes `lookupInOrder` an order computed at compile-time.
 	
   public:
-	using value_type = decltype(map_)::value_type; ///< Type-unsafe key-value pairs
-	using const_iterator = decltype(map_)::const_iterator; ///< const iterator over contents.
+	using value_type = typename Backend::value_type; ///< Type-unsafe key-value pairs
+	using const_iterator = typename Backend::const_iterator; ///< const iterator over contents.
+	using allocator_type = typename Backend::allocator_type; ///< Used for nodes, and allocator-aware values.
 	
 	template<typename V> using specific_value_type = std::pair<detail::KeyBase, V&>; ///< Type-safe key-value pairs
 	template<typename V> using const_specific_value_type = std::pair<detail::KeyBase, const V&>; ///< Immutable type-safe key-value pairs.
 
-	static constexpr struct multi_tag {} multi {}; ///< [tag-dispatch](https://en.wikibooks.org/wiki/More_C%2B%2B_Idioms/Tag_Dispatching) for `operator()`.
-
   protected:
-	using iterator = decltype(map_)::iterator; ///< Exposing a mutable iterator on backing `std::any` store breaks soundness.
+	using iterator = typename Backend::iterator; ///< Exposing a mutable iterator on backing `std::any` store breaks soundness.
 	iterator begin(); ///< Permits unsound modifications to backing store, use with care
 	iterator end(); ///< Permits unsound modifications to backing store, use with care
 
+  private:
+	/// `map_.find(k)`, counted as a lookup.
+	template<typename K>
+	iterator locate(const K& k) {
+		const iterator found = map_.find(k);
+		countLookup(map_.end() != found);
+		return found;
+	}
+	/// `map_.find(k)`, counted as a lookup.
+	template<typename K>
+	const_iterator locate(const K& k) const {
+		const const_iterator found = map_.find(k);
+		countLookup(map_.cend() != found);
+		return found;
+	}
+	/// Count each key located by `sweep` as a lookup, and pass the result through.
+	template<typename Found>
+	const Found& counted(const Found& found) const {
+		for(const auto& f : found) {
+			countLookup(f.second);
+		}
+		return found;
+	}
+	/// `map_[k]`, counted as an insertion, which creates an entry (with no value) if `k` is absent.
+	std::any& slot(const detail::KeyBase& k) {
+		std::any& vHolder = map_[k];
+		countInsert(!vHolder.has_value());
+		return vHolder;
+	}
+
   public: 
 	/// Find the `V` mapped by `k`, if present.
 	template<typename V>
@@ -212,6 +899,24 @@ class DynamicHMap {
 		         ? boost::optional<V&>(it->second)
 				 : boost::none);
 	}
+
+	/// Find the `V` mapped by `(k, tag)`, if present, without building a `detail::Key`.
+	template<typename V>
+	boost::optional<const V&> operator()(std::string_view k, const KeyTag<V>& tag) const {
+		const auto it = find(k, tag);
+		return ((cend<V>() != it)
+		         ? boost::optional<const V&>(it->second)
+				 : boost::none);
+	}
+
+	/// Find the `V` mapped by `(k, tag)`, if present, without building a `detail::Key`.
+	template<typename V>
+	boost::optional<V&> operator()(std::string_view k, const KeyTag<V>& tag) {
+		const auto it = find(k, tag);
+		return ((end<V>() != it)
+		         ? boost::optional<V&>(it->second)
+				 : boost::none);
+	}
 	
 	// Clear the map
 	void clear();
@@ -248,20 +953,317 @@ class DynamicHMap {
 	/// Move N sorted key-value pairs into array in key order in O(N) time
 	template <size_t N, typename Indices = std::make_index_sequence<N> >
 	constexpr void loadHMap(std::array<std::pair<detail::KeyBase, std::any>, N>&& a) {
+		const size_t before = map_.size();
 		loadHMapImpl(std::move(a), Indices{});
+		countInserts(N, map_.size() - before);
+	}
+
+	/// Convert an element of a bulk-loaded range, either a `(detail::Key<V>, V)` or a `(detail::KeyBase, std::any)` pair, to a type-erased key-value pair.
+	template<typename P>
+	std::pair<detail::KeyBase, std::any> toEntry(P&& p) {
+		using Pair = std::remove_cv_t<std::remove_reference_t<P> >;
+		if constexpr (std::is_same_v<std::decay_t<typename Pair::second_type>, std::any>) {
+			return {p.first, std::forward<P>(p).second};
+		} else {
+			using V = typename detail::KeyValue<std::decay_t<typename Pair::first_type> >::type;
+			return {p.first, detail::makeValue<V>(map_.get_allocator(), std::forward<P>(p).second)};
+		}
+	}
+
+	/// Load sorted key-value pairs from `[first, last)` in O(N) time, as for `loadHMap`.
+	template<typename InputIt>
+	void loadSorted(InputIt first, InputIt last) {
+		const size_t before = map_.size();
+		size_t n = 0;
+		for(; first != last; ++first, ++n) {
+			map_.emplace_hint(map_.cend(), toEntry(*first));
+		}
+		countInserts(n, map_.size() - before);
+	}
+
+	/// Reserve space in `c` for `[first, last)`, if it can be measured without consuming it.
+	template<typename InputIt, typename C>
+	static void reserveFor(InputIt first, InputIt last, C& c) {
+		if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+			c.reserve(c.size() + std::distance(first, last));
+		}
+	}
+
+	/// Ranges at least this long are sorted before insertion into ordered maps; sorting shorter ones costs more than it saves.
+	static constexpr size_t kBulkSortThreshold = 1024;
+
+	/// Insert `entry` into an ordered map, resolving a repeated key by `lastWins`. O(1) if `entry` sorts after the map's last key.
+	template<typename Entry>
+	void insertHinted(Entry&& entry, bool lastWins) {
+		const auto it = (map_.empty() || std::prev(map_.end())->first < entry.first) ? map_.end() : map_.lower_bound(entry.first);
+		if(map_.end() == it || it->first != entry.first) {
+			map_.emplace_hint(it, std::move(entry));
+			countInsert(true);
+		} else {
+			countInsert(false);
+			if(lastWins) {
+				it->second = std::move(entry.second);
+			}
+		}
+	}
+
+	/// Stage `[first, last)`, sort it once (unless it is already sorted), then insert it into an ordered map with `insertHinted`.
+	template<typename InputIt>
+	void insertSorted(InputIt first, InputIt last, bool lastWins) {
+		std::vector<std::pair<detail::KeyBase, std::any> > entries;
+		reserveFor(first, last, entries);
+		for(; first != last; ++first) {
+			entries.push_back(toEntry(*first));
+		}
+		// Sort indices rather than entries, breaking ties by position, so each entry is moved just once, into the map.
+		std::vector<size_t> order(entries.size());
+		for(size_t i = 0; i < order.size(); ++i) {
+			order[i] = i;
+		}
+		const auto less = [&entries](size_t l, size_t r) {
+			return entries[l].first < entries[r].first || (l < r && entries[l].first == entries[r].first);
+		};
+		if(!std::is_sorted(order.begin(), order.end(), less)) {
+			std::sort(order.begin(), order.end(), less);
+		}
+		for(size_t i = 0; i < order.size(); ) {
+			size_t j = i + 1;
+			for(; j < order.size() && entries[order[j]].first == entries[order[i]].first; ++j) {}
+			insertHinted(std::move(entries[order[lastWins ? j - 1 : i]]), lastWins);
+			i = j;
+		}
+	}
+
+	/// `true` if type-erased values must be rebuilt to use this map's allocator: only possible for `std::pmr` allocators.
+	static constexpr bool kRebuildsValues = std::is_same_v<allocator_type, std::pmr::polymorphic_allocator<typename allocator_type::value_type> >;
+
+	/// `v`, which holds a value of `k`'s type from another map, copied or moved into a value built with this map's allocator, as for `makeValue`.
+	template<typename Value>
+	std::any adopt(const detail::KeyBase& k, Value&& v) const {
+		if constexpr (kRebuildsValues) {
+			return k.tag.get().rebuild(std::forward<Value>(v), map_.get_allocator().resource());
+		} else {
+			return std::any(std::forward<Value>(v));
+		}
+	}
+
+	/// Resolve `k`, present in both maps being merged, by `Policy`: `left` is this map's value, and `right` the other's.
+	template<typename Policy, typename Right>
+	void mergeConflict(const Policy& policy, const detail::KeyBase& k, std::any& left, Right&& right) {
+		if constexpr (std::is_same_v<Policy, last_wins_tag>) {
+			left = adopt(k, std::forward<Right>(right));
+		} else if constexpr (detail::IsMergeCombiner<Policy>::value) {
+			mergeCombine(policy, k, left, std::forward<Right>(right));
+		}
+	}
+
+	/// Dispatch `policy.combine` on the type of `k` through `TypeSwitch`.
+	template<typename Combiner, typename... Ts, typename Right>
+	static void mergeCombine(const detail::MergeCombiner<Combiner, Ts...>& policy, const detail::KeyBase& k, std::any& left, Right&& right) {
+		TypeSwitch<Ts...>::visit([&](const detail::KeyBase& key, auto& l) {
+			using T = std::remove_reference_t<decltype(l)>;
+			if constexpr (std::is_same_v<T, std::any>) {
+				policy.combine(key, l, std::forward<Right>(right));
+			} else if constexpr (std::is_const_v<std::remove_reference_t<Right> >) {
+				policy.combine(key, l, std::any_cast<const T&>(right));
+			} else {
+				policy.combine(key, l, std::any_cast<T&&>(std::move(right)));
+			}
+		}, k, left);
+	}
+
+	/// Find the lower bound of `k`, which sorts no earlier than `finger`, walking forward from it as `sweep` does.
+	template<typename It>
+	It seek(It finger, const detail::KeyBase& k) {
+		It probe = finger;
+		for(size_t steps = 0; map_.end() != probe && steps < kFingerSteps; ++probe, ++steps) {}
+		if(map_.end() == probe || !(probe->first < k)) {
+			for(; finger != probe && finger->first < k; ++finger) {}
+			return finger;
+		}
+		return map_.lower_bound(k);
+	}
+
+	/********************************************************
+	 * Shared implementation of each `merge`. Ordered maps
+	 * walk both maps in key order, so each entry of `other`
+	 * is inserted with an exact hint: O(N + M) in all, or
+	 * O(M log N) if `other` is much smaller. Entries only in
+	 * an rvalue `other` are spliced across as nodes when the
+	 * allocators compare equal. Other values are rebuilt with
+	 * this map's allocator (cf. `adopt`). Hashed maps reserve
+	 * space, then insert in `other`'s order.
+	 ********************************************************/
+	template<typename Other, typename Policy>
+	void mergeFrom(Other&& other, const Policy& policy) {
+		constexpr bool moving = !std::is_const_v<std::remove_reference_t<Other> >;
+		using Value = std::conditional_t<moving, std::any&&, const std::any&>;
+		const size_t before = map_.size(), n = other.map_.size();
+		if constexpr (detail::IsOrderedStore<Backend>::value) {
+			const bool splice = moving && map_.get_allocator() == other.map_.get_allocator();
+			auto pos = map_.begin();
+			for(auto it = other.map_.begin(); other.map_.end() != it; ) {
+				pos = seek(pos, it->first);
+				if(map_.end() != pos && pos->first == it->first) {
+					mergeConflict(policy, pos->first, pos->second, static_cast<Value>(it->second));
+					++it;
+				} else if constexpr (moving) {
+					if(splice) {
+						map_.insert(pos, other.map_.extract(it++));
+					} else {
+						map_.emplace_hint(pos, it->first, adopt(it->first, static_cast<Value>(it->second)));
+						++it;
+					}
+				} else {
+					map_.emplace_hint(pos, it->first, adopt(it->first, static_cast<Value>(it->second)));
+					++it;
+				}
+			}
+		} else {
+			map_.reserve(map_.size() + n);
+			for(auto& entry : other.map_) {
+				if constexpr (kRebuildsValues) {
+					// Only rebuild values which will be inserted.
+					const auto found = map_.find(entry.first);
+					if(map_.end() != found) {
+						mergeConflict(policy, found->first, found->second, static_cast<Value>(entry.second));
+					} else {
+						map_.emplace(entry.first, adopt(entry.first, static_cast<Value>(entry.second)));
+					}
+				} else {
+					// `try_emplace` leaves its arguments alone when the key is already present.
+					const auto result = map_.try_emplace(entry.first, static_cast<Value>(entry.second));
+					if(!result.second) {
+						mergeConflict(policy, result.first->first, result.first->second, static_cast<Value>(entry.second));
+					}
+				}
+			}
+		}
+		countInserts(n, map_.size() - before);
+		if constexpr (moving) {
+			other.map_.clear();
+		}
+	}
+
+	/// Sort `Vs...` key-value pairs in an array, then load them in O(N) time
+	template<typename ...Vs>
+	void loadUnsorted(Vs&& ...vs) {
+		// See closed [Geopipe/Cxx-Heterogeneous-Maps#5](https://github.com/Geopipe/Cxx-Heterogeneous-Maps/pull/5) 
+		// for why this is fine even if `sizeof...(Vs) == 0`.
+		std::array<std::pair<detail::KeyBase, std::any>, sizeof...(Vs)> argArray
+		    { std::forward<Vs>(vs)... };
+		std::sort(argArray.begin(), argArray.end(),
+		              [] (const std::pair<detail::KeyBase, std::any>& left,
+		                  const std::pair<detail::KeyBase, std::any>& right)
+		              {
+		                  return left.first < right.first;
+		              });
+		loadHMap(std::move(argArray));
 	}
 	
+	/// How far `sweep` walks forward from the previous key before searching from the root instead.
+	static constexpr size_t kFingerSteps = 2;
+
+	/************************************************************
+	 * Locate each of `keys`, which are visited in `order`.
+	 * For an ordered `Store`, `order` should be ascending: each
+	 * search then starts from the previous key's lower bound
+	 * (a "finger"), walking forward if the key is within
+	 * `kFingerSteps` nodes, and falling back to `lower_bound`
+	 * otherwise, so clustered keys are found in a single in-order
+	 * pass. A key out of order is still found, just without the
+	 * finger. Hashed stores just `find` each key.
+	 *
+	 * @return For each key (in argument order), its lower bound
+	 * (or, for a hashed `Store`, its position or `end()`), and
+	 * whether it was found there.
+	 ************************************************************/
+	template<typename Store, size_t N>
+	static auto sweep(Store& store, const std::array<const detail::KeyBase*, N>& keys, const std::array<size_t, N>& order) {
+		using It = decltype(store.begin());
+		std::array<std::pair<It, bool>, N> found;
+		if constexpr (detail::IsOrderedStore<Backend>::value) {
+			It finger = store.begin();
+			const detail::KeyBase *prev = nullptr;
+			for(const size_t i : order) {
+				const detail::KeyBase &k = *keys[i];
+				It it = finger;
+				if(prev && k < *prev) {
+					it = store.lower_bound(k);
+				} else {
+					// One comparison against the node `kFingerSteps` ahead decides whether to walk or search.
+					It probe = finger;
+					for(size_t steps = 0; store.end() != probe && steps < kFingerSteps; ++probe, ++steps) {}
+					if(store.end() == probe || !(probe->first < k)) {
+						for(; it != probe && it->first != k && it->first < k; ++it) {}
+					} else {
+						it = store.lower_bound(k);
+					}
+				}
+				found[i] = std::make_pair(it, store.end() != it && it->first == k);
+				finger = it;
+				prev = &k;
+			}
+		} else {
+			for(size_t i = 0; i < N; ++i) {
+				const It it = store.find(*keys[i]);
+				found[i] = std::make_pair(it, store.end() != it);
+			}
+		}
+		return found;
+	}
+
+	/// Build the result of `lookupInOrder` from `sweep`'s.
+	template<typename Self, typename Found, typename... Vs, size_t... Is>
+	static auto multiResult(const Found& found, std::index_sequence<Is...>, const detail::Key<Vs>& ...) {
+		return std::make_tuple((found[Is].second
+		        ? boost::optional<std::conditional_t<std::is_const_v<Self>, const Vs&, Vs&> >(
+		              std::any_cast<std::conditional_t<std::is_const_v<Self>, const Vs&, Vs&> >(found[Is].first->second))
+		        : boost::none)...);
+	}
+
+	/// As for `operator()(multi_tag, ...)`, in a single sweep over the map. @pre `order` is a permutation, and `order[i]` is the index of the `i`th least of `ks` (cf. `lookupStatic`, which computes it at compile-time).
+	template <typename... Vs>
+	auto lookupInOrder(const std::array<size_t, sizeof...(Vs)>& order, const detail::Key<Vs>& ...ks)
+	{
+		return multiResult<BasicDynamicHMap>(counted(sweep(map_, std::array<const detail::KeyBase*, sizeof...(Vs)>{{&ks...}}, order)),
+		                                     std::index_sequence_for<Vs...>{}, ks...);
+	}
+	/// As for the non-`const` `lookupInOrder`.
+	template <typename... Vs>
+	auto lookupInOrder(const std::array<size_t, sizeof...(Vs)>& order, const detail::Key<Vs>& ...ks) const
+	{
+		return multiResult<const BasicDynamicHMap>(counted(sweep(map_, std::array<const detail::KeyBase*, sizeof...(Vs)>{{&ks...}}, order)),
+		                                           std::index_sequence_for<Vs...>{}, ks...);
+	}
+
+	/// Move `arg`'s value (if any) into `vHolder`, which is either empty, or holds a `V`.
+	template <typename V>
+	void checkIn(std::any& vHolder, boost::optional<V>&& arg) {
+		if (!vHolder.has_value()) {
+			vHolder = detail::makeValue<V>(map_.get_allocator(), std::move(arg).value());
+		} else {
+			std::any_cast<V&>(vHolder) = std::move(arg).value();
+		}
+	}
+
 	/// `extract` a single key-value pair from the map, returning a type tag-node handle pair
 	template <typename V>
 	decltype(auto) extract1(const detail::Key<V>& k) {
-		return std::make_pair(k, std::move(map_.extract(k)));
+		auto node = map_.extract(k);
+		countLookup(bool(node));
+		countErase(bool(node));
+		return std::make_pair(k, std::move(node));
 	}
+
 	
 	/// `extract` a single key-value pair from the map, returning an optional that contains the value
 	template <typename V>
 	boost::optional<V> optCheckOut1(const detail::Key<V>& k) {
 		boost::optional<V> retval;
 		auto mapNodeHandle = map_.extract(k);
+		countLookup(bool(mapNodeHandle));
+		countErase(bool(mapNodeHandle));
 		if (mapNodeHandle) {
 			retval.emplace(std::any_cast<V&&>(std::move(mapNodeHandle.mapped())));
 		}
@@ -282,27 +1284,27 @@ class DynamicHMap {
 	void insert1(const detail::Key<V>& k, const detail::Key<W>& kPrime, X&& node_handle) {
 		static_assert(std::is_convertible_v<W, V>);
 		if (node_handle) {
-			// If allocators are type compatible, use move construction
-			// TODO: Loosen this a bit for polymorphic allocators
-			if constexpr (std::is_same<decltype(map_.get_allocator()),
-			              decltype(node_handle.get_allocator())>::value) {
+			// If node handles are type compatible, and allocators compare equal (which for
+			// polymorphic allocators means they share a memory resource), use move construction
+			if constexpr (std::is_same<typename Backend::node_type,
+			              std::remove_cv_t<std::remove_reference_t<X> > >::value) {
 				if (map_.get_allocator() == node_handle.get_allocator()) {
 					// If we can use the same key, do a node handle insert
 					// If we cannot, use try_emplace with move construction of
 					// the value portion of the key-value pair
 					if (k == kPrime) {
-						map_.insert(std::move(node_handle));
-					} else {
-						map_.try_emplace(k, std::move(node_handle.mapped()));
+						countInsert(map_.insert(std::move(node_handle)).inserted);
+						return;
+					} else if constexpr (std::is_same_v<V, W>) {
+						countInsert(map_.try_emplace(k, std::move(node_handle.mapped())).second);
+						return;
 					}
-				} else {
-					// Make sure we copy the value instead of moving it
-					map_.try_emplace(k, node_handle.mapped());
 				}
-			} else {
-				// Make sure we copy the value instead of moving it
-				map_.try_emplace(k, node_handle.mapped());
 			}
+			// Rebuild the value with our allocator: allocator-aware values must not keep
+			// referring to another map's memory resource. Others are simply moved.
+			W& w = std::any_cast<W&>(node_handle.mapped());
+			countInsert(map_.try_emplace(k, detail::makeValue<V>(map_.get_allocator(), std::move(w))).second);
 		}
 	}
 	
@@ -318,12 +1320,7 @@ class DynamicHMap {
 	template <typename V>
 	void optCheckIn1(boost::optional<V>&& arg, const detail::Key<V>& k) {
 		if (boost::none != arg) {
-			std::any& vHolder = map_[k];
-			if (!vHolder.has_value()) {
-				vHolder.emplace<V>();  // The type must be default constructible
-			}
-			V& vRef = std::any_cast<V&>(vHolder);
-			vRef = std::move(arg).value();
+			checkIn(slot(k), std::move(arg));
 		}
 	}
 	
@@ -339,75 +1336,117 @@ class DynamicHMap {
 	template <typename V>
 	void optCopyIn1(boost::optional<V&>&& arg, const detail::Key<V>& k) {
 		if (boost::none != arg) {
-			std::any& vHolder = map_[k];
+			std::any& vHolder = slot(k);
 			if (!vHolder.has_value()) {
-				vHolder.emplace<V>();	 // The type must be default constructible
+				vHolder = detail::makeValue<V>(map_.get_allocator());	 // The type must be default constructible
 			}
 			V& vRef = std::any_cast<V&>(vHolder);
 			vRef = std::move(arg).value();
 		}
 	}
 
-	[[noreturn]] static void keyNotFound(const detail::KeyBase& k);
-
   public:
-	DynamicHMap(DynamicHMap &&) = default;
-	DynamicHMap& operator=(DynamicHMap &&) = default;
-	DynamicHMap(const DynamicHMap &) = default;
-	DynamicHMap& operator=(const DynamicHMap &) = default;
-
-	/// Pass args through to the underlying `std::map`.
-	template<typename ...Args, std::enable_if_t<std::is_constructible_v<std::map<detail::KeyBase, std::any>, Args...>, bool> = true>
-	DynamicHMap(Args&& ...args)
+	BasicDynamicHMap(BasicDynamicHMap &&) = default;
+	BasicDynamicHMap& operator=(BasicDynamicHMap &&) = default;
+	BasicDynamicHMap(const BasicDynamicHMap &) = default;
+	BasicDynamicHMap& operator=(const BasicDynamicHMap &) = default;
+
+	/// Pass args through to the underlying `Backend`.
+	template<typename ...Args, std::enable_if_t<std::is_constructible_v<Backend, Args...>, bool> = true>
+	BasicDynamicHMap(Args&& ...args)
 	: map_(std::forward<Args>(args) ...) {}
 
 	/// Initialize map with `Vs...` key-value pairs. Do a fast array-based sort, and then linear build with insert hints.
 	template<typename ...Vs>
-	DynamicHMap(std::in_place_t, Vs&& ...vs) {
-		// See closed [Geopipe/Cxx-Heterogeneous-Maps#5](https://github.com/Geopipe/Cxx-Heterogeneous-Maps/pull/5) 
-		// for why this is fine even if `sizeof...(Vs) == 0`.
-		std::array<std::pair<detail::KeyBase, std::any>, sizeof...(Vs)> argArray
-		    { vs... };
-		std::sort(argArray.begin(), argArray.end(),
-		              [] (const std::pair<detail::KeyBase, std::any>& left,
-		                  const std::pair<detail::KeyBase, std::any>& right)
-		              {
-		                  return left.first < right.first;
-		              });
-		loadHMap(std::move(argArray));
+	BasicDynamicHMap(std::in_place_t, Vs&& ...vs) {
+		loadUnsorted(std::forward<Vs>(vs)...);
+	}
+
+	/// As for the `std::in_place_t` constructor, allocating nodes with `alloc`.
+	template<typename ...Vs>
+	BasicDynamicHMap(std::allocator_arg_t, const allocator_type& alloc, std::in_place_t, Vs&& ...vs)
+	: map_(alloc) {
+		loadUnsorted(std::forward<Vs>(vs)...);
+	}
+
+	/// Initialize map with `N` key-value pairs already sorted by `detail::KeyBase::operator<`, without duplicates, in O(N) time.
+	template<size_t N>
+	BasicDynamicHMap(sorted_unique_tag, std::array<std::pair<detail::KeyBase, std::any>, N>&& a) {
+		loadHMap(std::move(a));
+	}
+
+	/// As for the `sorted_unique_tag` constructor, allocating nodes with `alloc`.
+	template<size_t N>
+	BasicDynamicHMap(std::allocator_arg_t, const allocator_type& alloc, sorted_unique_tag,
+	                 std::array<std::pair<detail::KeyBase, std::any>, N>&& a)
+	: map_(alloc) {
+		loadHMap(std::move(a));
+	}
+
+	/// Initialize map with the key-value pairs in `[first, last)`, already sorted by `detail::KeyBase::operator<`, without duplicates, in O(N) time.
+	template<typename InputIt>
+	BasicDynamicHMap(sorted_unique_tag, InputIt first, InputIt last) {
+		loadSorted(first, last);
+	}
+
+	/// As for the `sorted_unique_tag` range constructor, allocating nodes with `alloc`.
+	template<typename InputIt>
+	BasicDynamicHMap(std::allocator_arg_t, const allocator_type& alloc, sorted_unique_tag, InputIt first, InputIt last)
+	: map_(alloc) {
+		loadSorted(first, last);
+	}
+
+	/// Initialize map with the `(detail::Key<V>, V)` or `(detail::KeyBase, std::any)` pairs in `[first, last)`, as for `insert_bulk`.
+	template<typename InputIt, typename Policy, std::enable_if_t<detail::isDuplicatePolicy<Policy, detail::DynamicHMapBase>, bool> = true>
+	BasicDynamicHMap(InputIt first, InputIt last, Policy policy) {
+		insert_bulk(first, last, policy);
+	}
+
+	/// As for the bulk-loading constructor, allocating nodes with `alloc`.
+	template<typename InputIt, typename Policy, std::enable_if_t<detail::isDuplicatePolicy<Policy, detail::DynamicHMapBase>, bool> = true>
+	BasicDynamicHMap(std::allocator_arg_t, const allocator_type& alloc, InputIt first, InputIt last, Policy policy)
+	: map_(alloc) {
+		insert_bulk(first, last, policy);
 	}
 
+	/// The allocator used for nodes (and allocator-aware values).
+	allocator_type get_allocator() const {
+		return map_.get_allocator();
+	}
+
+	using detail::InstanceStats::stats; ///< A snapshot of this map's counters (all zero unless built with `HMAP_ENABLE_STATS`).
+	using detail::InstanceStats::set_stats_label; ///< List this map in `DynamicHMapStatsRegistry::labelled()` (only with `HMAP_ENABLE_STATS`) until destroyed.
+
 
 
 	/// Find a matching key value pair, _or_ default construct one, and return a reference to the value
 	template<typename V>
 	V& operator[](const detail::Key<V>& k) {
-		std::any& vHolder = map_[k];
+		std::any& vHolder = slot(k);
 		if(!vHolder.has_value()) {
-			vHolder.emplace<V>(); // The type must be default constructible
+			vHolder = detail::makeValue<V>(map_.get_allocator()); // The type must be default constructible
 		}
 		// This will throw if it's not an appropriate type (but it has to be, since lookup succeeded)
 		return std::any_cast<V&>(vHolder);
 	}
 	
-	/// Find a matching key value pair and return a reference to the value
+	/// Find a matching key value pair and return a reference to the value. @throws std::out_of_range if absent.
 	template<typename V>
 	V& at(const detail::Key<V>& k) {
-		try {
-			return std::any_cast<V&>(map_.at(k));
-		} catch (const std::out_of_range& e) {
+		const auto found = locate(k);
+		if(map_.end() == found) {
 			keyNotFound(k);
 		}
+		return std::any_cast<V&>(found->second);
 	}
-	/// Find a matching key value pair and return a reference to the value
+	/// Find a matching key value pair and return a reference to the value. @throws std::out_of_range if absent.
 	template<typename V>
 	const V& at(const detail::Key<V>& k) const {
-		// This will throw if it's not an appropriate type
-		try {
-			return std::any_cast<const V&>(map_.at(k));
-		} catch (const std::out_of_range& e) {
+		const auto found = locate(k);
+		if(map_.end() == found) {
 			keyNotFound(k);
 		}
+		return std::any_cast<const V&>(found->second);
 	}
 	/*****************************************************************
 	 * Find a matching key value pair and return a `const` reference
@@ -416,19 +1455,85 @@ class DynamicHMap {
 	 * No non-`const` overload is provided as that permit unsound stores.
 	 *****************************************************************/
 	const std::any& at(const detail::KeyBase& kb) const {
-		try {
-			return map_.at(kb);
-		} catch (const std::out_of_range& e) {
+		const auto found = locate(kb);
+		if(map_.end() == found) {
 			keyNotFound(kb);
 		}
+		return found->second;
+	}
+	/// Find a matching key value pair and return a reference to the value, without building a `detail::Key`.
+	template<typename V>
+	V& at(std::string_view k, const KeyTag<V>& tag) {
+		const detail::KeyView kv(k, tag);
+		const auto found = locate(kv);
+		if(map_.end() == found) {
+			keyNotFound(kv);
+		}
+		return std::any_cast<V&>(found->second);
+	}
+	/// Find a matching key value pair and return a reference to the value, without building a `detail::Key`.
+	template<typename V>
+	const V& at(std::string_view k, const KeyTag<V>& tag) const {
+		const detail::KeyView kv(k, tag);
+		const auto found = locate(kv);
+		if(map_.end() == found) {
+			keyNotFound(kv);
+		}
+		return std::any_cast<const V&>(found->second);
 	}
 	
+	/// As for `at(k)`, but reports a miss as `LookupError::KeyNotFound` rather than throwing.
+	template<typename V>
+	LookupResult<V&> try_at(const detail::Key<V>& k) {
+		const auto found = locate(k);
+		if(map_.end() == found) {
+			return LookupError::KeyNotFound;
+		}
+		return std::any_cast<V&>(found->second);
+	}
+	/// As for `at(k)`, but reports a miss as `LookupError::KeyNotFound` rather than throwing.
+	template<typename V>
+	LookupResult<const V&> try_at(const detail::Key<V>& k) const {
+		const auto found = locate(k);
+		if(map_.end() == found) {
+			return LookupError::KeyNotFound;
+		}
+		return std::any_cast<const V&>(found->second);
+	}
+	/// As for `at(kb)`, but reports a miss as `LookupError::KeyNotFound` rather than throwing.
+	LookupResult<const std::any&> try_at(const detail::KeyBase& kb) const {
+		const auto found = locate(kb);
+		if(map_.end() == found) {
+			return LookupError::KeyNotFound;
+		}
+		return found->second;
+	}
+	/// As for `at(k, tag)`, but reports a miss as `LookupError::KeyNotFound` rather than throwing.
+	template<typename V>
+	LookupResult<V&> try_at(std::string_view k, const KeyTag<V>& tag) {
+		const auto found = locate(detail::KeyView(k, tag));
+		if(map_.end() == found) {
+			return LookupError::KeyNotFound;
+		}
+		return std::any_cast<V&>(found->second);
+	}
+	/// As for `at(k, tag)`, but reports a miss as `LookupError::KeyNotFound` rather than throwing.
+	template<typename V>
+	LookupResult<const V&> try_at(std::string_view k, const KeyTag<V>& tag) const {
+		const auto found = locate(detail::KeyView(k, tag));
+		if(map_.end() == found) {
+			return LookupError::KeyNotFound;
+		}
+		return std::any_cast<const V&>(found->second);
+	}
+
 	/// cf. `std::map::try_emplace`.
     template<typename V, typename ...Args>
 	auto try_emplace(const detail::Key<V>& k, Args&& ...args) {
 		auto [iter, inserted] =
-				map_.try_emplace(k, std::any{std::in_place_type<V>,
-							std::forward<Args>(args)...});
+				map_.try_emplace(k, detail::makeValue<V>(map_.get_allocator(),
+							std::forward<Args>(args)...));
+		countInsert(inserted);
 		return std::make_pair(boost::make_transform_iterator<AnyCaster<V> >(iter),
 							  inserted);
 	}
@@ -436,8 +1541,9 @@ class DynamicHMap {
     template<typename V, typename ...Args>
 	auto insert_or_assign(const detail::Key<V>& k, Args&& ...args) {
 		auto [iter, inserted] =
-				map_.insert_or_assign(k, std::any{std::in_place_type<V>,
-							std::forward<Args>(args)...});
+				map_.insert_or_assign(k, detail::makeValue<V>(map_.get_allocator(),
+							std::forward<Args>(args)...));
+		countInsert(inserted);
 		return std::make_pair(boost::make_transform_iterator<AnyCaster<V> >(iter),
 							  inserted);
 	}
@@ -450,13 +1556,80 @@ class DynamicHMap {
 	 *****************************************************************/
 	template<typename A>
 	auto unsafe_insert_or_assign(const detail::KeyBase& kB, A&& a) {
-		return map_.insert_or_assign(kB, std::forward<A>(a));
+		auto result = map_.insert_or_assign(kB, std::forward<A>(a));
+		countInsert(result.second);
+		return result;
+	}
+
+	/************************************************************************
+	 * Insert the `(detail::Key<V>, V)` or `(detail::KeyBase, std::any)`
+	 * pairs in `[first, last)` (pass move iterators to move the values).
+	 * Keys repeated within the range, or already in the map, are resolved
+	 * by `Policy`, either `first_wins` or `last_wins`.
+	 *
+	 * Ordered maps insert each pair in O(1) time if it sorts after the
+	 * map's last key, so building from sorted input takes O(N) time.
+	 * Long (forward) ranges are sorted once first, unless already sorted.
+	 * Hashed maps reserve space for the range, then insert in order.
+	 ************************************************************************/
+	template<typename InputIt, typename Policy, std::enable_if_t<detail::isDuplicatePolicy<Policy, detail::DynamicHMapBase>, bool> = true>
+	void insert_bulk(InputIt first, InputIt last, Policy) {
+		constexpr bool lastWins = std::is_same_v<Policy, last_wins_tag>;
+		if constexpr (!detail::IsOrderedStore<Backend>::value) {
+			reserveFor(first, last, map_);
+			for(; first != last; ++first) {
+				auto entry = toEntry(*first);
+				if constexpr (lastWins) {
+					countInsert(map_.insert_or_assign(entry.first, std::move(entry.second)).second);
+				} else {
+					countInsert(map_.try_emplace(entry.first, std::move(entry.second)).second);
+				}
+			}
+		} else {
+			if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+				if(size_t(std::distance(first, last)) >= kBulkSortThreshold) {
+					insertSorted(first, last, lastWins);
+					return;
+				}
+			}
+			for(; first != last; ++first) {
+				insertHinted(toEntry(*first), lastWins);
+			}
+		}
+	}
+
+	/************************************************************************
+	 * Insert every entry of `other`, resolving keys present in both maps
+	 * by `Policy`: `first_wins` keeps this map's value, `last_wins` takes
+	 * `other`'s, and `combine_with<Ts...>(combine)` combines them in place.
+	 * Entries are moved out of `other`, spliced across as nodes where the
+	 * allocators allow, and `other` is left empty.
+	 *
+	 * Linear in the size of both maps (cf. `mergeFrom`), rather than a
+	 * search per key.
+	 *
+	 * @note Values which aren't spliced across are rebuilt with this map's
+	 * allocator, as for `insert`, if it is a `std::pmr` allocator. With
+	 * other stateful allocators, allocator-aware values keep the allocator
+	 * they were built with, as for the copy constructor.
+	 * @pre `&other != this`.
+	 ************************************************************************/
+	template<typename Policy, std::enable_if_t<detail::isMergePolicy<Policy, detail::DynamicHMapBase>, bool> = true>
+	void merge(BasicDynamicHMap&& other, const Policy& policy) {
+		mergeFrom(std::move(other), policy);
+	}
+
+	/// As for the rvalue `merge`, copying `other`'s entries instead.
+	template<typename Policy, std::enable_if_t<detail::isMergePolicy<Policy, detail::DynamicHMapBase>, bool> = true>
+	void merge(const BasicDynamicHMap& other, const Policy& policy) {
+		mergeFrom(other, policy);
 	}
 
 	/// Extract key-value pairs from map for insert into another map
 	template <typename... Args>
 	auto extract(Args&&... args) {
-		return std::make_tuple(extract1(args)...);
+		// Each key is found afresh, in argument order (guaranteed by braced initialization), so a repeated key is only extracted once.
+		return std::tuple<decltype(extract1(args))...>{extract1(args)...};
 	}
 
 	/// Insert key-value pairs into map from extract from another map
@@ -471,19 +1644,21 @@ class DynamicHMap {
     /// Extract key-value pairs from the map, returning optionals that contain the values
 	template <typename... Args>
 	auto optCheckOut(Args&&... args) {
-		return std::make_tuple(optCheckOut1(args)...);
+		// Each key is found afresh, in argument order (guaranteed by braced initialization), so a repeated key is only extracted once.
+		return std::tuple<decltype(optCheckOut1(args))...>{optCheckOut1(args)...};
 	}
 	
 	/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of optional references.
+	/// Each key is found independently: sorting a handful of runtime keys costs more than a sweep saves.
 	template <typename... Vs>
-	auto operator()(DynamicHMap::multi_tag, const detail::Key<Vs>& ...ks)
+	auto operator()(multi_tag, const detail::Key<Vs>& ...ks)
 	{
 		return std::make_tuple((*this)(ks)...);
 	}
 	
 	/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of optional references.
 	template <typename... Vs>
-	auto operator()(DynamicHMap::multi_tag, const detail::Key<Vs>& ...ks) const
+	auto operator()(multi_tag, const detail::Key<Vs>& ...ks) const
 	{
 		return std::make_tuple((*this)(ks)...);
 	}
@@ -523,59 +1698,219 @@ class DynamicHMap {
 	
 	size_t size() const; ///< Number of entries
 	bool empty() const; ///< `true` if `size() == 0`, `false` otherwise.
+
+	/**********************************************************
+	 * Every entry of type `V`, as `specific_value_type<V>`,
+	 * in key order (for ordered backends). Comparing type tags
+	 * costs no virtual calls, but unless `Backend` indexes its
+	 * entries by type (cf. `TagIndexedDynamicHMap`), this still
+	 * visits every entry in the map.
+	 **********************************************************/
+	template<typename V>
+	auto range() {
+		if constexpr (detail::HasTagIndex<Backend>::value) {
+			const auto& members = map_.tagged(KeyTag<V>::tag());
+			return boost::make_iterator_range(
+			    boost::make_transform_iterator<AnyCaster<V> >(boost::make_indirect_iterator(members.cbegin())),
+			    boost::make_transform_iterator<AnyCaster<V> >(boost::make_indirect_iterator(members.cend())));
+		} else {
+			return boost::make_iterator_range(
+			    boost::make_transform_iterator<AnyCaster<V> >(boost::make_filter_iterator<detail::HasTag<V> >(map_.begin(), map_.end())),
+			    boost::make_transform_iterator<AnyCaster<V> >(boost::make_filter_iterator<detail::HasTag<V> >(map_.end(), map_.end())));
+		}
+	}
+	/// As for `range<V>()`, as `const_specific_value_type<V>`.
+	template<typename V>
+	auto const_range() const {
+		if constexpr (detail::HasTagIndex<Backend>::value) {
+			const auto& members = map_.tagged(KeyTag<V>::tag());
+			return boost::make_iterator_range(
+			    boost::make_transform_iterator<ConstAnyCaster<V> >(boost::make_indirect_iterator(members.cbegin())),
+			    boost::make_transform_iterator<ConstAnyCaster<V> >(boost::make_indirect_iterator(members.cend())));
+		} else {
+			return boost::make_iterator_range(
+			    boost::make_transform_iterator<ConstAnyCaster<V> >(boost::make_filter_iterator<detail::HasTag<V> >(map_.cbegin(), map_.cend())),
+			    boost::make_transform_iterator<ConstAnyCaster<V> >(boost::make_filter_iterator<detail::HasTag<V> >(map_.cend(), map_.cend())));
+		}
+	}
+	/// Every entry whose key is `name`, whatever its type, in O(log(`size()`) + k) time. Only for ordered backends. Never allocates.
+	template<typename B = Backend, std::enable_if_t<detail::IsOrderedStore<B>::value, bool> = true>
+	boost::iterator_range<const_iterator> equal_range(std::string_view name) const {
+		const auto [first, last] = map_.equal_range(detail::NameProbe{name});
+		return boost::make_iterator_range(const_iterator(first), const_iterator(last));
+	}
+	/// Every entry whose key starts with `prefix` (e.g. `"geom."`), whatever its type, in key order, in O(log(`size()`) + k) time. Only for ordered backends. Never allocates.
+	template<typename B = Backend, std::enable_if_t<detail::IsOrderedStore<B>::value, bool> = true>
+	boost::iterator_range<const_iterator> prefix_range(std::string_view prefix) const {
+		const auto [first, last] = map_.equal_range(detail::PrefixProbe{prefix});
+		return boost::make_iterator_range(const_iterator(first), const_iterator(last));
+	}
+
+	/// Call `vis(key, value)` for every entry, in iteration order, dispatching on its type via `TypeSwitch<Ts...>`.
+	template<typename ...Ts, typename Visitor>
+	void visit(Visitor &&vis) const {
+		for(const auto& [k, v] : map_) {
+			TypeSwitch<Ts...>::visit(vis, k, v);
+		}
+	}
+	/// As for `visit(vis) const`, but values are passed by mutable reference.
+	template<typename ...Ts, typename Visitor>
+	void visit(Visitor &&vis) {
+		for(auto& [k, v] : map_) {
+			TypeSwitch<Ts...>::visit(vis, k, v);
+		}
+	}
+
+	/// Number of entries of type `V`. O(1) time if `Backend` indexes its entries by type, O(`size()`) otherwise.
+	template<typename V>
+	size_t count() const {
+		if constexpr (detail::HasTagIndex<Backend>::value) {
+			return map_.tagged(KeyTag<V>::tag()).size();
+		} else {
+			return std::count_if(map_.cbegin(), map_.cend(), detail::HasTag<V>());
+		}
+	}
 	
 	/// Return an iterator to the located key-value pair, or to `end<V>()` if none exists. Prefer `operator()`.
 	template<typename V>
 	auto find(const detail::Key<V>& k) {
-		iterator found = map_.find(k);
+		iterator found = locate(k);
 		return boost::make_transform_iterator<AnyCaster<V> >(found);
 	}
 	/// Return an iterator to the located key-value pair, or to `cend<V>()` if none exists. Prefer `operator()`.
 	template<typename V>
 	auto find(const detail::Key<V>& k) const {
-		const_iterator found = map_.find(k);
+		const_iterator found = locate(k);
 		return boost::make_transform_iterator<ConstAnyCaster<V> >(found);
 	}
 	/// Return an iterator to the located type-erased key-value pair, or to `cend()` if none exists.
 	auto find(const detail::KeyBase& kb) const {
-		return map_.find(kb);
+		return locate(kb);
+	}
+	/// Return an iterator to the located type-erased key-value pair, or to `cend()` if none exists.
+	const_iterator find(const detail::KeyView& kv) const {
+		return locate(kv);
+	}
+	/// Return an iterator to the key-value pair located by `(k, tag)`, or to `end<V>()` if none exists. Never allocates.
+	template<typename V>
+	auto find(std::string_view k, const KeyTag<V>& tag) {
+		iterator found = locate(detail::KeyView(k, tag));
+		return boost::make_transform_iterator<AnyCaster<V> >(found);
+	}
+	/// Return an iterator to the key-value pair located by `(k, tag)`, or to `cend<V>()` if none exists. Never allocates.
+	template<typename V>
+	auto find(std::string_view k, const KeyTag<V>& tag) const {
+		const_iterator found = locate(detail::KeyView(k, tag));
+		return boost::make_transform_iterator<ConstAnyCaster<V> >(found);
 	}
 	
 	/// cf. `std::map::erase`.
 	template<typename V>
 	size_t erase(const detail::Key<V>& k) {
-		auto found = map_.find(k);
+		auto found = locate(k);
+		if(map_.end() == found) {
+			return 0;
+		} else {
+			map_.erase(found);
+			countErase(1);
+			return 1;
+		}
+	}
+
+	/// cf. `std::map::erase`, by a type-erased key (e.g. one listed in a `DynamicHMapPatch`).
+	size_t erase(const detail::KeyBase& k) {
+		auto found = locate(k);
 		if(map_.end() == found) {
 			return 0;
 		} else {
 			map_.erase(found);
+			countErase(1);
 			return 1;
 		}
 	}
 
 };
 
-/// Construct a `detail::Key<V>` with string key `k`.
+// Trivial members are `inline`, so that they are still inlined despite the `extern template` declarations below.
+template<typename Backend>
+inline typename BasicDynamicHMap<Backend>::iterator BasicDynamicHMap<Backend>::begin() {
+	return map_.begin();
+}
+template<typename Backend>
+inline typename BasicDynamicHMap<Backend>::iterator BasicDynamicHMap<Backend>::end() {
+	return map_.end();
+}
+template<typename Backend>
+inline typename BasicDynamicHMap<Backend>::const_iterator BasicDynamicHMap<Backend>::cbegin() const {
+	return map_.cbegin();
+}
+template<typename Backend>
+inline typename BasicDynamicHMap<Backend>::const_iterator BasicDynamicHMap<Backend>::cend() const {
+	return map_.cend();
+}
+template<typename Backend>
+inline size_t BasicDynamicHMap<Backend>::size() const { return map_.size(); }
+template<typename Backend>
+inline bool BasicDynamicHMap<Backend>::empty() const { return map_.empty(); }
+template<typename Backend>
+inline void BasicDynamicHMap<Backend>::clear() { map_.clear(); }
+
+/// `BasicDynamicHMap` ordered by `detail::KeyBase::operator<`.
+using DynamicHMap = BasicDynamicHMap<detail::OrderedStore>;
+/// `BasicDynamicHMap` backed by an open-addressing hash table.
+using HashedDynamicHMap = BasicDynamicHMap<detail::HashedStore>;
+/// `DynamicHMap` allocating from a `std::pmr::memory_resource`.
+using PmrDynamicHMap = BasicDynamicHMap<detail::PmrOrderedStore>;
+/// `HashedDynamicHMap` allocating from a `std::pmr::memory_resource`.
+using PmrHashedDynamicHMap = BasicDynamicHMap<detail::PmrHashedStore>;
+/// `DynamicHMap` which also indexes its entries by type, for `count<V>()` in O(1) time and `range<V>()` in time proportional to the result.
+using TagIndexedDynamicHMap = BasicDynamicHMap<detail::TagIndexedOrderedStore>;
+
+// Instantiated once, in the `dynamic-hmap` library.
+extern template class BasicDynamicHMap<detail::OrderedStore>;
+extern template class BasicDynamicHMap<detail::HashedStore>;
+extern template class BasicDynamicHMap<detail::PmrOrderedStore>;
+extern template class BasicDynamicHMap<detail::PmrHashedStore>;
+extern template class BasicDynamicHMap<detail::TagIndexedOrderedStore>;
+
+/**************************************************
+ * Construct a `detail::Key<V>` with string key `k`.
+ * Interns `k`, so hoisting long-lived keys, e.g.
+ * `static const auto kHeight = dK<double>("height");`
+ * makes subsequent lookups allocation-free.
+ **************************************************/
 template<typename V>
-detail::Key<V> dK(const std::string& k) {
+detail::Key<V> dK(std::string_view k) {
+	return detail::Key<V>(k);
+}
+/// Construct a `detail::Key<V>` with already-interned string key `k`.
+template<typename V>
+detail::Key<V> dK(const detail::KeyAtom& k) {
 	return detail::Key<V>(k);
 }
 /// Construct a `detail::Key<std::shared_ptr<V>>` with string key `k`.
 template<typename V>
-detail::Key<std::shared_ptr<V> > dSK(const std::string& k) {
+detail::Key<std::shared_ptr<V> > dSK(std::string_view k) {
+	return detail::Key<std::shared_ptr<V> >(k);
+}
+/// Construct a `detail::Key<std::shared_ptr<V>>` with already-interned string key `k`.
+template<typename V>
+detail::Key<std::shared_ptr<V> > dSK(const detail::KeyAtom& k) {
 	return detail::Key<std::shared_ptr<V> >(k);
 }
 /*************************************************
- * Construct a `DynamicHMap` from a sequence of 
+ * Construct a `DynamicHMap` (or other `Map`, e.g.
+ * `HashedDynamicHMap`) from a sequence of 
  * key-value pairs (`std::pair<detail::Key<V>,V>`).
  * Typical usage:
  * <pre class="markdeep">
  * ```c++
  * auto myMap = make_dynamic_hmap((dK<int>("foo"), 1), (dK<float>("bar"), 2.), (dK<std::string>("baz"),"hello"));
+ * auto myHashedMap = make_dynamic_hmap<HashedDynamicHMap>((dK<int>("foo"), 1));
  * ```
  * </pre>
  *************************************************/
-template<typename ...Vs>
-DynamicHMap make_dynamic_hmap(Vs&& ...vs) {
-	return DynamicHMap(std::in_place, std::forward<Vs>(vs)...);
+template<typename Map = DynamicHMap, typename ...Vs>
+Map make_dynamic_hmap(Vs&& ...vs) {
+	return Map(std::in_place, std::forward<Vs>(vs)...);
 }
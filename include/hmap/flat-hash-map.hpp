@@ -0,0 +1,469 @@
+#pragma once
+/************************************************************************************
+ * @file flat-hash-map.hpp An open-addressing hash table exposing the subset of the
+ * `std::map` interface required to back a @ref dynamic-hmap.hpp `BasicDynamicHMap`.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <hmap/lookup-result.hpp>
+
+namespace detail {
+	/******************************************************
+	 * A linear-probing hash table with backward-shift
+	 * deletion (no tombstones).
+	 *
+	 * Each slot's hash is kept in a separate, densely
+	 * packed metadata array, so a probe sequence only
+	 * touches the entries themselves once the full hash
+	 * has already matched.
+	 *
+	 * Provides node handles (`extract`/`insert`) with the
+	 * same shape as `std::map::node_type`, so that it can
+	 * be dropped in as a `BasicDynamicHMap` backend.
+	 *
+	 * @warning Unlike `std::map`, any insertion may rehash
+	 * and invalidate all iterators and references, and
+	 * `erase` may relocate other entries.
+	 *
+	 * @tparam Hash Must be callable on `K` (and on any
+	 * probe type passed to `find`).
+	 * @tparam KeyEqual Must be callable on `(K, K)` (and
+	 * on `(K, Probe)` for any such probe type).
+	 ******************************************************/
+	template<typename K, typename T, typename Hash,
+	         typename KeyEqual = std::equal_to<>,
+	         typename Allocator = std::allocator<std::pair<const K, T> > >
+	class FlatHashMap {
+	  public:
+		using key_type = K;
+		using mapped_type = T;
+		using value_type = std::pair<const K, T>;
+		using size_type = std::size_t;
+		using difference_type = std::ptrdiff_t;
+		using hasher = Hash;
+		using key_equal = KeyEqual;
+		using allocator_type = Allocator;
+
+	  private:
+		using AllocTraits = std::allocator_traits<Allocator>;
+		using Slot = std::optional<value_type>;
+		using SlotAllocator = typename AllocTraits::template rebind_alloc<Slot>;
+		using MetaAllocator = typename AllocTraits::template rebind_alloc<std::size_t>;
+
+		static constexpr std::size_t kEmpty = 0; ///< Metadata for an unoccupied slot.
+		static constexpr std::size_t kMinCapacity = 8; ///< Smallest non-zero table.
+		static constexpr unsigned kHashBits = std::numeric_limits<std::size_t>::digits;
+
+		std::vector<std::size_t, MetaAllocator> meta_; ///< `hash | 1` for occupied slots, `kEmpty` otherwise.
+		std::vector<Slot, SlotAllocator> slots_; ///< Entry storage, parallel to `meta_`.
+		size_type size_ = 0; ///< Number of occupied slots.
+		unsigned shift_ = kHashBits; ///< `kHashBits - log2(meta_.size())`, once allocated.
+		Hash hash_; ///< Hash function
+		KeyEqual eq_; ///< Equality predicate
+		Allocator alloc_; ///< Retained so that node handles can report it.
+
+		/// Never store `kEmpty` as the metadata for an occupied slot.
+		static constexpr std::size_t tagged(std::size_t h) { return h | 1; }
+
+		/// Fibonacci hashing, to spread poorly-mixed hashes across the table. Takes the high bits of the product, which depend on every bit of `h`, and ignores the low bit of `h` so that `h` and `tagged(h)` share a home.
+		std::size_t home(std::size_t h) const {
+			return ((h & ~std::size_t(1)) * std::size_t(0x9E3779B97F4A7C15ull)) >> shift_;
+		}
+		std::size_t next(std::size_t i) const { return (i + 1) & (meta_.size() - 1); }
+
+		/// Move the key out of an occupied slot. cf. `std::map::node_type::key()`, which is permitted to do the same.
+		static K&& stealKey(Slot& s) { return std::move(const_cast<K&>(s->first)); }
+
+		/// @return The slot index holding a key equal to `q`, or `meta_.size()` if not present.
+		template<typename Q>
+		std::size_t locate(const Q& q) const {
+			if(meta_.empty()) {
+				return 0;
+			}
+			const std::size_t h = tagged(hash_(q));
+			for(std::size_t i = home(h); meta_[i] != kEmpty; i = next(i)) {
+				if(meta_[i] == h && eq_(slots_[i]->first, q)) {
+					return i;
+				}
+			}
+			return meta_.size();
+		}
+
+		/// @pre `k` is not present, and there is room for one more entry.
+		template<typename ...Args>
+		std::size_t place(std::size_t h, Args&& ...args) {
+			std::size_t i = home(h);
+			while(meta_[i] != kEmpty) {
+				i = next(i);
+			}
+			// Only mark the slot occupied once construction has succeeded.
+			slots_[i].emplace(std::forward<Args>(args)...);
+			meta_[i] = h;
+			++size_;
+			return i;
+		}
+
+		/// Keep the load factor at or below 3/4.
+		void growFor(size_type n) {
+			if(n * 4 > meta_.size() * 3) {
+				std::size_t capacity = meta_.empty() ? kMinCapacity : meta_.size();
+				while(n * 4 > capacity * 3) {
+					capacity *= 2;
+				}
+				rehashTo(capacity);
+			}
+		}
+
+		void rehashTo(std::size_t capacity) {
+			std::vector<std::size_t, MetaAllocator> oldMeta(capacity, kEmpty, MetaAllocator(alloc_));
+			std::vector<Slot, SlotAllocator> oldSlots(capacity, SlotAllocator(alloc_));
+			oldMeta.swap(meta_);
+			oldSlots.swap(slots_);
+			size_ = 0;
+			for(shift_ = kHashBits; (std::size_t(1) << (kHashBits - shift_)) < capacity; --shift_) {}
+			for(std::size_t i = 0; i < oldMeta.size(); ++i) {
+				if(oldMeta[i] != kEmpty) {
+					place(oldMeta[i], stealKey(oldSlots[i]), std::move(oldSlots[i]->second));
+				}
+			}
+		}
+
+		/// Backward-shift deletion: pull displaced successors back towards their home slots.
+		void eraseAt(std::size_t i) {
+			slots_[i].reset();
+			meta_[i] = kEmpty;
+			--size_;
+			for(std::size_t j = next(i); meta_[j] != kEmpty; j = next(j)) {
+				const std::size_t h = home(meta_[j]);
+				// Entry at `j` may move to `i` only if its home does not lie cyclically in `(i, j]`.
+				const bool homeInGap = (i <= j) ? (i < h && h <= j) : (i < h || h <= j);
+				if(!homeInGap) {
+					slots_[i].emplace(stealKey(slots_[j]), std::move(slots_[j]->second));
+					meta_[i] = meta_[j];
+					slots_[j].reset();
+					meta_[j] = kEmpty;
+					i = j;
+				}
+			}
+		}
+
+		/// Rebuild from another table's entries, copying or moving them according to the value category of `Other`.
+		template<typename Other>
+		void assignFrom(Other&& other) {
+			clear();
+			growFor(other.size_);
+			for(std::size_t i = 0; i < other.meta_.size(); ++i) {
+				if(other.meta_[i] != kEmpty) {
+					if constexpr (std::is_rvalue_reference_v<Other&&>) {
+						place(other.meta_[i], stealKey(other.slots_[i]), std::move(other.slots_[i]->second));
+					} else {
+						place(other.meta_[i], *other.slots_[i]);
+					}
+				}
+			}
+		}
+
+		template<bool Const>
+		class Iterator {
+			friend class FlatHashMap;
+			template<bool> friend class Iterator;
+			using MetaPtr = const std::size_t*;
+			using SlotPtr = std::conditional_t<Const, const Slot*, Slot*>;
+			MetaPtr meta_ = nullptr;
+			MetaPtr metaEnd_ = nullptr;
+			SlotPtr slot_ = nullptr;
+
+			Iterator(MetaPtr meta, MetaPtr metaEnd, SlotPtr slot)
+			: meta_(meta), metaEnd_(metaEnd), slot_(slot) {
+				skip();
+			}
+			void skip() {
+				while(meta_ != metaEnd_ && *meta_ == kEmpty) {
+					++meta_;
+					++slot_;
+				}
+			}
+		  public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = FlatHashMap::value_type;
+			using difference_type = std::ptrdiff_t;
+			using reference = std::conditional_t<Const, const value_type&, value_type&>;
+			using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+			Iterator() = default;
+			/// Permit `iterator` -> `const_iterator`.
+			template<bool WasConst, std::enable_if_t<Const && !WasConst, bool> = true>
+			Iterator(const Iterator<WasConst>& it)
+			: meta_(it.meta_), metaEnd_(it.metaEnd_), slot_(it.slot_) {}
+
+			reference operator*() const { return **slot_; }
+			pointer operator->() const { return &**slot_; }
+			Iterator& operator++() {
+				++meta_;
+				++slot_;
+				skip();
+				return *this;
+			}
+			Iterator operator++(int) {
+				Iterator old = *this;
+				++*this;
+				return old;
+			}
+			friend bool operator==(const Iterator& a, const Iterator& b) { return a.meta_ == b.meta_; }
+			friend bool operator!=(const Iterator& a, const Iterator& b) { return a.meta_ != b.meta_; }
+		};
+
+	  public:
+		using iterator = Iterator<false>;
+		using const_iterator = Iterator<true>;
+
+		/// Owning handle to an entry removed from the table. cf. `std::map::node_type`.
+		class node_type {
+			friend class FlatHashMap;
+			std::optional<std::pair<K, T> > entry_;
+			std::optional<Allocator> alloc_;
+
+			node_type(Slot& s, const Allocator& a)
+			: entry_(std::in_place, stealKey(s), std::move(s->second)), alloc_(a) {}
+		  public:
+			using key_type = K;
+			using mapped_type = T;
+			using allocator_type = Allocator;
+
+			node_type() = default;
+			node_type(node_type&&) = default;
+			node_type& operator=(node_type&&) = default;
+
+			bool empty() const { return !entry_; }
+			explicit operator bool() const { return bool(entry_); }
+			K& key() const { return const_cast<K&>(entry_->first); }
+			T& mapped() const { return const_cast<T&>(entry_->second); }
+			allocator_type get_allocator() const { return *alloc_; }
+		};
+
+		/// cf. `std::map::insert_return_type`.
+		struct insert_return_type {
+			iterator position;
+			bool inserted;
+			node_type node;
+		};
+
+		FlatHashMap() = default;
+		explicit FlatHashMap(const Allocator& a)
+		: meta_(MetaAllocator(a)), slots_(SlotAllocator(a)), alloc_(a) {}
+		FlatHashMap(const FlatHashMap& other)
+		: meta_(other.meta_, MetaAllocator(AllocTraits::select_on_container_copy_construction(other.alloc_))),
+		  slots_(other.slots_, SlotAllocator(AllocTraits::select_on_container_copy_construction(other.alloc_))),
+		  size_(other.size_), shift_(other.shift_), hash_(other.hash_), eq_(other.eq_),
+		  alloc_(AllocTraits::select_on_container_copy_construction(other.alloc_)) {}
+		FlatHashMap(FlatHashMap&& other) noexcept
+		: meta_(std::move(other.meta_)), slots_(std::move(other.slots_)), size_(other.size_), shift_(other.shift_),
+		  hash_(std::move(other.hash_)), eq_(std::move(other.eq_)), alloc_(std::move(other.alloc_)) {
+			other.size_ = 0;
+		}
+		FlatHashMap& operator=(const FlatHashMap& other) {
+			if(this != &other) {
+				assignFrom(other);
+			}
+			return *this;
+		}
+		FlatHashMap& operator=(FlatHashMap&& other) {
+			if(this != &other) {
+				if(alloc_ == other.alloc_) {
+					meta_.swap(other.meta_);
+					slots_.swap(other.slots_);
+					std::swap(size_, other.size_);
+					std::swap(shift_, other.shift_);
+					std::swap(hash_, other.hash_);
+					std::swap(eq_, other.eq_);
+					other.clear();
+				} else {
+					assignFrom(std::move(other));
+				}
+			}
+			return *this;
+		}
+
+		allocator_type get_allocator() const { return alloc_; }
+
+		iterator begin() { return iterator(meta_.data(), meta_.data() + meta_.size(), slots_.data()); }
+		iterator end() { return iterator(meta_.data() + meta_.size(), meta_.data() + meta_.size(), slots_.data() + slots_.size()); }
+		const_iterator begin() const { return cbegin(); }
+		const_iterator end() const { return cend(); }
+		const_iterator cbegin() const { return const_iterator(meta_.data(), meta_.data() + meta_.size(), slots_.data()); }
+		const_iterator cend() const { return const_iterator(meta_.data() + meta_.size(), meta_.data() + meta_.size(), slots_.data() + slots_.size()); }
+
+		size_type size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+		/// Destroy all entries, but keep the table allocated.
+		void clear() {
+			for(std::size_t i = 0; i < meta_.size(); ++i) {
+				meta_[i] = kEmpty;
+				slots_[i].reset();
+			}
+			size_ = 0;
+		}
+		/// Ensure that `n` entries can be held without rehashing.
+		void reserve(size_type n) { growFor(n); }
+		/// Number of slots. cf. `std::unordered_map::bucket_count`.
+		size_type bucket_count() const { return meta_.size(); }
+		/// The slot at which probing for `q` starts. cf. `std::unordered_map::bucket`. @pre `bucket_count() > 0`.
+		template<typename Q>
+		size_type bucket(const Q& q) const { return home(tagged(hash_(q))); }
+
+		/// cf. `std::map::find`. May also be called with any `Q` supported by both `Hash` and `KeyEqual`.
+		template<typename Q>
+		iterator find(const Q& q) {
+			const std::size_t i = locate(q);
+			return (i < meta_.size()) ? iterator(meta_.data() + i, meta_.data() + meta_.size(), slots_.data() + i) : end();
+		}
+		/// cf. `std::map::find`. May also be called with any `Q` supported by both `Hash` and `KeyEqual`.
+		template<typename Q>
+		const_iterator find(const Q& q) const {
+			const std::size_t i = locate(q);
+			return (i < meta_.size()) ? const_iterator(meta_.data() + i, meta_.data() + meta_.size(), slots_.data() + i) : cend();
+		}
+		template<typename Q>
+		size_type count(const Q& q) const { return (locate(q) < meta_.size()) ? 1 : 0; }
+
+		/// cf. `std::map::try_emplace`.
+		template<typename ...Args>
+		std::pair<iterator, bool> try_emplace(const K& k, Args&& ...args) {
+			const std::size_t found = locate(k);
+			if(found < meta_.size()) {
+				return {iterator(meta_.data() + found, meta_.data() + meta_.size(), slots_.data() + found), false};
+			}
+			growFor(size_ + 1);
+			const std::size_t i = place(tagged(hash_(k)), std::piecewise_construct,
+			                            std::forward_as_tuple(k),
+			                            std::forward_as_tuple(std::forward<Args>(args)...));
+			return {iterator(meta_.data() + i, meta_.data() + meta_.size(), slots_.data() + i), true};
+		}
+
+		/// cf. `std::map::insert_or_assign`.
+		template<typename M>
+		std::pair<iterator, bool> insert_or_assign(const K& k, M&& m) {
+			auto result = try_emplace(k, std::forward<M>(m));
+			if(!result.second) {
+				result.first->second = std::forward<M>(m);
+			}
+			return result;
+		}
+
+		/// cf. `std::map::emplace`.
+		template<typename ...Args>
+		std::pair<iterator, bool> emplace(Args&& ...args) {
+			Slot staging(std::in_place, std::forward<Args>(args)...);
+			const std::size_t found = locate(staging->first);
+			if(found < meta_.size()) {
+				return {iterator(meta_.data() + found, meta_.data() + meta_.size(), slots_.data() + found), false};
+			}
+			growFor(size_ + 1);
+			const std::size_t h = tagged(hash_(staging->first));
+			const std::size_t i = place(h, stealKey(staging), std::move(staging->second));
+			return {iterator(meta_.data() + i, meta_.data() + meta_.size(), slots_.data() + i), true};
+		}
+		/// cf. `std::map::emplace_hint`. The hint is meaningless for a hash table, and is ignored.
+		template<typename ...Args>
+		iterator emplace_hint(const_iterator, Args&& ...args) {
+			return emplace(std::forward<Args>(args)...).first;
+		}
+
+		T& operator[](const K& k) {
+			return try_emplace(k).first->second;
+		}
+		T& at(const K& k) {
+			const std::size_t i = locate(k);
+			if(i >= meta_.size()) {
+				fail(std::out_of_range("FlatHashMap::at"));
+			}
+			return slots_[i]->second;
+		}
+		const T& at(const K& k) const {
+			const std::size_t i = locate(k);
+			if(i >= meta_.size()) {
+				fail(std::out_of_range("FlatHashMap::at"));
+			}
+			return slots_[i]->second;
+		}
+
+		/// cf. `std::map::erase`. Does not return an iterator, as backward-shifting may relocate later entries.
+		void erase(const_iterator pos) {
+			eraseAt(pos.slot_ - slots_.data());
+		}
+		/// cf. `std::map::erase`.
+		template<typename Q, std::enable_if_t<!std::is_convertible_v<const Q&, const_iterator>, bool> = true>
+		size_type erase(const Q& q) {
+			const std::size_t i = locate(q);
+			if(i < meta_.size()) {
+				eraseAt(i);
+				return 1;
+			}
+			return 0;
+		}
+
+		/// cf. `std::map::extract`.
+		node_type extract(const_iterator pos) {
+			const std::size_t i = pos.slot_ - slots_.data();
+			node_type nh(slots_[i], alloc_);
+			eraseAt(i);
+			return nh;
+		}
+		/// cf. `std::map::extract`.
+		template<typename Q, std::enable_if_t<!std::is_convertible_v<const Q&, const_iterator>, bool> = true>
+		node_type extract(const Q& q) {
+			const std::size_t i = locate(q);
+			if(i < meta_.size()) {
+				node_type nh(slots_[i], alloc_);
+				eraseAt(i);
+				return nh;
+			}
+			return node_type();
+		}
+
+		/// cf. `std::map::insert(node_type&&)`.
+		insert_return_type insert(node_type&& nh) {
+			if(!nh) {
+				return {end(), false, node_type()};
+			}
+			const std::size_t found = locate(nh.entry_->first);
+			if(found < meta_.size()) {
+				return {iterator(meta_.data() + found, meta_.data() + meta_.size(), slots_.data() + found), false, std::move(nh)};
+			}
+			growFor(size_ + 1);
+			const std::size_t i = place(tagged(hash_(nh.entry_->first)),
+			                            std::move(nh.entry_->first), std::move(nh.entry_->second));
+			nh.entry_.reset();
+			return {iterator(meta_.data() + i, meta_.data() + meta_.size(), slots_.data() + i), true, node_type()};
+		}
+	};
+}
@@ -0,0 +1,264 @@
+#pragma once
+/************************************************************************************
+ * @file flat-hmap.hpp A flat (struct-like) layout for the static heterogeneous maps
+ * of @ref hmap.hpp, storing values contiguously rather than in a tree of nodes.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <hmap/hmap.hpp>
+
+namespace detail {
+	/*****************************************************************************
+	 * @defgroup FlatLayout Building blocks for `FlatHMap`'s storage.
+	 * @{
+	 **/
+
+	/*******************************************
+	 * A head/tail aggregate of `Vs...`, laid out
+	 * exactly as a hand-written struct with one
+	 * member per `V`, in order.
+	 *
+	 * (Nesting the tail adds no padding so long
+	 * as `Vs...` are in non-increasing order of
+	 * alignment, which is how `FlatHMap` sorts
+	 * them.)
+	 *******************************************/
+	template<typename ...Vs>
+	struct FlatStorage {
+		constexpr FlatStorage(std::in_place_t) {}
+	};
+
+	/// Last member: no tail, so that the aggregate doesn't end in an empty struct.
+	template<typename H>
+	struct FlatStorage<H> {
+		H head; ///< Stored value
+		template<typename A>
+		constexpr FlatStorage(std::in_place_t, A&& a)
+		: head(std::forward<A>(a)) {}
+	};
+
+	template<typename H, typename T, typename ...Ts>
+	struct FlatStorage<H, T, Ts...> {
+		H head; ///< Stored value
+		FlatStorage<T, Ts...> tail; ///< The remaining values
+		template<typename A, typename ...As>
+		constexpr FlatStorage(std::in_place_t, A&& a, As&& ...as)
+		: head(std::forward<A>(a)), tail(std::in_place, std::forward<As>(as)...) {}
+	};
+
+	/// Access the `I`th member of a `FlatStorage`. Compiles to a constant offset.
+	template<size_t I, typename Storage>
+	constexpr auto& flatGet(Storage& s) {
+		if constexpr (I == 0) {
+			return s.head;
+		} else {
+			return flatGet<I - 1>(s.tail);
+		}
+	}
+
+	/// Stable insertion sort of `[0, N)` by descending `aligns`, breaking ties by `names`, to give a canonical layout.
+	template<size_t N>
+	constexpr std::array<size_t, N> flatOrder(const std::array<size_t, N>& aligns,
+	                                          const std::array<std::string_view, N>& names) {
+		std::array<size_t, N> order{};
+		for(size_t i = 0; i < N; ++i) {
+			order[i] = i;
+		}
+		for(size_t i = 1; i < N; ++i) {
+			const size_t moving = order[i];
+			size_t j = i;
+			for(; j > 0; --j) {
+				const size_t prev = order[j - 1];
+				const bool before = (aligns[moving] > aligns[prev])
+				                 || (aligns[moving] == aligns[prev] && names[moving] < names[prev]);
+				if(!before) {
+					break;
+				}
+				order[j] = prev;
+			}
+			order[j] = moving;
+		}
+		return order;
+	}
+
+	/// @return The storage position of the key named `name`, or `N` if absent.
+	template<size_t N>
+	constexpr size_t flatIndexOf(const std::array<std::string_view, N>& names,
+	                             const std::array<size_t, N>& order, std::string_view name) {
+		for(size_t j = 0; j < N; ++j) {
+			if(names[order[j]] == name) {
+				return j;
+			}
+		}
+		return N;
+	}
+
+	/// `true` if no two of `names` are equal.
+	template<size_t N>
+	constexpr bool flatNoRepeats(const std::array<std::string_view, N>& names) {
+		for(size_t i = 0; i < N; ++i) {
+			for(size_t j = i + 1; j < N; ++j) {
+				if(names[i] == names[j]) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	/// Size of a struct with members of the given `sizes`, in non-increasing order of alignment (so only padded at the end, to `maxAlign`).
+	template<size_t N>
+	constexpr size_t flatPackedSize(const std::array<size_t, N>& sizes, size_t maxAlign) {
+		size_t total = 0;
+		for(size_t s : sizes) {
+			total += s;
+		}
+		return N ? ((total + maxAlign - 1) / maxAlign) * maxAlign : 1;
+	}
+
+	/// Compile-time layout of a `FlatHMap<KeyTypes...>`
+	template<typename ...KeyTypes>
+	struct FlatLayout {
+		constexpr static const size_t N = sizeof...(KeyTypes);
+		/// Key names, in `KeyTypes` order.
+		constexpr static const std::array<std::string_view, N> names = {{std::string_view(KeyTypes::c_str(), KeyTypes::length())...}};
+		/// Value alignments, in `KeyTypes` order.
+		constexpr static const std::array<size_t, N> aligns = {{alignof(typename KeyTypes::Value)...}};
+		/// `order[j]` is the index into `KeyTypes` of the `j`th stored value.
+		constexpr static const std::array<size_t, N> order = flatOrder(aligns, names);
+		/// Size of the equivalent hand-written struct.
+		constexpr static const size_t packed_size = flatPackedSize<N>({{sizeof(typename KeyTypes::Value)...}},
+		                                                              std::max({size_t(1), alignof(typename KeyTypes::Value)...}));
+	};
+	/**
+	 * @}
+	 ****************************************************************************/
+}
+
+/**********************************************************
+ * An alternative to `HMap` with the same interface, which
+ * stores its values as a single flat aggregate rather than
+ * as a tree of `detail::Node`s, eliminating the padding
+ * between nodes.
+ *
+ * Values are ordered by decreasing alignment (then by key),
+ * so `sizeof(FlatHMap<...>)` is `packed_size`, the size of
+ * the tightest hand-written struct with the same members.
+ * Keys are resolved to an offset by a `constexpr` search,
+ * so lookups still cost nothing at runtime.
+ *
+ * @note Unlike `HMap`, the layout is canonical: every
+ * permutation of the same `KeyTypes` has the same layout.
+ *
+ * @tparam KeyTypes As for `HMap`.
+ **********************************************************/
+template<typename ...KeyTypes>
+class FlatHMap {
+	using Layout = detail::FlatLayout<KeyTypes...>;
+	constexpr static const size_t N = Layout::N;
+	static_assert(detail::flatNoRepeats(Layout::names), "HMap would contain duplicate keys");
+
+	/// Key of the `J`th stored value.
+	template<size_t J> using KeyAt = std::tuple_element_t<Layout::order[J], std::tuple<KeyTypes...> >;
+
+	/// Value type of the `J`th stored value, or `void` if `J` is out of range (i.e. the key is absent).
+	template<size_t J, bool InRange = (J < N)>
+	struct ValueAt { using type = void; };
+	template<size_t J>
+	struct ValueAt<J, true> { using type = typename KeyAt<J>::Value; };
+
+	template<typename Indices> struct StorageFor;
+	template<size_t ...Js>
+	struct StorageFor<std::index_sequence<Js...> > {
+		using type = detail::FlatStorage<typename KeyAt<Js>::Value...>;
+	};
+	using Storage = typename StorageFor<std::make_index_sequence<N> >::type;
+
+	Storage storage_; ///< The actual data-structure.
+
+	template<typename Tuple, size_t ...Js>
+	constexpr static Storage build(Tuple&& values, std::index_sequence<Js...>) {
+		return Storage(std::in_place, std::move(std::get<Layout::order[Js]>(values).v)...);
+	}
+
+	/// Shared implementation of each `operator[]`.
+	template<typename KeyType, typename Self>
+	constexpr static auto& lookup(Self& self) {
+		constexpr size_t J = detail::flatIndexOf(Layout::names, Layout::order,
+		                                         std::string_view(KeyType::c_str(), KeyType::length()));
+		using ValueType = typename ValueAt<J>::type;
+		static_assert(!std::is_same_v<ValueType, void>, "HMap doesn't contain key");
+		if constexpr (detail::IsKeyType<KeyType>::value) {
+			// Only check against key's type if the previous test passed
+			static_assert(std::is_same_v<ValueType, void> || std::is_same_v<ValueType, typename KeyType::Value>, "HMap contains key, but it has the wrong type");
+		}
+		if constexpr (J < N) {
+			return detail::flatGet<J>(self.storage_);
+		} else {
+			// Disappear one set of compiler errors
+			return self;
+		}
+	}
+
+  public:
+	/// Size of the equivalent hand-written struct, with members in decreasing order of alignment.
+	constexpr static const size_t packed_size = Layout::packed_size;
+
+	/// Construct from input key-value pairs, in `KeyTypes` order.
+	constexpr FlatHMap(typename KeyTypes::ValueType ...values)
+	: storage_(build(std::forward_as_tuple(values...), std::make_index_sequence<N>())) {
+		static_assert(sizeof(Storage) == packed_size, "FlatHMap has unexpected padding");
+	}
+
+	/// Lookup value of specified type for given key (only the key's type matters, runtime value is just a tag to guide dispatch)
+	template<typename KeyType, std::enable_if_t<detail::IsKeyType<KeyType>::value || detail::IsCharList<KeyType>::value, bool> = false>
+	constexpr auto& operator[](const KeyType&) {
+		return lookup<KeyType>(*this);
+	}
+
+	/// `const` overload. Lookup value of specified type for given key (only the key's type matters, runtime value is just a tag to guide dispatch)
+	template<typename KeyType, std::enable_if_t<detail::IsKeyType<KeyType>::value || detail::IsCharList<KeyType>::value, bool> = false>
+	constexpr const auto& operator[](const KeyType&) const {
+		return lookup<KeyType>(*this);
+	}
+};
+
+/*************************************************
+ * Construct a `FlatHMap` from a sequence of
+ * key-value pairs (`detail::detail::ValueType`).
+ * Typical usage:
+ * <pre class="markdeep">
+ * ```c++
+ * auto myMap = make_flat_hmap((TK("foo",int), 1), (TK("bar",double), 2.), (TK("baz",char), 'c'));
+ * static_assert(sizeof(myMap) == sizeof(struct { double bar; int foo; char baz; }));
+ * ```
+ * </pre>
+ *************************************************/
+template<typename ...Values>
+constexpr FlatHMap<typename Values::KeyType...> make_flat_hmap(Values&& ...values) {
+	return FlatHMap<typename Values::KeyType...>(std::forward<Values>(values)...);
+}
@@ -0,0 +1,330 @@
+#pragma once
+/************************************************************************************
+ * @file frozen-dynamic-hmap.hpp A read-only, perfectly-hashed counterpart to
+ * @ref dynamic-hmap.hpp, for maps which are built once and then only queried.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <any>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/iterator/transform_iterator.hpp>
+#include <boost/optional/optional.hpp>
+
+#include <hmap/dynamic-hmap.hpp>
+
+namespace detail {
+	/// Seeded finalizer (splitmix64) used to derive `FrozenDynamicHMap` slots from cached key hashes.
+	inline std::uint64_t perfectHashMix(std::uint64_t h, std::uint32_t seed) {
+		std::uint64_t x = h ^ (0x9E3779B97F4A7C15ull * (std::uint64_t(seed) + 1));
+		x ^= x >> 30;
+		x *= 0xBF58476D1CE4E5B9ull;
+		x ^= x >> 27;
+		x *= 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+}
+
+/******************************************************
+ * An immutable `DynamicHMap`, laid out as a single
+ * contiguous array of key-value pairs indexed by a
+ * minimal perfect hash of each key's cached hash
+ * (hash-and-displace, with one 32-bit seed per four
+ * keys).
+ *
+ * A lookup is one seed load, one mix, and one key
+ * comparison, with no probing and no pointer chasing
+ * through tree nodes.
+ *
+ * Build one with `freeze`, either by copying a map, or
+ * by moving from it (so values are moved rather than
+ * copied).
+ *
+ * @note Iteration order is unspecified.
+ * @note Distinct keys whose 64-bit hashes collide can't be
+ * separated by any perfect hash of those hashes. They are
+ * kept in a small overflow region which is searched only on
+ * a miss, and which is almost always empty.
+ ******************************************************/
+class FrozenDynamicHMap : public detail::DynamicHMapBase {
+  public:
+	using value_type = std::pair<const detail::KeyBase, std::any>; ///< Type-unsafe key-value pairs
+	using const_iterator = std::vector<value_type>::const_iterator; ///< const iterator over contents.
+
+	template<typename V> using const_specific_value_type = std::pair<detail::KeyBase, const V&>; ///< Immutable type-safe key-value pairs.
+
+  private:
+	static constexpr std::uint32_t kDirect = 0x80000000u; ///< Seed flag: the low bits are the slot itself.
+	static constexpr std::size_t kKeysPerSeed = 4;
+
+	std::vector<value_type> entries_; ///< The first `primary_` are in perfect-hash slot order, the rest overflow.
+	std::vector<std::uint32_t> seeds_; ///< One per bucket of keys.
+	std::size_t primary_ = 0; ///< Number of perfectly-hashed entries.
+
+	/// Functor for use with boost::transform_iterator
+	template<typename V>
+	struct ConstAnyCaster {
+		const_specific_value_type<V> operator()(const value_type &v) const {
+			return const_specific_value_type<V>(v.first, std::any_cast<const V&>(v.second));
+		}
+	};
+
+	std::size_t slotOf(std::uint64_t h) const {
+		const std::uint32_t seed = seeds_[h % seeds_.size()];
+		return (seed & kDirect) ? (seed & ~kDirect) : std::size_t(detail::perfectHashMix(h, seed) % primary_);
+	}
+
+	/// `K` is a `detail::KeyBase` or `detail::KeyView`.
+	template<typename K>
+	const_iterator locate(const K& k) const {
+		const detail::KeyBaseEqual eq;
+		if(primary_ == 0) {
+			return entries_.cend();
+		}
+		const auto slot = entries_.cbegin() + slotOf(detail::KeyHash()(k));
+		if(eq(slot->first, k)) {
+			return slot;
+		}
+		for(auto it = entries_.cbegin() + primary_; it != entries_.cend(); ++it) {
+			if(eq(it->first, k)) {
+				return it;
+			}
+		}
+		return entries_.cend();
+	}
+
+	/// Lay out `staging`, whose keys must be distinct.
+	void build(std::vector<std::pair<detail::KeyBase, std::any> >&& staging) {
+		const std::size_t n = staging.size();
+		// Keys with a hash already claimed by another key go to the overflow region.
+		std::vector<std::size_t> order(n);
+		for(std::size_t i = 0; i < n; ++i) {
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&staging](std::size_t l, std::size_t r) {
+			return staging[l].first.hash < staging[r].first.hash;
+		});
+		std::vector<std::size_t> unique, overflow;
+		for(std::size_t i = 0; i < n; ++i) {
+			if(i > 0 && staging[order[i]].first.hash == staging[order[i - 1]].first.hash) {
+				overflow.push_back(order[i]);
+			} else {
+				unique.push_back(order[i]);
+			}
+		}
+		primary_ = unique.size();
+		if(primary_ >= kDirect) {
+			detail::fail(std::length_error("FrozenDynamicHMap: too many keys"));
+		}
+		seeds_.assign(std::max<std::size_t>(1, (primary_ + kKeysPerSeed - 1) / kKeysPerSeed), 0);
+
+		std::vector<std::vector<std::size_t> > buckets(seeds_.size());
+		for(std::size_t i : unique) {
+			buckets[staging[i].first.hash % seeds_.size()].push_back(i);
+		}
+		std::vector<std::size_t> bucketOrder(buckets.size());
+		for(std::size_t b = 0; b < buckets.size(); ++b) {
+			bucketOrder[b] = b;
+		}
+		// Place the largest buckets first, while the table is emptiest.
+		std::stable_sort(bucketOrder.begin(), bucketOrder.end(), [&buckets](std::size_t l, std::size_t r) {
+			return buckets[l].size() > buckets[r].size();
+		});
+
+		std::vector<std::size_t> slotted(primary_, n); ///< Staging index in each slot, or `n` if free.
+		std::vector<std::size_t> trial;
+		std::size_t nextFree = 0;
+		for(std::size_t b : bucketOrder) {
+			const std::vector<std::size_t>& bucket = buckets[b];
+			if(bucket.size() == 1) {
+				// Singletons (and, below, empty buckets) need no search: point straight at a free slot.
+				while(slotted[nextFree] != n) {
+					++nextFree;
+				}
+				slotted[nextFree] = bucket.front();
+				seeds_[b] = kDirect | std::uint32_t(nextFree);
+				continue;
+			} else if(bucket.empty()) {
+				break;
+			}
+			for(std::uint32_t seed = 0;; ++seed) {
+				if(seed == kDirect) {
+					detail::fail(std::length_error("FrozenDynamicHMap: failed to find a perfect hash"));
+				}
+				trial.clear();
+				bool ok = true;
+				for(std::size_t i : bucket) {
+					const std::size_t slot = detail::perfectHashMix(staging[i].first.hash, seed) % primary_;
+					if(slotted[slot] != n || std::find(trial.begin(), trial.end(), slot) != trial.end()) {
+						ok = false;
+						break;
+					}
+					trial.push_back(slot);
+				}
+				if(ok) {
+					for(std::size_t j = 0; j < bucket.size(); ++j) {
+						slotted[trial[j]] = bucket[j];
+					}
+					seeds_[b] = seed;
+					break;
+				}
+			}
+		}
+
+		entries_.reserve(n);
+		for(std::size_t i : slotted) {
+			entries_.emplace_back(std::move(staging[i]));
+		}
+		for(std::size_t i : overflow) {
+			entries_.emplace_back(std::move(staging[i]));
+		}
+	}
+
+  public:
+	FrozenDynamicHMap() = default;
+
+	/// Copy the contents of `m`.
+	template<typename Backend>
+	explicit FrozenDynamicHMap(const BasicDynamicHMap<Backend>& m) {
+		std::vector<std::pair<detail::KeyBase, std::any> > staging;
+		staging.reserve(m.size());
+		for(auto it = m.cbegin(); it != m.cend(); ++it) {
+			staging.emplace_back(it->first, it->second);
+		}
+		build(std::move(staging));
+	}
+
+	/// Move the values out of `m`, leaving it empty.
+	template<typename Backend>
+	explicit FrozenDynamicHMap(BasicDynamicHMap<Backend>&& m) {
+		std::vector<std::pair<detail::KeyBase, std::any> > staging;
+		staging.reserve(m.size());
+		// Moving in place, rather than extracting node by node, is linear for every backend.
+		for(auto& entry : m.map_) {
+			staging.emplace_back(entry.first, std::move(entry.second));
+		}
+		m.map_.clear();
+		build(std::move(staging));
+	}
+
+	/// Find the `V` mapped by `k`, if present.
+	template<typename V>
+	boost::optional<const V&> operator()(const detail::Key<V>& k) const {
+		const const_iterator found = locate(k);
+		return (entries_.cend() != found) ? boost::optional<const V&>(std::any_cast<const V&>(found->second)) : boost::none;
+	}
+
+	/// Find the `V` mapped by `(k, tag)`, if present, without building a `detail::Key`.
+	template<typename V>
+	boost::optional<const V&> operator()(std::string_view k, const KeyTag<V>& tag) const {
+		const const_iterator found = locate(detail::KeyView(k, tag));
+		return (entries_.cend() != found) ? boost::optional<const V&>(std::any_cast<const V&>(found->second)) : boost::none;
+	}
+
+	/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of optional references.
+	template <typename... Vs>
+	auto operator()(multi_tag, const detail::Key<Vs>& ...ks) const {
+		return std::make_tuple((*this)(ks)...);
+	}
+
+	/// Find a matching key value pair and return a reference to the value
+	template<typename V>
+	const V& at(const detail::Key<V>& k) const {
+		const const_iterator found = locate(k);
+		if(entries_.cend() == found) {
+			keyNotFound(k);
+		}
+		return std::any_cast<const V&>(found->second);
+	}
+	/// Find a matching key value pair and return a `const` reference to the type-erased value.
+	const std::any& at(const detail::KeyBase& kb) const {
+		const const_iterator found = locate(kb);
+		if(entries_.cend() == found) {
+			keyNotFound(kb);
+		}
+		return found->second;
+	}
+	/// As for `at(k)`, but reports a miss as `LookupError::KeyNotFound` rather than throwing.
+	template<typename V>
+	LookupResult<const V&> try_at(const detail::Key<V>& k) const {
+		const const_iterator found = locate(k);
+		if(entries_.cend() == found) {
+			return LookupError::KeyNotFound;
+		}
+		return std::any_cast<const V&>(found->second);
+	}
+	/// As for `at(kb)`, but reports a miss as `LookupError::KeyNotFound` rather than throwing.
+	LookupResult<const std::any&> try_at(const detail::KeyBase& kb) const {
+		const const_iterator found = locate(kb);
+		if(entries_.cend() == found) {
+			return LookupError::KeyNotFound;
+		}
+		return found->second;
+	}
+
+	/// Return an iterator to the located key-value pair, or to `cend<V>()` if none exists. Prefer `operator()`.
+	template<typename V>
+	auto find(const detail::Key<V>& k) const {
+		return boost::make_transform_iterator<ConstAnyCaster<V> >(locate(k));
+	}
+	/// Return an iterator to the located type-erased key-value pair, or to `cend()` if none exists.
+	const_iterator find(const detail::KeyBase& kb) const {
+		return locate(kb);
+	}
+	/// Return an iterator to the located type-erased key-value pair, or to `cend()` if none exists.
+	const_iterator find(const detail::KeyView& kv) const {
+		return locate(kv);
+	}
+	/// Return an iterator to the key-value pair located by `(k, tag)`, or to `cend<V>()` if none exists. Never allocates.
+	template<typename V>
+	auto find(std::string_view k, const KeyTag<V>& tag) const {
+		return boost::make_transform_iterator<ConstAnyCaster<V> >(locate(detail::KeyView(k, tag)));
+	}
+
+	const_iterator cbegin() const { return entries_.cbegin(); }
+	const_iterator cend() const { return entries_.cend(); }
+
+	/// Add a version of cend() that can be compared against the iterator returned by `find`
+	template<typename V>
+	auto cend() const {
+		return boost::make_transform_iterator<ConstAnyCaster<V> >(cend());
+	}
+
+	size_t size() const { return entries_.size(); } ///< Number of entries
+	bool empty() const { return entries_.empty(); } ///< `true` if `size() == 0`, `false` otherwise.
+};
+
+/// Copy `m` into a `FrozenDynamicHMap`.
+template<typename Backend>
+FrozenDynamicHMap freeze(const BasicDynamicHMap<Backend>& m) {
+	return FrozenDynamicHMap(m);
+}
+
+/// Move the contents of `m` into a `FrozenDynamicHMap`, leaving `m` empty.
+template<typename Backend>
+FrozenDynamicHMap freeze(BasicDynamicHMap<Backend>&& m) {
+	return FrozenDynamicHMap(std::move(m));
+}
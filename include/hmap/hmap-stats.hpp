@@ -0,0 +1,143 @@
+#pragma once
+/************************************************************************************
+ * @file hmap-stats.hpp Opt-in counters for @ref dynamic-hmap.hpp maps. Compiled out
+ * entirely unless `HMAP_ENABLE_STATS` is defined (cf. the CMake option of the same
+ * name), in which case each map counts its own lookups, misses, insertions and
+ * erasures, and values which spill from `std::any`'s small buffer are counted per
+ * type.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class DynamicHMapStatsRegistry;
+
+namespace detail {
+	struct KeyTagBase;
+}
+
+/// A snapshot of the counters kept by one dynamic map (or, summed, by many).
+struct DynamicHMapStats {
+	std::uint64_t lookups = 0; ///< Keys looked up, counting each key of a multi-key lookup.
+	std::uint64_t misses = 0; ///< Lookups which found nothing.
+	std::uint64_t inserts = 0; ///< Calls which insert a key if absent (`operator[]`, `try_emplace`, `insert_or_assign`, bulk loads, ...).
+	std::uint64_t nodes = 0; ///< Entries actually created, each of which allocates a node (or, for hashed backends, fills a slot).
+	std::uint64_t erases = 0; ///< Entries removed by `erase`, `extract` or `optCheckOut`.
+
+	DynamicHMapStats& operator+=(const DynamicHMapStats& s) {
+		lookups += s.lookups;
+		misses += s.misses;
+		inserts += s.inserts;
+		nodes += s.nodes;
+		erases += s.erases;
+		return *this;
+	}
+};
+
+namespace detail {
+#ifdef HMAP_ENABLE_STATS
+	/******************************************************
+	 * Counters belonging to a single map. Copies start
+	 * from zero, and are unlabelled, since they are
+	 * different maps. Relaxed atomics, so that concurrent
+	 * `const` lookups (and scraping) are race-free.
+	 ******************************************************/
+	class InstanceStats {
+		mutable std::atomic<std::uint64_t> lookups_{0}, misses_{0};
+		std::atomic<std::uint64_t> inserts_{0}, nodes_{0}, erases_{0};
+		std::string label_; ///< Empty unless registered with `DynamicHMapStatsRegistry`.
+		friend class ::DynamicHMapStatsRegistry; ///< Reads `label_`.
+
+	  public:
+		InstanceStats() = default;
+		InstanceStats(const InstanceStats&) noexcept {}
+		InstanceStats& operator=(const InstanceStats&) noexcept { return *this; }
+		/// Adds the counters to `DynamicHMapStatsRegistry::retired()`, and unregisters a labelled map.
+		~InstanceStats();
+
+		void countLookup(bool hit) const {
+			lookups_.fetch_add(1, std::memory_order_relaxed);
+			if(!hit) {
+				misses_.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		void countInsert(bool created) {
+			inserts_.fetch_add(1, std::memory_order_relaxed);
+			if(created) {
+				nodes_.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		/// Count `n` calls which might have inserted, `created` of which did.
+		void countInserts(std::size_t n, std::size_t created) {
+			inserts_.fetch_add(n, std::memory_order_relaxed);
+			nodes_.fetch_add(created, std::memory_order_relaxed);
+		}
+		void countErase(std::size_t n) {
+			erases_.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		DynamicHMapStats stats() const {
+			DynamicHMapStats s;
+			s.lookups = lookups_.load(std::memory_order_relaxed);
+			s.misses = misses_.load(std::memory_order_relaxed);
+			s.inserts = inserts_.load(std::memory_order_relaxed);
+			s.nodes = nodes_.load(std::memory_order_relaxed);
+			s.erases = erases_.load(std::memory_order_relaxed);
+			return s;
+		}
+		/// Register this map with `DynamicHMapStatsRegistry` as `label`, until it is destroyed. @pre `label` is non-empty.
+		void set_stats_label(std::string label);
+	};
+
+	/// The counter of spills for one type, registered with `DynamicHMapStatsRegistry` on first use.
+	std::atomic<std::uint64_t>& spillCounter(const KeyTagBase &tag);
+#else
+	/// Stands in for the counters when `HMAP_ENABLE_STATS` is not defined: empty, so costs nothing as a base class.
+	class InstanceStats {
+	  public:
+		void countLookup(bool) const {}
+		void countInsert(bool) {}
+		void countInserts(std::size_t, std::size_t) {}
+		void countErase(std::size_t) {}
+		DynamicHMapStats stats() const { return {}; } ///< All zero.
+		void set_stats_label(std::string) {} ///< Does nothing.
+	};
+#endif
+}
+
+/******************************************************
+ * Process-wide view of the counters kept with
+ * `HMAP_ENABLE_STATS`, for scraping into a metrics
+ * system. Without it, every result is empty (or zero).
+ ******************************************************/
+class DynamicHMapStatsRegistry {
+  public:
+	/// The counters of every map destroyed so far, summed.
+	static DynamicHMapStats retired();
+	/// The counters of every live map given a label by `set_stats_label`. Labels need not be unique.
+	static std::vector<std::pair<std::string, DynamicHMapStats> > labelled();
+	/// For each value type which has spilled from `std::any`'s small buffer to the heap, the number of values spilled so far.
+	static std::vector<std::pair<const detail::KeyTagBase*, std::uint64_t> > spills();
+};
@@ -29,11 +29,16 @@
  *
  ************************************************************************************/
 
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <string_view>
 #include <type_traits>
 #include <utility>
 #include <tuple>
 
+#include <hmap/type-id.hpp>
+
 /*****************************************************************************
  * @defgroup TupleTools Helper code for wrangling tuples
  * `tuple_slice` + `detail::slice_impl` via: https://stackoverflow.com/a/40836163/2252298
@@ -159,7 +164,7 @@ namespace detail {
 			using ValueKeyType::c_str;
 			using ValueKeyType::length;
 			Value v; ///< The stored `Value` for this Key-Value pair
-			constexpr ValueType(Value vi) : v(vi) {}
+			constexpr ValueType(Value vi) : v(std::move(vi)) {}
 		};
 	}
 	
@@ -199,257 +204,210 @@ namespace detail {
 	constexpr auto inferredKeyTypeImpl(StringHolder holder, std::index_sequence<I...>) {
 		return CharList<holder()[I] ...>();
 	}
+	
+	/// The `KeyType` with the name encoded by `Name` (a `CharList`), indexing a `Value`.
+	template<typename Value, typename Name> struct KeyTypeFor;
+	template<typename Value, char ...Cs>
+	struct KeyTypeFor<Value, CharList<Cs...>> {
+		using type = KeyType<Value, Cs...>;
+	};
 	/**
 	 * @}
 	 ****************************************************************************/
 	
 	
 	/*****************************************************************************
-	 * @defgroup TwoWayMerge Our building blocks for merge-sorting two sequences.
+	 * @defgroup KeySort Compile-time lexicographic sorting of keys.
+	 * Keys are sorted by a `constexpr` function over their names, rather than by
+	 * recursive template instantiation, so that the number of instantiations
+	 * (and the compiler's time and memory) grows linearly with the number of keys.
 	 * @{
 	 **/
 
-	/*******************************************
-	 * A recursive compile-time sorted merge of 
-	 * two sorted sequences.
-	 * 
-	 * Generic template is the base-case when
-	 *  `L` and `R` subsequences are empty.
-	 * This means the `Head` subsequence is
-	 * completely sorted.
-	 * @tparam L The left subsequence
-	 * @tparam R The right subsequence
-	 * @tparam Head The finished prefix of the
-	 * output.
-	 * @pre `L`, `R`, and `Head` should be 
-	 * completely sorted already.
-	 *******************************************/
-	template<typename L, typename R, typename Head = tuple<>>
-	struct Merge {
-		using type = Head; ///< Type of output sequence.
-		
-		/// Obtain output sequence at runtime.
-		constexpr static type apply(const type& dummy){
-			return dummy;
-		}
-	};
-	
-	/*******************************************
-	 * Base-case of `Merge` when `L` 
-	 * subsequence has at least 1 element and `R`
-	 * is empty.
-	 *******************************************/
-	template<typename L, typename ...Ls, typename ...Hs>
-	struct Merge<tuple<L, Ls...>, tuple<>, tuple<Hs...>> {
-		using type = tuple<Hs..., L, Ls...>; ///< Type of output sequence.
-		
-		/// Obtain output sequence at runtime.
-		constexpr static type apply(const tuple<L, Ls...>& l, const tuple<>&, const tuple<Hs...>& h) {
-			return std::tuple_cat(h, l);
-		}
-	};
-	
-	
-	/*******************************************
-	 * Base-case of `Merge` when `R` 
-	 * subsequence has at least 1 element and `L`
-	 * is empty.
-	 *******************************************/
-	template<typename R, typename ...Rs, typename ...Hs>
-	struct Merge<tuple<>, tuple<R, Rs...>, tuple<Hs...>> {
-		using type = tuple<Hs..., R, Rs...>; ///< Type of output sequence.
-		
-		/// Obtain output sequence at runtime.
-		constexpr static type apply(const tuple<>&, tuple<R, Rs...>& r, tuple<Hs...>& h) {
-			return std::tuple_cat(h, r);
-		}
-	};
-	
-	/// Helper for `Merge` to obtain next element in output sequence.
-	template<typename PrevL, typename PrevR, typename PrevH, typename LeftThunk, typename RightThunk, bool Left>
-	struct MergeLesser;
-	
-	/*******************************************
-	 * Recursive case of `Merge` when `R` and `L`
-	 * subsequences both have at least 1 element.
-	 *******************************************/
-	template<typename L, typename ...Ls, typename R, typename ...Rs, typename ...Hs>
-	struct Merge<tuple<L, Ls...>, tuple<R, Rs...>, tuple<Hs...>> {
+	/// Stable insertion sort of `[0, N)` by `names`. @return `order` such that `names[order[i]]` is ascending.
+	template<size_t N>
+	constexpr std::array<size_t, N> sortedOrder(const std::array<std::string_view, N>& names) {
+		std::array<size_t, N> order{};
+		for(size_t i = 0; i < N; ++i) {
+			order[i] = i;
+		}
+		for(size_t i = 1; i < N; ++i) {
+			const size_t moving = order[i];
+			size_t j = i;
+			for(; j > 0 && names[moving] < names[order[j - 1]]; --j) {
+				order[j] = order[j - 1];
+			}
+			order[j] = moving;
+		}
+		return order;
+	}
+
+	/// @return `names[order[i]]` for each `i`.
+	template<size_t N>
+	constexpr std::array<std::string_view, N> permuted(const std::array<std::string_view, N>& names,
+	                                                   const std::array<size_t, N>& order) {
+		std::array<std::string_view, N> out{};
+		for(size_t i = 0; i < N; ++i) {
+			out[i] = names[order[i]];
+		}
+		return out;
+	}
+
+	/// Perform a lexicographical sort on `KeyType`s or `CharList`s.
+	template<typename ...KTs>
+	struct SortKeys {
 	private:
-		constexpr static const bool TakeLeft = KeyLess<L, R>::value; ///< Which subsequence has least first element?
-		using LeftThunk = Merge<tuple<Ls...>, tuple<R, Rs...>, tuple<Hs..., L>>; ///< Speculatively create the case where `L` is least
-		using RightThunk =  Merge<tuple<L, Ls...>, tuple<Rs...>, tuple<Hs..., R>>; ///< Speculatively create the case where `R` is least
+		constexpr static const size_t N = sizeof...(KTs);
+		constexpr static const std::array<std::string_view, N> names = {{std::string_view(KTs::c_str(), KTs::length())...}};
 	public:
-		using Left = tuple<L, Ls...>; ///< Type of left subsequence
-		using Right = tuple<R, Rs...>; ///< Type of right subsequence
-		using Head = tuple<Hs...>; ///< Type of computed output prefix
-		/***********************************
-		 * Determine type of output sequence
-		 * @warning TODO: figure out if the
-		 * speculative executions are computed
-		 * lazily or to completion.
-		 * If to completion, big efficiency 
-		 * gains could be made by replacing
-		 * `std::conditional` with a helper 
-		 * thunk to avoid exponential branching.
-		 ***********************************/
-		using type = typename std::conditional<TakeLeft, typename LeftThunk::type, typename RightThunk::type>::type;
-		
-		/// Obtain output sequence at runtime.
-		constexpr static type apply(const Left &l, const Right &r, const Head &h) {
-			return MergeLesser<Left, Right, Head, LeftThunk, RightThunk, TakeLeft>::apply(l, r, h);
-		}
-	};
-	
-	/// Generic implementation for case when `Left` subsequence contains next element.
-	template<	typename PrevL, typename PrevR, typename PrevH,
-	typename LeftThunk, typename RightThunk, bool Left>
-	struct MergeLesser {
-		/// Slice front off `L` and append it to `Head`.
-		constexpr static typename LeftThunk::type apply(const PrevL &l, const PrevR &r, const PrevH &h) {
-			auto nextL = tuple_slice<1, std::tuple_size<PrevL>::value>(l);
-			auto nextH = std::tuple_cat(h, tuple_slice<0,1>(l));
-			return LeftThunk::apply(nextL, r, nextH);
-		}
-	};
-	
-	/// Specialization of `MergeLesser` for case when `Right` subsequence contains next element.
-	template<	typename PrevL, typename PrevR, typename PrevH,
-	typename LeftThunk, typename RightThunk>
-	struct MergeLesser<PrevL, PrevR, PrevH, LeftThunk, RightThunk, false> {
-		/// Slice front off `R` and append it to `Head`.
-		constexpr static typename RightThunk::type apply(const PrevL &l, const PrevR &r, const PrevH &h) {
-			auto nextR = tuple_slice<1, std::tuple_size<PrevR>::value>(r);
-			auto nextH = std::tuple_cat(h, tuple_slice<0,1>(r));
-			return RightThunk::apply(l, nextR, nextH);
-		}
+		/// `order[i]` is the index into `KTs...` of the `i`th least key.
+		constexpr static const std::array<size_t, N> order = sortedOrder(names);
+		/// Key names, in sorted order.
+		constexpr static const std::array<std::string_view, N> sorted_names = permuted(names, order);
+	private:
+		/// Apply `order` to `KTs...` with a single pack expansion.
+		template<typename Indices> struct Permute;
+		template<size_t ...Is>
+		struct Permute<std::index_sequence<Is...>> {
+			using type = tuple<std::tuple_element_t<order[Is], tuple<KTs...>>...>;
+		};
+	public:
+		using type = typename Permute<std::make_index_sequence<N>>::type; ///< Type of output sequence.
 	};
 	/**
 	 * @}
 	 ****************************************************************************/
 	
 	/*****************************************************************************
-	 * @defgroup NWayMerge Our building blocks for merge-sorting N sequences.
+	 * @defgroup KeyDispatch Runtime lookup of a static key's position from its name.
+	 * A minimal perfect hash ("hash and displace") over the sorted key names is
+	 * generated at compile-time, so a runtime lookup hashes the name once, reads
+	 * one displacement and one slot, and compares one string.
 	 * @{
 	 **/
 
-	/*******************************************
-	 * A 2D recursive compile-time sorted merge of 
-	 * N sorted sequences.
-	 * 
-	 * Generic template is the base-case when
-	 * all subsequences are empty.
-	 * This means there is nothing to sort.
-	 * @tparam Head A sequence of sorted subsequences,
-	 * each resulting from a 2-way `Merge`.
-	 * @tparam Ls A parameter pack of sorted subsequences
-	 * to be 2-way `Merge`d. 
-	 *******************************************/
-	template<typename Head, typename ...Ls>
-	struct MergeN {
-		using type = tuple<>; ///< Type of output sequence.
-		
-		/// Obtain output sequence at runtime.
-		constexpr static type apply(const Head& head, const Ls& ...l) {
-			return make_tuple();
-		}
-	};
+	/// Seeded finalizer (splitmix64) for the second level of `KeyHashTable`.
+	constexpr std::uint64_t fnvDisplace(std::uint64_t h, std::uint32_t seed) {
+		std::uint64_t x = h ^ (0x9E3779B97F4A7C15ull * (std::uint64_t(seed) + 1));
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
 
-	/// Outer base-case of `MergeN` when we have a single sorted subsequence in `Ls`, which can be returned directly.
-	template<typename L>
-	struct MergeN<tuple<>, L> {
-		using type = L; ///< Type of output sequence.
-		
-		/// Obtain output sequence at runtime.
-		constexpr static type apply(const tuple<> &, const L& l){
-			return l;
-		}
-	};
-	
-	/*******************************************
-	 * Inner base-case of `MergeN` when all `Ls...`
-	 * have been two-way `Merge`d and buffered into
-	 * `Head`, recurse by shunting them back into
-	 * `Ls...` (and emptying `Head`).
-	 *******************************************/ 
-	template<typename H, typename ...Hs>
-	struct MergeN<tuple<H, Hs...>> {
-	private:
-		using MergeThunk = MergeN<tuple<>, H, Hs... >; ///< Proceed with recursion
-	public:
-		using type = typename MergeThunk::type; ///< Type of output sequence.
-		
-		/// Obtain output sequence at runtime.
-		constexpr static auto apply(const tuple<H, Hs...> &head){
-			auto args = std::tuple_cat(make_tuple(make_tuple()),head);
-			return std::apply(MergeThunk::apply, args);
-		}
-	};
-	
-	/*******************************************
-	 * Special case of `MergeN` when we had an
-	 * odd number of `Ls...`, and all but the last
-	 * have been `Merge`d. Just shunt it into
-	 * `Head` untouched and proceed to the inner
-	 * base-case.
-	 *******************************************/
-	template<typename H, typename ...Hs, typename L>
-	struct MergeN<tuple<H, Hs...>, L> {
-	private:
-		using MergeThunk = MergeN<tuple<>, H, Hs ..., L >; ///< Proceed with recursion
-	public:
-		using type = typename MergeThunk::type; ///< Type of output sequence.
-		
-		/// Obtain output sequence at runtime.
-		constexpr static auto apply(const tuple<H, Hs...> &head, const L& l){
-			auto args = std::tuple_cat(make_tuple(make_tuple()),head,make_tuple(l));
-			return std::apply(MergeThunk::apply, args);
-		}
-	};
-	
 	/*******************************************
-	 * General case of `MergeN` when we have at
-	 * least two `Ls...`. `Merge` them and shunt
-	 * result to `Head`.
+	 * Maps each of `N` distinct, sorted `names`
+	 * to its index. Built by `makeKeyHashTable`.
+	 * If no perfect hash was found (i.e. two
+	 * names share an FNV-1a hash), falls back to
+	 * binary search.
 	 *******************************************/
-	template<typename ...Hs, typename L1, typename L2, typename ...Ls>
-	struct MergeN<tuple<Hs...>, L1, L2, Ls...> {
-	private:
-		using MergeThunk = MergeN<tuple<Hs..., typename Merge<L1, L2>::type>, Ls...>; ///< Proceed with recursion
-	public:
-		using type = typename MergeThunk::type; ///< Type of output sequence.
-		
-		/// Obtain output sequence at runtime.
-		constexpr static auto apply(const tuple<Hs...> &head, const L1 &l1, const L2 &l2, const Ls& ...ls){
-			auto nextHead = std::tuple_cat(head, make_tuple(Merge<L1, L2>::apply(l1, l2, make_tuple())));
-			auto args = std::tuple_cat(make_tuple(nextHead), make_tuple(ls...));
-			return std::apply(MergeThunk::apply, args);
+	template<size_t N>
+	struct KeyHashTable {
+		constexpr static const std::uint32_t Direct = 0x80000000u; ///< Seed flag: the low bits are the slot itself.
+		constexpr static const std::uint32_t MaxSeed = 1u << 16; ///< Give up on a bucket after this many seeds.
+		constexpr static const size_t Buckets = N / 2 + 1;
+
+		std::array<std::string_view, N> names{}; ///< Sorted
+		std::array<std::uint32_t, Buckets> seeds{}; ///< One per bucket of names.
+		std::array<size_t, N> slots{}; ///< Index into `names` of the name in each slot.
+		bool perfect = false; ///< `false` if construction failed and we must binary search.
+
+		constexpr size_t slotOf(std::uint64_t h) const {
+			const std::uint32_t seed = seeds[h % Buckets];
+			return (seed & Direct) ? (seed & ~Direct) : size_t(fnvDisplace(h, seed) % N);
 		}
-	};
-	/**
-	 * @}
-	 ****************************************************************************/
-	
-	/*****************************************************************************
-	 * @defgroup MergeSortEntry Compile-time merge-sort on types.
-	 * The entry-point for our @ref NWayMerge and @ref TwoWayMerge routines.
-	 * @{
-	 **/
 
-	/// Perform a lexicographical merge-sort on `KeyType`s or `CharList`s.
-	template<typename ...KTs>
-	struct MergeSort {
-	private:
-		using MergeThunk = MergeN<tuple<>, tuple<KTs>...>; ///< `MergeN` on singleton sequences.
-	public:
-		using type = typename MergeThunk::type; ///< Type of output sequence.
-		
-		/// Obtain output sequence at runtime.
-		template<typename ...Args> constexpr static type apply(Args...args) {
-			tuple<tuple<>, tuple<KTs>...> appArgs = make_tuple(tuple<>(), tuple<KTs>(std::forward<Args>(args))...);
-			return std::apply(MergeThunk::apply, appArgs);
+		/// @return The index of `name`, or `N` if absent.
+		constexpr size_t find(std::string_view name) const {
+			if(N == 0) {
+				return N;
+			} else if(perfect) {
+				const size_t i = slots[slotOf(fnv1a(name))];
+				return (names[i] == name) ? i : N;
+			}
+			size_t lo = 0, hi = N;
+			while(lo < hi) {
+				const size_t mid = lo + (hi - lo) / 2;
+				if(names[mid] < name) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			return (lo < N && names[lo] == name) ? lo : N;
 		}
 	};
+
+	/// Build a `KeyHashTable` over distinct, sorted `names`.
+	template<size_t N>
+	constexpr KeyHashTable<N> makeKeyHashTable(const std::array<std::string_view, N>& names) {
+		using Table = KeyHashTable<N>;
+		constexpr size_t B = Table::Buckets;
+		Table t{};
+		t.names = names;
+		std::array<std::uint64_t, N> hashes{};
+		std::array<size_t, B> counts{};
+		for(size_t i = 0; i < N; ++i) {
+			hashes[i] = fnv1a(names[i]);
+			++counts[hashes[i] % B];
+		}
+		// Place the largest buckets first, while the table is emptiest.
+		std::array<size_t, B> bucketOrder{};
+		for(size_t b = 0; b < B; ++b) {
+			size_t j = b;
+			for(; j > 0 && counts[bucketOrder[j - 1]] < counts[b]; --j) {
+				bucketOrder[j] = bucketOrder[j - 1];
+			}
+			bucketOrder[j] = b;
+		}
+		std::array<bool, N> taken{};
+		std::array<size_t, N> members{};
+		std::array<size_t, N> trial{};
+		size_t nextFree = 0;
+		for(size_t b : bucketOrder) {
+			size_t m = 0;
+			for(size_t i = 0; i < N; ++i) {
+				if(hashes[i] % B == b) {
+					members[m++] = i;
+				}
+			}
+			if(m == 0) {
+				break;
+			} else if(m == 1) {
+				// Singletons need no search: point straight at a free slot.
+				while(taken[nextFree]) {
+					++nextFree;
+				}
+				taken[nextFree] = true;
+				t.slots[nextFree] = members[0];
+				t.seeds[b] = Table::Direct | std::uint32_t(nextFree);
+				continue;
+			}
+			bool placed = false;
+			for(std::uint32_t seed = 0; seed < Table::MaxSeed && !placed; ++seed) {
+				placed = true;
+				for(size_t k = 0; k < m && placed; ++k) {
+					trial[k] = size_t(fnvDisplace(hashes[members[k]], seed) % N);
+					placed = !taken[trial[k]];
+					for(size_t l = 0; l < k && placed; ++l) {
+						placed = (trial[l] != trial[k]);
+					}
+				}
+				if(placed) {
+					for(size_t k = 0; k < m; ++k) {
+						taken[trial[k]] = true;
+						t.slots[trial[k]] = members[k];
+					}
+					t.seeds[b] = seed;
+				}
+			}
+			if(!placed) {
+				return t;
+			}
+		}
+		t.perfect = true;
+		return t;
+	}
 	/**
 	 * @}
 	 ****************************************************************************/
@@ -465,7 +423,7 @@ namespace detail {
 		V v; ///< Stored value
 		L l; ///< Left child
 		R r; ///< Right child
-		constexpr Node(V vi, L li, R ri) : v(vi), l(li), r(ri) {}
+		constexpr Node(V vi, L li, R ri) : v(std::move(vi)), l(std::move(li)), r(std::move(ri)) {}
 	};
 	
 	/// A Node with a stored value, and right child.
@@ -473,7 +431,7 @@ namespace detail {
 	struct Node<V, void, R> {
 		V v; ///< Stored value
 		R r; ///< Right child
-		constexpr Node(V vi, R ri) : v(vi), r(ri) {}
+		constexpr Node(V vi, R ri) : v(std::move(vi)), r(std::move(ri)) {}
 	};
 	
 	/// A Node with a stored value, and left child.
@@ -481,14 +439,14 @@ namespace detail {
 	struct Node<V, L, void> {
 		V v; ///< Stored value
 		L l; ///< Left child
-		constexpr Node(V vi, L li) : v(vi), l(li) {}
+		constexpr Node(V vi, L li) : v(std::move(vi)), l(std::move(li)) {}
 	};
 	
 	/// Leaf Node
 	template<class V>
 	struct Node<V, void, void> {
 		V v; ///< Stored value
-		constexpr Node(V vi) : v(vi) {}
+		constexpr Node(V vi) : v(std::move(vi)) {}
 	};
 	/**
 	 * @}
@@ -496,134 +454,72 @@ namespace detail {
 	
 	
 	//////////////////////////////////////////////////////////////////////////////
-	// Convert a sequence of types into a balanced binary tree of types
-	template<typename Left, typename Right, typename TargetLeft>
-	struct SplitJointIf;
-	
-	template<typename _Left, typename _Right, typename TargetLeft>
-	class Split {
-	public:
-		using Left = void;
-		using Here = void;
-		using Right = void;
-	};
-	
-	template<typename ...Ls, typename H, typename ...Rs, size_t TargetLeft>
-	class Split<tuple<Ls...>, tuple<H, Rs...>, integral_constant<size_t, TargetLeft> > {
-		using IfThunk = SplitJointIf<tuple<Ls...>, tuple<H, Rs...>, integral_constant<size_t, TargetLeft> >;
-	public:
-		using Left = typename IfThunk::Left;
-		using Here = typename IfThunk::Here;
-		using Right = typename IfThunk::Right;
-		
-		template<typename ...Args>
-		static constexpr auto split(Args&& ...args) {
-			return IfThunk::split(std::forward<Args>(args)...);
-		}
-	};
-	
-	/// Note: integral constant required per gcc missing implementation of http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2016/p0263r1.html#1315
-	template<typename Left, typename Right, typename TargetLeft>
-	struct SplitJointIf {};
-	template<typename ...Ls, typename H, typename ...Rs>
-	struct SplitJointIf<tuple<Ls...>, tuple<H, Rs...>, integral_constant<size_t, sizeof...(Ls)> > {
-		using Left = tuple<Ls...>;
-		using Here = H;
-		using Right = tuple<Rs...>;
-		
-		template<typename ...Args>
-		static constexpr tuple<Left,Here,Right> split(Args&& ...args) {
-			auto holder = make_tuple(std::forward<Args>(args) ...);
-			return make_tuple(tuple_slice<0,sizeof...(Ls)>(holder), std::get<sizeof...(Ls)>(holder), tuple_slice<1+sizeof...(Ls),sizeof...(Args)>(holder));
-		}
-		
-	};
-	
-	template<typename ...Ls, typename H, typename ...Rs, size_t TargetLeft>
-	struct SplitJointIf<tuple<Ls...>, tuple<H, Rs...>, integral_constant<size_t, TargetLeft> > {
-	private:
-		static_assert(sizeof...(Ls) < TargetLeft, "Missed the loop exit condition");
-		using SplitThunk = Split<tuple<Ls..., H>, tuple<Rs...>, integral_constant<size_t, TargetLeft> >;
-	public:
-		using Left = typename SplitThunk::Left;
-		using Here = typename SplitThunk::Here;
-		using Right = typename SplitThunk::Right;
-		
-		template<typename ...Args>
-		static constexpr auto split(Args&& ...args) {
-			return SplitThunk::split(std::forward<Args>(args)...);
-		}
+	// A flat (non-recursive) tuple of forwarding references, so that packing up
+	// `N` constructor arguments costs `O(N)` instantiations rather than `O(N^2)`.
+	template<size_t I, typename T>
+	struct ArgRef { T&& ref; };
+
+	template<typename Indices, typename ...Ts>
+	struct ArgRefs;
+
+	template<size_t ...Is, typename ...Ts>
+	struct ArgRefs<std::index_sequence<Is...>, Ts...> : ArgRef<Is, Ts>... {
+		constexpr ArgRefs(Ts&& ...ts) : ArgRef<Is, Ts>{std::forward<Ts>(ts)}... {}
 	};
+
+	template<typename ...Ts>
+	constexpr ArgRefs<std::index_sequence_for<Ts...>, Ts...> forwardArgs(Ts&& ...ts) {
+		return ArgRefs<std::index_sequence_for<Ts...>, Ts...>(std::forward<Ts>(ts)...);
+	}
+
+	/// Forward the `I`th argument out of an `ArgRefs`, found by derived-to-base deduction.
+	template<size_t I, typename T>
+	constexpr T&& argRef(const ArgRef<I, T>& a) {
+		return std::forward<T>(a.ref);
+	}
 	//////////////////////////////////////////////////////////////////////////////
 	
 	
 	//////////////////////////////////////////////////////////////////////////////
-	// Entry point for our list->tree process
-	template<template<typename, typename, typename> class Node, class V, class L, class R>
-	struct NodeMaker;
-	
-	template<template<typename, typename, typename> class Node, typename HL>
-	class SortedToTree { public: using type = void; };
-	
-	template<template<typename, typename, typename> class Node, typename HeadT, typename ...TailTs>
-	class SortedToTree<Node, tuple<HeadT, TailTs...>> {
-		using SplitThunk = Split<tuple<>, tuple<HeadT, TailTs...>, integral_constant<size_t, sizeof...(TailTs) / 2> >;
-		using Left = typename SplitThunk::Left;
-		using Here = typename SplitThunk::Here;
-		using Right = typename SplitThunk::Right;
-		
-		
-		using LeftThunk = SortedToTree<Node, Left>;
-		using RightThunk =  SortedToTree<Node, Right>;
+	// Convert a sorted sequence of types into a balanced binary tree of types.
+	// Each subtree is identified by its index range `[Lo, Hi)` into `Keys::type`.
+	template<typename Keys, size_t Lo, size_t Hi, typename = void>
+	struct SortedToTree { using type = void; };
+
+	template<typename Keys, size_t Lo, size_t Hi>
+	struct SortedToTree<Keys, Lo, Hi, std::enable_if_t<(Lo < Hi)>> {
+	private:
+		constexpr static const size_t Mid = Lo + (Hi - Lo - 1) / 2; ///< Left subtree gets the smaller half.
+		using LeftThunk = SortedToTree<Keys, Lo, Mid>;
+		using RightThunk = SortedToTree<Keys, Mid + 1, Hi>;
+		using Here = std::tuple_element_t<Mid, typename Keys::type>;
 	public:
-		using ArgType = tuple<HeadT, TailTs...>;
 		using type = Node<Here, typename LeftThunk::type, typename RightThunk::type>;
-		
-		constexpr static type apply(const tuple<HeadT, TailTs...>& args) {
-			using SplitF = tuple<Left,Here,Right>(&)(const HeadT&, const TailTs&...);
-			auto ret = std::apply(static_cast<SplitF>(SplitThunk::template split<const HeadT&, const TailTs&...>), args);
-			auto& [left, here, right] = ret;
-			return NodeMaker<Node, Here, LeftThunk, RightThunk>::apply(here, left, right);
-		}
-	};
-	//////////////////////////////////////////////////////////////////////////////
-	
-	
-	//////////////////////////////////////////////////////////////////////////////
-	// Deferred evaluation to select between node variants from the tree-assembly
-	template<template<typename, typename, typename> class Node, class V, class L, class R>
-	struct NodeMaker {
-		using LR = typename L::type;
-		using LA = typename L::ArgType;
-		using RR = typename R::type;
-		using RA = typename R::ArgType;
-		constexpr static Node<V, LR, RR> apply(V& v, LA& l, RA& r) {
-			return Node(v, L::apply(l), R::apply(r));
-		}
-	};
-	
-	template<template<typename, typename, typename> class Node, class V, class L>
-	struct NodeMaker<Node, V, L, SortedToTree<Node, tuple<>>> {
-		using LR = typename L::type;
-		using LA = typename L::ArgType;
-		constexpr static Node<V, LR, void> apply(V& v, LA& l, tuple<>&) {
-			return Node<V, LR, void>(v, L::apply(l));
-		}
-	};
-	
-	template<template<typename, typename, typename> class Node, class V, class R>
-	struct NodeMaker<Node, V, SortedToTree<Node, tuple<>>, R> {
-		using RR = typename R::type;
-		using RA = typename R::ArgType;
-		constexpr static Node<V, void, RR> apply(V& v, tuple<>&, RA& r) {
-			return Node<V, void, RR>(v, R::apply(r));
+
+		/// The `ValueType` of the `I`th least key in (sub)tree `n`.
+		template<size_t I, typename N>
+		constexpr static auto& at(N &n) {
+			if constexpr (I == Mid) {
+				return n.v;
+			} else if constexpr (I < Mid) {
+				return LeftThunk::template at<I>(n.l);
+			} else {
+				return RightThunk::template at<I>(n.r);
+			}
 		}
-	};
-	
-	template<template<typename, typename, typename> class Node, class V>
-	struct NodeMaker<Node, V, SortedToTree<Node, tuple<>>, SortedToTree<Node, tuple<>>> {
-		constexpr static Node<V, void, void> apply(V& v, tuple<>&, tuple<>&) {
-			return Node<V, void, void>(v);
+
+		/// Build the subtree from `args`, an `ArgRefs` in unsorted (argument) order. Forwards each argument once.
+		template<typename Args>
+		constexpr static type apply(const Args& args) {
+			if constexpr (Lo == Mid && Mid + 1 == Hi) {
+				return type(argRef<Keys::order[Mid]>(args));
+			} else if constexpr (Lo == Mid) {
+				return type(argRef<Keys::order[Mid]>(args), RightThunk::apply(args));
+			} else if constexpr (Mid + 1 == Hi) {
+				return type(argRef<Keys::order[Mid]>(args), LeftThunk::apply(args));
+			} else {
+				return type(argRef<Keys::order[Mid]>(args), LeftThunk::apply(args), RightThunk::apply(args));
+			}
 		}
 	};
 	//////////////////////////////////////////////////////////////////////////////
@@ -672,14 +568,20 @@ namespace detail {
 	template<typename FindMe, typename T>
 	class FindInTree { public: using type = void; };
 	
+	/// `FindInTree` result when `V` is the key being looked up.
+	template<typename V>
+	struct FoundInTree { using type = V; };
+	
 	template<typename FindMe, template<typename, typename, typename> class Node, typename V, typename L, typename R>
 	class FindInTree<FindMe, Node<V, L, R> > {
 		constexpr static const bool LookLeft = KeyLess<FindMe, V>::value;
 		constexpr static const bool LookRight = KeyLess<V, FindMe>::value;
 		using LeftBranch = FindInTree<FindMe, L>;
 		using RightBranch = FindInTree<FindMe, R>;
+		/// Select a branch before asking for its `type`, so only the subtrees along the search path are instantiated.
+		using Branch = std::conditional_t<LookLeft, LeftBranch, std::conditional_t<LookRight, RightBranch, FoundInTree<V> > >;
 	public:
-		using type = typename std::conditional<LookLeft, typename LeftBranch::type, typename std::conditional<LookRight, typename RightBranch::type, V>::type>::type;
+		using type = typename Branch::type;
 		
 		constexpr static auto& apply(Node<V, L, R> &n) {
 			return FindInTreeHelper<Node<V,L,R>, LeftBranch, RightBranch, LookLeft, LookRight>::apply(n);
@@ -716,27 +618,35 @@ namespace detail {
 		constexpr static const auto& apply(const Tree &tree) { return DUMMY; }
 	};
 	
-	template<typename ...Args>
-	struct NoRepeats {
-		constexpr static const bool value = true;
-	};
-	
-	template<typename A, typename B, typename ...Args>
-	struct NoRepeats<A, B, Args...> {
-		constexpr static const bool value = NoRepeats<B, Args...>::value;
-	};
-	
-	template<typename A, typename ...Args>
-	struct NoRepeats<A, A, Args...> {
-		constexpr static const bool value = false;
-	};
+	/// `true` if no two adjacent `names` are equal (so, for sorted `names`, if there are no repeats at all).
+	template<size_t N>
+	constexpr bool noAdjacentRepeats(const std::array<std::string_view, N>& names) {
+		for(size_t i = 1; i < N; ++i) {
+			if(names[i - 1] == names[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
 	
 	template<typename T>
 	struct NoRepeatsDispatcher {};
 	
+	/// Check a sorted sequence of `KeyType`s or `CharList`s for repeated strings, regardless of the associated types.
 	template<typename ...Args>
 	struct NoRepeatsDispatcher<tuple<Args...>> {
-		static constexpr bool value = NoRepeats<typename Args::KeyType::Typeless ...>::value;
+		static constexpr bool value = noAdjacentRepeats<sizeof...(Args)>({{std::string_view(Args::c_str(), Args::length())...}});
+	};
+	
+	/// Metafunction to test if a `From` can initialize a `To` without narrowing (i.e. by brace-initialization), generically `false`.
+	template<typename To, typename From, typename = void>
+	struct IsNonNarrowing {
+		constexpr static const bool value = false;
+	};
+	/// Specialization for `From`s which can brace-initialize a `To`. Pointers are never considered to convert losslessly to `bool`.
+	template<typename To, typename From>
+	struct IsNonNarrowing<To, From, std::void_t<decltype(To{std::declval<From>()})> > {
+		constexpr static const bool value = !(std::is_same_v<To, bool> && std::is_pointer_v<std::decay_t<From> >);
 	};
 	//////////////////////////////////////////////////////////////////////////////
 }
@@ -758,6 +668,10 @@ constexpr auto inferredKeyType(StringHolder holder) {
 	return detail::inferredKeyTypeImpl(holder, std::make_index_sequence<1+text.length()>());
 }
 
+namespace detail {
+	struct HMapAccess;
+}
+
 /**********************************************************
  * A balanced binary search tree, associating string-like
  * keys with values of potentially varying types.
@@ -771,11 +685,12 @@ constexpr auto inferredKeyType(StringHolder holder) {
  * of different types with the same string key. This is different
  * from the behavior of `DynamicHMap` which treats the same name
  * for different types as existing within different "universes
- * of discourse". The primary reason for the limitation here
- * is that all of the mechanisms which C++ provides for obtaining
- * an ordering on types are, ironically, only useable at runtime,
- * and, annoyingly, non-portable so best not to bake into the ABI
- * even if we could.
+ * of discourse". `detail::typeId` now gives a compile-time
+ * ordering on types (which breaks ties between equal names
+ * in `DynamicHMap`), but lookups here infer the value type
+ * from the name alone and dispatch on names at runtime, both
+ * of which need each name to be unique. Since type ids differ
+ * between compilers, they are also best not baked into the ABI.
  * 
  * @tparam KeyTypes `detail::KeyType`s specifying which keys
  * are present in the `HMap` and the type of their associated
@@ -783,20 +698,46 @@ constexpr auto inferredKeyType(StringHolder holder) {
  **********************************************************/
 template<typename ...KeyTypes>
 class HMap {
-	using MergeThunk = detail::MergeSort<typename KeyTypes::ValueType...>; ///< Sort key-value pairs lexicographically
-	using Sorted = typename MergeThunk::type; ///< Extract the sorted order
-	using TreeThunk = detail::SortedToTree<detail::Node, Sorted>; ///< Construct balanced binary search tree from sorted order
+	friend struct detail::HMapAccess; ///< Sorted-order access for bulk operations.
+	
+	using SortThunk = detail::SortKeys<typename KeyTypes::ValueType...>; ///< Sort key-value pairs lexicographically
+	using Sorted = typename SortThunk::type; ///< Extract the sorted order
+	using TreeThunk = detail::SortedToTree<SortThunk, 0, sizeof...(KeyTypes)>; ///< Construct balanced binary search tree from sorted order
 	using Tree = typename TreeThunk::type; ///< Extract the node definitions for the tree
 	constexpr static const bool NoDuplicateKeys = detail::NoRepeatsDispatcher<Sorted>::value; ///< Ensure uniqueness of keys
 	
 	template<typename KeyType> using ValueThunk = detail::FindInTree<KeyType, Tree>; ///< Helper for doing lookups.
 	
+	constexpr static const detail::KeyHashTable<sizeof...(KeyTypes)> KeyTable = detail::makeKeyHashTable(SortThunk::sorted_names); ///< Runtime lookup of keys by name
+	
 	Tree tree_; ///< The actual data-structure.
+	
+	template<size_t I> using NameOf = typename std::tuple_element_t<I, Sorted>::Typeless; ///< The `CharList` naming the `I`th least key.
+	
+	/// `for_each` helper: call `f(name, value)` on each key-value pair in key order, unrolled by a fold expression.
+	template<typename Self, typename F, size_t ...Is>
+	constexpr static void forEachIndex(Self &self, F &f, std::index_sequence<Is...>) {
+		(static_cast<void>(f(NameOf<Is>(), TreeThunk::template at<Is>(self.tree_).v)), ...);
+	}
+	
+	/// `transform` helper. Braced initialization calls `f` in key order.
+	template<typename Self, typename F, size_t ...Is>
+	constexpr static auto transformIndex(Self &self, F &f, std::index_sequence<Is...>) {
+		using Result = HMap<typename detail::KeyTypeFor<std::decay_t<decltype(f(NameOf<Is>(), TreeThunk::template at<Is>(self.tree_).v))>, NameOf<Is>>::type...>;
+		return Result{typename detail::KeyTypeFor<std::decay_t<decltype(f(NameOf<Is>(), TreeThunk::template at<Is>(self.tree_).v))>, NameOf<Is>>::type::ValueType(
+		                  f(NameOf<Is>(), TreeThunk::template at<Is>(self.tree_).v))...};
+	}
+	
+	/// `visit_key` helper: call `f` on the value of the `i`th least key. Usually compiles to a jump table.
+	template<typename Self, typename F, size_t ...Is>
+	constexpr static bool visitIndex(Self &self, size_t i, F &f, std::index_sequence<Is...>) {
+		return ((i == Is && (static_cast<void>(f(TreeThunk::template at<Is>(self.tree_).v)), true)) || ...);
+	}
 public:
 	/// Construct tree from input key-value pairs in arbitrary order
 	template<typename ...Values>
 	constexpr HMap(Values&& ...values)
-	: tree_(TreeThunk::apply(MergeThunk::apply(std::forward<Values>(values)...))) {
+	: tree_(TreeThunk::apply(detail::forwardArgs(std::forward<Values>(values)...))) {
 		static_assert(NoDuplicateKeys, "HMap would contain duplicate keys");
 	}
 	
@@ -839,8 +780,135 @@ public:
 		static_assert(!std::is_same_v<ValueType, void>, "HMap doesn't contain key");
 		return detail::HMapSafeIndexer<Thunk, Tree, ValueType>::apply(tree_);
 	}
+	
+	/**********************************************************
+	 * Lookup a key by its runtime name, e.g. when deserializing.
+	 * @arg name The key's string.
+	 * @arg f Invoked with a reference to the value of the key
+	 * named `name`, if there is one. Should therefore accept
+	 * every value type in the map (e.g. a generic lambda).
+	 * @return `true` if `f` was invoked, `false` on a miss.
+	 **********************************************************/
+	template<typename F>
+	constexpr bool visit_key(std::string_view name, F&& f) {
+		return visitIndex(*this, KeyTable.find(name), f, std::index_sequence_for<KeyTypes...>());
+	}
+	
+	/// `const` overload. Invokes `f` with a `const` reference.
+	template<typename F>
+	constexpr bool visit_key(std::string_view name, F&& f) const {
+		return visitIndex(*this, KeyTable.find(name), f, std::index_sequence_for<KeyTypes...>());
+	}
+	
+	/// Assign `a` to the value of the key named `name`. @return `false` if there is no such key, or its value isn't assignable from `a` without narrowing.
+	template<typename A>
+	constexpr bool set_from(std::string_view name, A&& a) {
+		bool assigned = false;
+		visit_key(name, [&a, &assigned](auto &v) {
+			using V = std::remove_reference_t<decltype(v)>;
+			if constexpr (std::is_assignable_v<decltype(v), A&&>
+			              && (std::is_same_v<std::decay_t<A>, V> || detail::IsNonNarrowing<V, A&&>::value)) {
+				v = std::forward<A>(a);
+				assigned = true;
+			}
+		});
+		return assigned;
+	}
+	
+	/**********************************************************
+	 * Call `f(name, value)` on every key-value pair, in key
+	 * order, where `name` is the key's `CharList` (so
+	 * `decltype(name)::c_str()` is a constant expression).
+	 * Fully unrolled at compile-time: there is no dispatch.
+	 * @arg f Should therefore accept every value type in the
+	 * map (e.g. a generic lambda).
+	 **********************************************************/
+	template<typename F>
+	constexpr void for_each(F&& f) {
+		forEachIndex(*this, f, std::index_sequence_for<KeyTypes...>());
+	}
+	
+	/// `const` overload. Invokes `f` with a `const` reference.
+	template<typename F>
+	constexpr void for_each(F&& f) const {
+		forEachIndex(*this, f, std::index_sequence_for<KeyTypes...>());
+	}
+	
+	/// A new `HMap` with the same keys, mapping each to `f(name, value)` (called in key order, as for `for_each`), and typed accordingly.
+	template<typename F>
+	constexpr auto transform(F&& f) {
+		return transformIndex(*this, f, std::index_sequence_for<KeyTypes...>());
+	}
+	
+	/// `const` overload. Invokes `f` with a `const` reference.
+	template<typename F>
+	constexpr auto transform(F&& f) const {
+		return transformIndex(*this, f, std::index_sequence_for<KeyTypes...>());
+	}
 };
 
+namespace detail {
+	/// Sorted-order access to the contents of an `HMap`, for bulk operations such as conversions.
+	struct HMapAccess {
+		/// The `detail::detail::ValueType`s of `HMapT`, sorted by key.
+		template<typename HMapT>
+		struct SortedOf {
+			using type = typename std::remove_const_t<HMapT>::Sorted;
+		};
+		template<typename HMapT>
+		using Sorted = typename SortedOf<HMapT>::type;
+		
+		/// The `I`th least key-value pair (a `detail::detail::ValueType`) in `m`.
+		template<size_t I, typename HMapT>
+		constexpr static auto& at(HMapT &m) {
+			return std::remove_const_t<HMapT>::TreeThunk::template at<I>(m.tree_);
+		}
+		
+		/// `true` if `HMapL` and `HMapR` have the same keys, with the same types, in any order.
+		template<typename HMapL, typename HMapR>
+		constexpr static bool equivalent = std::is_same_v<Sorted<HMapL>, Sorted<HMapR>>;
+		
+		/// `operator==` helper: compare the values of each key, in key order, stopping at the first difference.
+		template<typename HMapL, typename HMapR, size_t ...Is>
+		constexpr static bool equal(const HMapL &l, const HMapR &r, std::index_sequence<Is...>) {
+			return ((at<Is>(l).v == at<Is>(r).v) && ...);
+		}
+	};
+	
+	/// Mix `h` into `seed`, as `boost::hash_combine` does.
+	constexpr std::size_t hashCombine(std::size_t seed, std::size_t h) {
+		return seed ^ (h + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+	}
+}
+
+/// `true` if every key of `l` has a value equal to that of `r`, which has the same keys in any order. Fully unrolled.
+template<typename ...LKeyTypes, typename ...RKeyTypes,
+         std::enable_if_t<detail::HMapAccess::equivalent<HMap<LKeyTypes...>, HMap<RKeyTypes...>>, bool> = true>
+constexpr bool operator==(const HMap<LKeyTypes...> &l, const HMap<RKeyTypes...> &r) {
+	return detail::HMapAccess::equal(l, r, std::index_sequence_for<LKeyTypes...>());
+}
+
+/// Negation of `operator==`.
+template<typename ...LKeyTypes, typename ...RKeyTypes,
+         std::enable_if_t<detail::HMapAccess::equivalent<HMap<LKeyTypes...>, HMap<RKeyTypes...>>, bool> = true>
+constexpr bool operator!=(const HMap<LKeyTypes...> &l, const HMap<RKeyTypes...> &r) {
+	return !(l == r);
+}
+
+namespace std {
+	/// Combines `std::hash` of each value in key order, so equal maps (even with keys given in different orders) hash equally.
+	template<typename ...KeyTypes>
+	struct hash<HMap<KeyTypes...>> {
+		std::size_t operator()(const HMap<KeyTypes...> &m) const {
+			std::size_t seed = 0;
+			m.for_each([&seed](auto, const auto &v) {
+				seed = detail::hashCombine(seed, std::hash<std::decay_t<decltype(v)>>()(v));
+			});
+			return seed;
+		}
+	};
+}
+
 /*************************************************
  * Construct an `HMap` from a sequence of key-value 
  * pairs (`detail::detail::ValueType`).
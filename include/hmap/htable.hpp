@@ -0,0 +1,357 @@
+#pragma once
+/************************************************************************************
+ * @file htable.hpp A columnar (struct-of-arrays) table of records sharing one static
+ * @ref hmap.hpp schema, storing each field as its own contiguous, aligned column.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <new>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <hmap/hmap.hpp>
+
+namespace detail {
+	/// Columns start on (at least) a cache line, so that vectorized scans begin on an aligned load.
+	constexpr std::size_t kColumnAlignment = 64;
+
+	/// Allocates `T`s aligned to `Align` (or to `alignof(T)`, if stricter), for `HTable`'s columns.
+	template<typename T, std::size_t Align = kColumnAlignment>
+	struct AlignedAllocator {
+		using value_type = T;
+		static constexpr std::align_val_t alignment{std::max(Align, alignof(T))};
+
+		template<typename U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+		AlignedAllocator() = default;
+		template<typename U>
+		constexpr AlignedAllocator(const AlignedAllocator<U, Align>&) noexcept {}
+
+		T* allocate(std::size_t n) {
+			return static_cast<T*>(::operator new(n * sizeof(T), alignment));
+		}
+		void deallocate(T *p, std::size_t) noexcept {
+			::operator delete(p, alignment);
+		}
+
+		template<typename U>
+		constexpr bool operator==(const AlignedAllocator<U, Align>&) const noexcept { return true; }
+		template<typename U>
+		constexpr bool operator!=(const AlignedAllocator<U, Align>&) const noexcept { return false; }
+	};
+
+	/// A contiguous run of `T`s which it doesn't own, like C++20's `std::span`.
+	template<typename T>
+	class Span {
+		T *data_ = nullptr;
+		std::size_t size_ = 0;
+
+	  public:
+		using element_type = T;
+		using value_type = std::remove_cv_t<T>;
+		using iterator = T*;
+
+		constexpr Span() = default;
+		constexpr Span(T *data, std::size_t size) : data_(data), size_(size) {}
+
+		constexpr T* data() const { return data_; }
+		constexpr std::size_t size() const { return size_; }
+		constexpr bool empty() const { return size_ == 0; }
+		constexpr T& operator[](std::size_t i) const { return data_[i]; }
+		constexpr T& front() const { return data_[0]; }
+		constexpr T& back() const { return data_[size_ - 1]; }
+		constexpr iterator begin() const { return data_; }
+		constexpr iterator end() const { return data_ + size_; }
+	};
+
+	/// A `bool` in an `HTable` column, which would otherwise be a `std::vector<bool>`, whose elements can't be referenced or spanned.
+	struct ColumnBool {
+		bool value = false;
+
+		ColumnBool() = default;
+		ColumnBool(bool v) : value(v) {}
+	};
+	static_assert(sizeof(ColumnBool) == sizeof(bool) && std::is_standard_layout_v<ColumnBool>, "ColumnBool must be laid out as a bool");
+
+	/// How an `HTable` column stores each `V`: as itself, except for `bool`.
+	template<typename V>
+	struct ColumnStorage { using type = V; };
+	template<>
+	struct ColumnStorage<bool> { using type = ColumnBool; };
+
+	/// The values in `column` (a `std::vector` of `ColumnStorage<V>::type`) as `V`s. A `ColumnBool` is pointer-interconvertible with its `bool`.
+	template<typename V, typename Column>
+	auto columnData(Column &column) {
+		using T = std::conditional_t<std::is_const_v<Column>, const V, V>;
+		return reinterpret_cast<T*>(column.data());
+	}
+
+	/// @return The index of the key named `name` in `names`, or `N` if absent.
+	template<size_t N>
+	constexpr size_t columnIndexOf(const std::array<std::string_view, N>& names, std::string_view name) {
+		for(size_t i = 0; i < N; ++i) {
+			if(names[i] == name) {
+				return i;
+			}
+		}
+		return N;
+	}
+
+	template<typename Table> class HTableRow;
+}
+
+/**********************************************************
+ * A table of records with the same keys as an
+ * `HMap<KeyTypes...>`, stored column-by-column: the values
+ * of each key are contiguous (and start on an aligned
+ * boundary), so a scan over a few fields touches only
+ * their columns, and vectorizes like a loop over arrays.
+ *
+ * Keys are sorted, and checked for duplicates, exactly as
+ * for `HMap`, so rows can be pushed from (and converted
+ * back to) any `HMap` with the same keys, in any order.
+ * `bool` columns hold one `bool` per byte, rather than
+ * being `std::vector<bool>`s.
+ *
+ * Typical usage:
+ * <pre class="markdeep">
+ * ```c++
+ * auto table = make_htable(TK("x", float), TK("id", int));
+ * table.push_back(make_hmap((TK("x", float), 1.f), (TK("id", int), 7)));
+ * float total = 0;
+ * for(float x : table[TK("x", float)]) { total += x; }
+ * ```
+ * </pre>
+ *
+ * @tparam KeyTypes As for `HMap`.
+ **********************************************************/
+template<typename ...KeyTypes>
+class HTable {
+	template<typename Table> friend class detail::HTableRow;
+
+	using SortThunk = detail::SortKeys<typename KeyTypes::ValueType...>; ///< Sort key-value pairs lexicographically, as `HMap` does.
+	using Sorted = typename SortThunk::type; ///< `detail::detail::ValueType`s in key order.
+	constexpr static const size_t N = sizeof...(KeyTypes);
+	static_assert(detail::NoRepeatsDispatcher<Sorted>::value, "HTable would contain duplicate keys");
+
+	template<size_t I> using ValueAt = typename std::tuple_element_t<I, Sorted>::Value; ///< Value type of the `I`th least key.
+	template<size_t I> using NameOf = typename std::tuple_element_t<I, Sorted>::Typeless; ///< The `CharList` naming the `I`th least key.
+	template<typename V> using Column = std::vector<typename detail::ColumnStorage<V>::type, detail::AlignedAllocator<typename detail::ColumnStorage<V>::type> >;
+
+	template<typename Indices> struct ColumnsFor;
+	template<size_t ...Is>
+	struct ColumnsFor<std::index_sequence<Is...> > {
+		using type = std::tuple<Column<ValueAt<Is> >...>;
+	};
+	using Columns = typename ColumnsFor<std::make_index_sequence<N> >::type;
+
+  public:
+	using hmap_type = HMap<KeyTypes...>; ///< The type of one row, as a standalone map.
+
+  private:
+	Columns columns_; ///< One column per key, in key order.
+	size_t rows_ = 0; ///< Kept separately, so that a table without keys still counts its rows.
+
+	/// The position of `KeyType` in key order, checking that it is present (and for a `detail::KeyType`, that its type matches).
+	template<typename KeyType>
+	constexpr static size_t columnOf() {
+		constexpr size_t I = detail::columnIndexOf(SortThunk::sorted_names, std::string_view(KeyType::c_str(), KeyType::length()));
+		static_assert(I < N, "HTable doesn't contain key");
+		if constexpr (detail::IsKeyType<KeyType>::value && I < N) {
+			static_assert(std::is_same_v<ValueAt<I>, typename KeyType::Value>, "HTable contains key, but it has the wrong type");
+		}
+		return I;
+	}
+
+	/// Shared implementation of each `operator[](const KeyType&)`.
+	template<typename KeyType, typename Self>
+	static auto column(Self &self) {
+		constexpr size_t I = columnOf<KeyType>();
+		auto *data = detail::columnData<ValueAt<I> >(std::get<I>(self.columns_));
+		return detail::Span<std::remove_pointer_t<decltype(data)> >(data, self.rows_);
+	}
+
+	/// `push_back` helper: append each value of `m` to its column, truncating every column back on failure.
+	template<typename HMapT, size_t ...Is>
+	void append(HMapT &&m, std::index_sequence<Is...>) {
+		struct Rollback {
+			HTable *table;
+			~Rollback() {
+				if(table) {
+					// `erase`, unlike `resize`, doesn't need a default constructor.
+					(static_cast<void>(std::get<Is>(table->columns_).erase(std::get<Is>(table->columns_).begin() + std::min(std::get<Is>(table->columns_).size(), table->rows_),
+					                                                        std::get<Is>(table->columns_).end())), ...);
+				}
+			}
+		} rollback{this};
+		constexpr bool Move = !std::is_lvalue_reference_v<HMapT>;
+		(static_cast<void>(std::get<Is>(columns_).push_back(
+		     std::conditional_t<Move, ValueAt<Is>&&, const ValueAt<Is>&>(detail::HMapAccess::at<Is>(m).v))), ...);
+		rollback.table = nullptr;
+		++rows_;
+	}
+
+	/// `HTableRow::to_hmap` helper. `HMap`'s constructor takes its values in `KeyTypes` order, rather than key order.
+	hmap_type rowAt(size_t row) const {
+		return hmap_type(typename KeyTypes::ValueType(detail::columnData<typename KeyTypes::Value>(std::get<columnOf<KeyTypes>()>(columns_))[row])...);
+	}
+
+	template<size_t ...Is>
+	void reserveColumns(size_t n, std::index_sequence<Is...>) {
+		(static_cast<void>(std::get<Is>(columns_).reserve(n)), ...);
+	}
+
+	template<size_t ...Is>
+	void clearColumns(std::index_sequence<Is...>) {
+		(static_cast<void>(std::get<Is>(columns_).clear()), ...);
+	}
+
+	/// `for_each_column` helper, unrolled as for `HMap::for_each`.
+	template<typename Self, typename F, size_t ...Is>
+	static void forEachColumn(Self &self, F &f, std::index_sequence<Is...>) {
+		(static_cast<void>(f(NameOf<Is>(), column<NameOf<Is> >(self))), ...);
+	}
+
+  public:
+	using row_reference = detail::HTableRow<HTable>; ///< Proxy for one row, behaving like an `HMap` of references.
+	using const_row_reference = detail::HTableRow<const HTable>; ///< `const` proxy for one row.
+
+	HTable() = default;
+
+	/// Number of rows.
+	size_t size() const { return rows_; }
+	/// `true` if `size() == 0`.
+	bool empty() const { return rows_ == 0; }
+	/// Reserve space for `n` rows in every column.
+	void reserve(size_t n) {
+		reserveColumns(n, std::make_index_sequence<N>());
+	}
+	/// Remove every row.
+	void clear() {
+		clearColumns(std::make_index_sequence<N>());
+		rows_ = 0;
+	}
+
+	/// Append a row, copying (or moving) each value of `m`, an `HMap` with the same keys as the table, in any order.
+	template<typename HMapT, std::enable_if_t<detail::HMapAccess::equivalent<std::remove_cv_t<std::remove_reference_t<HMapT> >, hmap_type>, bool> = true>
+	void push_back(HMapT &&m) {
+		append(std::forward<HMapT>(m), std::make_index_sequence<N>());
+	}
+
+	/// The values of `KeyType` in every row, as a contiguous `detail::Span`. Only the key's type matters, as for `HMap::operator[]`.
+	template<typename KeyType, std::enable_if_t<detail::IsKeyType<KeyType>::value || detail::IsCharList<KeyType>::value, bool> = false>
+	auto operator[](const KeyType&) {
+		return column<KeyType>(*this);
+	}
+
+	/// `const` overload, returning a `detail::Span` of `const` values.
+	template<typename KeyType, std::enable_if_t<detail::IsKeyType<KeyType>::value || detail::IsCharList<KeyType>::value, bool> = false>
+	auto operator[](const KeyType&) const {
+		return column<KeyType>(*this);
+	}
+
+	/// The `i`th row. @pre `i < size()`.
+	row_reference operator[](size_t i) {
+		return row_reference(*this, i);
+	}
+
+	/// `const` overload.
+	const_row_reference operator[](size_t i) const {
+		return const_row_reference(*this, i);
+	}
+
+	/// Call `f(name, column)` on every key's column (a `detail::Span`), in key order, unrolled as for `HMap::for_each`.
+	template<typename F>
+	void for_each_column(F&& f) {
+		forEachColumn(*this, f, std::make_index_sequence<N>());
+	}
+
+	/// `const` overload, passing spans of `const` values.
+	template<typename F>
+	void for_each_column(F&& f) const {
+		forEachColumn(*this, f, std::make_index_sequence<N>());
+	}
+};
+
+namespace detail {
+	/**********************************************************
+	 * One row of an `HTable` (which may be `const`), looked up
+	 * like an `HMap`: `row[TK("x", float)]` is a reference into
+	 * the table's `x` column. Invalidated, like an iterator,
+	 * by anything which reallocates the table's columns.
+	 **********************************************************/
+	template<typename Table>
+	class HTableRow {
+		using Raw = std::remove_const_t<Table>;
+		Table *table_;
+		size_t row_;
+
+		template<typename Self, typename F, size_t ...Is>
+		static void forEachIndex(Self &self, F &f, std::index_sequence<Is...>) {
+			(static_cast<void>(f(typename Raw::template NameOf<Is>(), columnData<typename Raw::template ValueAt<Is> >(std::get<Is>(self.table_->columns_))[self.row_])), ...);
+		}
+
+	  public:
+		HTableRow(Table &table, size_t row) : table_(&table), row_(row) {}
+
+		/// Reference to the value of `KeyType` in this row. Only the key's type matters, as for `HMap::operator[]`.
+		template<typename KeyType, std::enable_if_t<IsKeyType<KeyType>::value || IsCharList<KeyType>::value, bool> = false>
+		auto& operator[](const KeyType&) const {
+			constexpr size_t I = Raw::template columnOf<KeyType>();
+			return columnData<typename Raw::template ValueAt<I> >(std::get<I>(table_->columns_))[row_];
+		}
+
+		/// Call `f(name, value)` on each value in this row, in key order, as for `HMap::for_each`.
+		template<typename F>
+		void for_each(F&& f) const {
+			forEachIndex(*this, f, std::make_index_sequence<Raw::N>());
+		}
+
+		/// Copy this row out of the table, as a standalone `HMap`.
+		typename Raw::hmap_type to_hmap() const {
+			return table_->rowAt(row_);
+		}
+	};
+}
+
+/*************************************************
+ * Construct an empty `HTable` with the given keys
+ * (`detail::KeyType`s, e.g. from `TK`), since C++17
+ * can't name them with `decltype(TK(...))`.
+ *************************************************/
+template<typename ...KeyTypes>
+constexpr HTable<KeyTypes...> make_htable(const KeyTypes& ...) {
+	return HTable<KeyTypes...>();
+}
+
+namespace detail {
+	template<typename HMapT> struct HTableOf;
+	template<typename ...KeyTypes>
+	struct HTableOf<HMap<KeyTypes...> > { using type = HTable<KeyTypes...>; };
+}
+
+/// The `HTable` whose rows are `HMapT`s, e.g. `HTableOf<decltype(myMap)>`.
+template<typename HMapT>
+using HTableOf = typename detail::HTableOf<HMapT>::type;
@@ -0,0 +1,444 @@
+#pragma once
+/************************************************************************************
+ * @file json-loader.hpp A streaming JSON loader which builds the maps of
+ * @ref dynamic-hmap.hpp directly, without an intermediate document tree.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <any>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <boost/iterator/transform_iterator.hpp>
+
+#include <hmap/dynamic-hmap.hpp>
+
+/******************************************************
+ * Parses JSON objects straight into `Map`s (by
+ * default, `DynamicHMap`s), one value at a time.
+ *
+ * JSON values are mapped to keys as follows:
+ *  - integers which fit are `dK<std::int64_t>`, and
+ *    other numbers are `dK<double>`;
+ *  - strings are `dK<std::string>`;
+ *  - `true`/`false` are `dK<bool>`;
+ *  - objects are (nested) `dK<Map>`;
+ *  - arrays are `dK<std::vector<std::any>>`, whose
+ *    elements follow the same rules (with `null`
+ *    elements left empty);
+ *  - `null` members are omitted.
+ *
+ * Each object's entries are parsed into a buffer,
+ * sorted once (by key, breaking ties by position),
+ * and bulk-loaded with insert hints.
+ * Buffers (one per nesting depth) and the scratch
+ * space for unescaping strings belong to the loader,
+ * and are reused from one object to the next, so once
+ * warmed up a loader allocates only the maps' own
+ * nodes and values. Keep one loader per thread.
+ *
+ * If members repeat a key, the last one wins.
+ *
+ * Input must be valid JSON (RFC 8259): in particular,
+ * numbers must follow its grammar, strings may not
+ * contain raw control characters or unpaired
+ * surrogates, and arrays and objects may be nested at
+ * most `max_depth` deep.
+ ******************************************************/
+template<typename Map = DynamicHMap>
+class BasicJsonLoader {
+  public:
+	using allocator_type = typename Map::allocator_type; ///< Used for every map built, and any allocator-aware values.
+	using array_type = std::vector<std::any>; ///< Type of JSON arrays.
+	static constexpr size_t max_depth = 512; ///< Deepest nesting of arrays and objects accepted, bounding the parser's recursion.
+
+  private:
+	using Entry = std::pair<detail::KeyBase, std::any>;
+
+	/// The members of one object being parsed.
+	struct Members {
+		std::vector<Entry> entries; ///< In the order they were parsed.
+		std::vector<size_t> order; ///< Indices into `entries`, sorted by key.
+	};
+
+	allocator_type alloc_;
+	std::deque<Members> entries_; ///< One buffer per nesting depth (`std::deque` so that references survive pushing a deeper one).
+	std::string scratch_; ///< Unescaped text of the string being parsed.
+	std::string line_; ///< Current line, for `loadLines`.
+	size_t depth_ = 0; ///< Objects being parsed, i.e. buffers of `entries_` in use.
+	size_t nesting_ = 0; ///< Arrays and objects being parsed.
+	const char *begin_ = nullptr;
+	const char *p_ = nullptr;
+	const char *end_ = nullptr;
+
+	[[noreturn]] void fail(const char *what) const {
+		detail::fail(std::invalid_argument(std::string("JsonLoader: ") + what + " at offset " + std::to_string(p_ - begin_)));
+	}
+
+	void skipSpace() {
+		while(p_ != end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+			++p_;
+		}
+	}
+
+	char peek() {
+		skipSpace();
+		if(p_ == end_) {
+			fail("unexpected end of input");
+		}
+		return *p_;
+	}
+
+	void expect(char c) {
+		if(peek() != c) {
+			fail("unexpected character");
+		}
+		++p_;
+	}
+
+	/// Enter an array or object, failing if that would nest too deeply. Balanced by `--nesting_`.
+	void nest() {
+		if(++nesting_ > max_depth) {
+			fail("nesting too deep");
+		}
+	}
+
+	/// Skip a (possibly empty) run of digits. @return `true` if there was at least one.
+	bool skipDigits() {
+		const char *start = p_;
+		while(p_ != end_ && *p_ >= '0' && *p_ <= '9') {
+			++p_;
+		}
+		return p_ != start;
+	}
+
+	void expectWord(std::string_view word) {
+		if(size_t(end_ - p_) < word.size() || std::string_view(p_, word.size()) != word) {
+			fail("invalid literal");
+		}
+		p_ += word.size();
+	}
+
+	/// Append `cp` to `scratch_` as UTF-8.
+	void appendUtf8(std::uint32_t cp) {
+		if(cp < 0x80) {
+			scratch_.push_back(char(cp));
+		} else if(cp < 0x800) {
+			scratch_.push_back(char(0xC0 | (cp >> 6)));
+			scratch_.push_back(char(0x80 | (cp & 0x3F)));
+		} else if(cp < 0x10000) {
+			scratch_.push_back(char(0xE0 | (cp >> 12)));
+			scratch_.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+			scratch_.push_back(char(0x80 | (cp & 0x3F)));
+		} else {
+			scratch_.push_back(char(0xF0 | (cp >> 18)));
+			scratch_.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+			scratch_.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+			scratch_.push_back(char(0x80 | (cp & 0x3F)));
+		}
+	}
+
+	std::uint32_t parseHex4() {
+		if(end_ - p_ < 4) {
+			fail("truncated escape");
+		}
+		std::uint32_t cp = 0;
+		const auto [ptr, ec] = std::from_chars(p_, p_ + 4, cp, 16);
+		if(ec != std::errc() || ptr != p_ + 4) {
+			fail("invalid escape");
+		}
+		p_ += 4;
+		return cp;
+	}
+
+	/// Parse a string, which is viewed in place unless it contains escapes (in which case it is unescaped into `scratch_`).
+	std::string_view parseString() {
+		expect('"');
+		const char *start = p_;
+		while(p_ != end_ && *p_ != '"' && *p_ != '\\' && static_cast<unsigned char>(*p_) >= 0x20) {
+			++p_;
+		}
+		if(p_ == end_) {
+			fail("unterminated string");
+		} else if(*p_ == '"') {
+			return std::string_view(start, (p_++) - start);
+		}
+		scratch_.assign(start, p_);
+		while(true) {
+			if(p_ == end_) {
+				fail("unterminated string");
+			}
+			const char c = *p_++;
+			if(c == '"') {
+				return scratch_;
+			} else if(static_cast<unsigned char>(c) < 0x20) {
+				--p_;
+				fail("control character in string");
+			} else if(c != '\\') {
+				scratch_.push_back(c);
+				continue;
+			} else if(p_ == end_) {
+				fail("unterminated string");
+			}
+			switch(*p_++) {
+				case '"': scratch_.push_back('"'); break;
+				case '\\': scratch_.push_back('\\'); break;
+				case '/': scratch_.push_back('/'); break;
+				case 'b': scratch_.push_back('\b'); break;
+				case 'f': scratch_.push_back('\f'); break;
+				case 'n': scratch_.push_back('\n'); break;
+				case 'r': scratch_.push_back('\r'); break;
+				case 't': scratch_.push_back('\t'); break;
+				case 'u': {
+					std::uint32_t cp = parseHex4();
+					if(cp >= 0xDC00 && cp < 0xE000) {
+						fail("unpaired surrogate");
+					} else if(cp >= 0xD800 && cp < 0xDC00) {
+						if(end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u') {
+							fail("unpaired surrogate");
+						}
+						p_ += 2;
+						const std::uint32_t low = parseHex4();
+						if(low < 0xDC00 || low >= 0xE000) {
+							fail("invalid surrogate pair");
+						}
+						cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+					}
+					appendUtf8(cp);
+					break;
+				}
+				default: fail("invalid escape");
+			}
+		}
+	}
+
+	/// Parse a number, as a `std::int64_t` if it is an integer which fits, and a `double` otherwise.
+	std::any parseNumber(const detail::KeyTagBase *&tag) {
+		const char *start = p_;
+		// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+		if(p_ != end_ && *p_ == '-') {
+			++p_;
+		}
+		if(p_ != end_ && *p_ == '0') {
+			++p_;
+		} else if(!skipDigits()) {
+			p_ = start;
+			fail("invalid number");
+		}
+		bool integral = true;
+		if(p_ != end_ && *p_ == '.') {
+			++p_;
+			integral = false;
+			if(!skipDigits()) {
+				p_ = start;
+				fail("invalid number");
+			}
+		}
+		if(p_ != end_ && (*p_ == 'e' || *p_ == 'E')) {
+			++p_;
+			integral = false;
+			if(p_ != end_ && (*p_ == '+' || *p_ == '-')) {
+				++p_;
+			}
+			if(!skipDigits()) {
+				p_ = start;
+				fail("invalid number");
+			}
+		}
+		if(p_ != end_ && ((*p_ >= '0' && *p_ <= '9') || *p_ == '.' || *p_ == 'e' || *p_ == 'E' || *p_ == '+' || *p_ == '-')) {
+			// e.g. the second digit of `01`, or a repeated fraction or exponent.
+			p_ = start;
+			fail("invalid number");
+		}
+		if(integral) {
+			std::int64_t i = 0;
+			const auto [ptr, ec] = std::from_chars(start, p_, i);
+			if(ec == std::errc() && ptr == p_) {
+				tag = &KeyTag<std::int64_t>::tag();
+				return std::any{i};
+			}
+		}
+		double d = 0;
+		const auto [ptr, ec] = std::from_chars(start, p_, d);
+		if(ptr != p_ || start == p_ || (ec != std::errc() && ec != std::errc::result_out_of_range)) {
+			p_ = start;
+			fail("invalid number");
+		}
+		tag = &KeyTag<double>::tag();
+		return std::any{d};
+	}
+
+	/// Parse any value, setting `tag` to its type (or `nullptr` for `null`).
+	std::any parseValue(const detail::KeyTagBase *&tag) {
+		switch(peek()) {
+			case '{': {
+				nest();
+				tag = &KeyTag<Map>::tag();
+				std::any value{std::in_place_type<Map>, parseObject()};
+				--nesting_;
+				return value;
+			}
+			case '[': {
+				nest();
+				tag = &KeyTag<array_type>::tag();
+				std::any value{std::in_place_type<array_type>, parseArray()};
+				--nesting_;
+				return value;
+			}
+			case '"':
+				tag = &KeyTag<std::string>::tag();
+				return detail::makeValue<std::string>(alloc_, parseString());
+			case 't':
+				expectWord("true");
+				tag = &KeyTag<bool>::tag();
+				return std::any{true};
+			case 'f':
+				expectWord("false");
+				tag = &KeyTag<bool>::tag();
+				return std::any{false};
+			case 'n':
+				expectWord("null");
+				tag = nullptr;
+				return std::any();
+			default:
+				return parseNumber(tag);
+		}
+	}
+
+	array_type parseArray() {
+		expect('[');
+		array_type a;
+		if(peek() == ']') {
+			++p_;
+			return a;
+		}
+		while(true) {
+			const detail::KeyTagBase *tag = nullptr;
+			a.push_back(parseValue(tag));
+			if(peek() == ',') {
+				++p_;
+			} else {
+				expect(']');
+				return a;
+			}
+		}
+	}
+
+	Map parseObject() {
+		expect('{');
+		if(depth_ == entries_.size()) {
+			entries_.emplace_back();
+		}
+		Members &members = entries_[depth_++];
+		std::vector<Entry> &entries = members.entries;
+		std::vector<size_t> &order = members.order;
+		entries.clear();
+		if(peek() == '}') {
+			++p_;
+		} else {
+			while(true) {
+				const detail::KeyAtom key(parseString());
+				expect(':');
+				const detail::KeyTagBase *tag = nullptr;
+				std::any value = parseValue(tag);
+				if(tag) {
+					entries.emplace_back(std::piecewise_construct, std::forward_as_tuple(key, *tag), std::forward_as_tuple(std::move(value)));
+				}
+				if(peek() == ',') {
+					++p_;
+				} else {
+					expect('}');
+					break;
+				}
+			}
+		}
+		// Sort indices, breaking ties by position, so that the last of any repeated keys is last among its equals (`std::stable_sort` would allocate).
+		order.resize(entries.size());
+		for(size_t i = 0; i < order.size(); ++i) {
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&entries](size_t l, size_t r) {
+			return entries[l].first < entries[r].first || (l < r && entries[l].first == entries[r].first);
+		});
+		auto last = order.begin();
+		for(auto it = order.begin(); it != order.end(); ++it) {
+			if(std::next(it) == order.end() || entries[*it].first != entries[*std::next(it)].first) {
+				*last++ = *it;
+			}
+		}
+		const auto take = [&entries](size_t i) -> Entry&& { return std::move(entries[i]); };
+		Map m(std::allocator_arg, alloc_, Map::sorted_unique,
+		      boost::make_transform_iterator(order.begin(), take), boost::make_transform_iterator(last, take));
+		entries.clear();
+		--depth_;
+		return m;
+	}
+
+  public:
+	explicit BasicJsonLoader(const allocator_type& alloc = allocator_type())
+	: alloc_(alloc) {}
+
+	/// Parse `json`, which must contain exactly one object. @throws std::invalid_argument if it is malformed.
+	Map load(std::string_view json) {
+		begin_ = p_ = json.data();
+		end_ = json.data() + json.size();
+		depth_ = 0;
+		nesting_ = 0;
+		nest();
+		Map m = parseObject();
+		skipSpace();
+		if(p_ != end_) {
+			fail("trailing characters");
+		}
+		return m;
+	}
+
+	/******************************************************
+	 * Parse newline-delimited JSON objects from `in`,
+	 * passing each `Map` to `f` as it is loaded. Blank
+	 * lines are skipped.
+	 * @return The number of records loaded.
+	 * @throws std::invalid_argument if a line is malformed.
+	 ******************************************************/
+	template<typename F>
+	size_t loadLines(std::istream &in, F &&f) {
+		size_t count = 0;
+		while(std::getline(in, line_)) {
+			if(line_.find_first_not_of(" \t\r") == std::string::npos) {
+				continue;
+			}
+			f(load(line_));
+			++count;
+		}
+		return count;
+	}
+};
+
+/// `BasicJsonLoader` building `DynamicHMap`s.
+using JsonLoader = BasicJsonLoader<DynamicHMap>;
@@ -0,0 +1,92 @@
+#pragma once
+/************************************************************************************
+ * @file key-atom.hpp Interned strings ("atoms") for use as the string half of
+ * @ref dynamic-hmap.hpp keys. Two atoms with the same text always share a single
+ * process-lifetime record, so equality is a pointer comparison and copying an atom
+ * never allocates.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace detail {
+	/// The interned representation of a string. One per distinct string, never freed.
+	struct AtomRecord {
+		std::string text; ///< The interned string.
+		std::size_t hash; ///< `std::hash<std::string_view>` of `text`, computed once.
+	};
+
+	/******************************************************
+	 * A handle to an interned string.
+	 *
+	 * Constructing a `KeyAtom` from text looks it up in a
+	 * global, thread-safe intern table (inserting it on
+	 * first use); copying, comparing for equality and
+	 * hashing an existing `KeyAtom` are all O(1).
+	 *
+	 * Ordering is still lexicographic so that ordered
+	 * containers of keys have the same iteration order as
+	 * they would with `std::string`s.
+	 *
+	 * @warning Interned strings live until the process
+	 * exits, so avoid interning unbounded sets of strings
+	 * (e.g. values, rather than field names).
+	 ******************************************************/
+	class KeyAtom {
+		const AtomRecord *rec_; ///< Never null.
+
+		/// Find or insert the record for `s` in the global intern table.
+		static const AtomRecord *intern(std::string_view s);
+
+	  public:
+		explicit KeyAtom(std::string_view s)
+		: rec_(intern(s)) {}
+
+		/// The interned text.
+		const std::string& str() const { return rec_->text; }
+		/// The interned text.
+		std::string_view view() const { return rec_->text; }
+		/// The interned text, nul-terminated.
+		const char* c_str() const { return rec_->text.c_str(); }
+		/// `std::hash<std::string_view>` of the interned text.
+		std::size_t hash() const { return rec_->hash; }
+		/// Convert to the interned text.
+		operator const std::string&() const { return rec_->text; }
+
+		/// Identity comparison: atoms are equal iff they share a record.
+		friend bool operator==(const KeyAtom &a, const KeyAtom &b) { return a.rec_ == b.rec_; }
+		friend bool operator!=(const KeyAtom &a, const KeyAtom &b) { return a.rec_ != b.rec_; }
+		/// Lexicographic comparison, short-circuiting on identity.
+		friend bool operator<(const KeyAtom &a, const KeyAtom &b) {
+			return a.rec_ != b.rec_ && a.rec_->text < b.rec_->text;
+		}
+
+		friend bool operator==(const KeyAtom &a, std::string_view b) { return a.view() == b; }
+		friend bool operator==(std::string_view a, const KeyAtom &b) { return a == b.view(); }
+		friend bool operator!=(const KeyAtom &a, std::string_view b) { return a.view() != b; }
+		friend bool operator!=(std::string_view a, const KeyAtom &b) { return a != b.view(); }
+
+		friend std::ostream& operator<<(std::ostream &os, const KeyAtom &a) {
+			return os << a.rec_->text;
+		}
+	};
+}
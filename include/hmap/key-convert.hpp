@@ -21,11 +21,114 @@
  *
  ************************************************************************************/
 
+#include <any>
+#include <array>
+#include <cstddef>
+#include <utility>
+
 #include <hmap/hmap.hpp>
 #include <hmap/dynamic-hmap.hpp>
 
-/// Convert `detail::KeyType<Value>` (for a static `HMap`) to `detail::Key<Value>` (for a `DynamicHMap`)
+/// View the constexpr character data of a `detail::KeyType`, e.g. for allocation-free `DynamicHMap::find(name, tag)`.
+template<typename Value, char ...Cs>
+constexpr std::string_view staticKeyName(detail::KeyType<Value, Cs...>) {
+	using KT = detail::KeyType<Value, Cs...>;
+	return std::string_view(KT::c_str(), KT::length());
+}
+
+/// Convert `detail::KeyType<Value>` (for a static `HMap`) to `detail::Key<Value>` (for a `DynamicHMap`). Interns the name only once per `KeyType`.
+template<typename Value, char ...Cs>
+const detail::Key<Value>& staticToDynamicKey(detail::KeyType<Value, Cs...>) {
+	static const detail::Key<Value> key = dK<Value>(staticKeyName(detail::KeyType<Value, Cs...>()));
+	return key;
+}
+
+/// Convert `detail::KeyType<Value>` to a `detail::KeyView`, for type-erased lookup without allocation or interning.
 template<typename Value, char ...Cs>
-detail::Key<Value> staticToDynamicKey(detail::KeyType<Value, Cs...>) {
-	return dK<Value>(detail::KeyType<Value, Cs...>::c_str());
+detail::KeyView staticToKeyView(detail::KeyType<Value, Cs...> kt) {
+	return detail::KeyView(staticKeyName(kt), KeyTag<Value>::tag());
+}
+
+namespace detail {
+	struct StaticLookup {
+		template<typename Map, size_t N, typename ...Vs>
+		static auto apply(Map &m, const std::array<size_t, N>& order, const Key<Vs>& ...ks) {
+			return m.lookupInOrder(order, ks...);
+		}
+	};
+}
+
+/*************************************************
+ * Lookup several static keys in a `BasicDynamicHMap`
+ * at once, as for `operator()(multi_tag, ...)`, but
+ * with the order of the sweep over the map computed at
+ * compile-time. Returns a tuple of optional references.
+ * Typical usage:
+ * <pre class="markdeep">
+ * ```c++
+ * auto [foo, baz] = lookupStatic(myDynamicMap, TK("foo",int), TK("baz",std::string));
+ * ```
+ * </pre>
+ *************************************************/
+template<typename Map, typename ...KeyTypes>
+auto lookupStatic(Map &m, KeyTypes...) {
+	return detail::StaticLookup::apply(m, detail::SortKeys<KeyTypes...>::order, staticToDynamicKey(KeyTypes())...);
+}
+
+namespace detail {
+	/// `toDynamic` helper: move the `Is`th least values out of `m`, which are already in `Map`'s order.
+	template<typename Map, typename HMapT, size_t ...Is>
+	Map toDynamicImpl(HMapT &m, const typename Map::allocator_type& alloc, std::index_sequence<Is...>) {
+		using Sorted = HMapAccess::Sorted<HMapT>;
+		return Map(std::allocator_arg, alloc, Map::sorted_unique,
+		           std::array<std::pair<KeyBase, std::any>, sizeof...(Is)>{{
+		               {staticToDynamicKey(typename std::tuple_element_t<Is, Sorted>::ValueKeyType()),
+		                makeValue<typename std::tuple_element_t<Is, Sorted>::Value>(alloc, std::move(HMapAccess::at<Is>(m).v))}...
+		           }});
+	}
+
+	/// `fromDynamic` helper.
+	template<typename HMapT>
+	struct FromDynamic;
+
+	template<typename ...KeyTypes>
+	struct FromDynamic<HMap<KeyTypes...> > {
+		template<typename Map>
+		static HMap<KeyTypes...> apply(Map &m) {
+			return HMap<KeyTypes...>(typename KeyTypes::ValueType(std::move(m.at(staticToDynamicKey(KeyTypes()))))...);
+		}
+	};
+}
+
+/*************************************************
+ * Move the contents of a static `HMap` into a new
+ * `BasicDynamicHMap` (by default, a `DynamicHMap`).
+ * Since the `HMap` is already sorted, this is a
+ * hinted O(N) load, and since the keys are cached
+ * per-`KeyType` it never touches the intern table.
+ * @arg alloc Allocator for the new map's nodes
+ * (and allocator-aware values).
+ *************************************************/
+template<typename Map = DynamicHMap, typename ...KeyTypes>
+Map toDynamic(HMap<KeyTypes...>&& m, const typename Map::allocator_type& alloc = typename Map::allocator_type()) {
+	return detail::toDynamicImpl<Map>(m, alloc, std::index_sequence_for<KeyTypes...>());
+}
+
+/*************************************************
+ * Project a `BasicDynamicHMap` onto the schema of
+ * a static `HMapT`, moving out the value of each of
+ * its keys. Other keys are ignored, and those moved
+ * from remain in `m`, in a moved-from state.
+ * Typical usage:
+ * <pre class="markdeep">
+ * ```c++
+ * using Schema = decltype(make_hmap((TK("foo",int), 1), (TK("baz",std::string), "")));
+ * auto myMap = fromDynamic<Schema>(std::move(myDynamicMap));
+ * ```
+ * </pre>
+ * @throws std::out_of_range if any key is missing.
+ *************************************************/
+template<typename HMapT, typename Backend>
+HMapT fromDynamic(BasicDynamicHMap<Backend>&& m) {
+	return detail::FromDynamic<HMapT>::apply(m);
 }
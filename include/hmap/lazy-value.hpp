@@ -0,0 +1,111 @@
+#pragma once
+/************************************************************************************
+ * @file lazy-value.hpp Values computed on first use, for storing expensive derived
+ * attributes in @ref dynamic-hmap.hpp maps without computing them up front.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/**********************************************************
+ * A `V` computed by a thunk the first time it is read,
+ * exactly once even if many threads read it at the same
+ * time (cf. `std::call_once`). If the thunk throws, the
+ * next read tries again.
+ *
+ * Stored in dynamic maps like any other value, under a
+ * `detail::Key<Lazy<V> >`, and read through `at` or
+ * `operator()` by way of `get()`, or the conversion to
+ * `const V&`:
+ * <pre class="markdeep">
+ * ```c++
+ * static const auto kBounds = dK<Lazy<Box> >("bounds");
+ * m.try_emplace(kBounds, [&geometry] { return boundsOf(geometry); });
+ * const Box& bounds = m.at(kBounds); // Computed here, and only here.
+ * ```
+ * </pre>
+ *
+ * @note Copies share the thunk and its result, so copying
+ * a map never recomputes (or computes) its lazy values.
+ **********************************************************/
+template<typename V>
+class Lazy {
+	struct State {
+		std::once_flag once; ///< Guards `thunk` and `value`.
+		std::atomic<bool> computed{false}; ///< Set once `value` is ready, for `ready()`.
+		std::function<V()> thunk; ///< Released once it has run.
+		std::optional<V> value;
+	};
+	std::shared_ptr<State> state_;
+
+  public:
+	using value_type = V;
+
+	/// Computes `V()` on first use, so that `Lazy` values can be default-constructed by `operator[]`.
+	Lazy() : Lazy([] { return V(); }) {}
+	/// Shares `l`'s state. There are no move operations, which would leave `l` without any: copies are just as cheap.
+	Lazy(const Lazy &l) = default;
+	Lazy& operator=(const Lazy &l) = default;
+
+	/// Computes `thunk()` on first use.
+	template<typename F, std::enable_if_t<!std::is_same_v<std::decay_t<F>, Lazy> && std::is_invocable_r_v<V, F&>, bool> = true>
+	Lazy(F&& thunk)
+	: state_(std::make_shared<State>()) {
+		state_->thunk = std::forward<F>(thunk);
+	}
+
+	/// Already computed: holds `V(args...)`.
+	template<typename ...Args>
+	explicit Lazy(std::in_place_t, Args&& ...args)
+	: state_(std::make_shared<State>()) {
+		std::call_once(state_->once, [&] {
+			state_->value.emplace(std::forward<Args>(args)...);
+			state_->computed.store(true, std::memory_order_release);
+		});
+	}
+
+	/// The value, computing it first if no read has yet.
+	const V& get() const {
+		if(!ready()) {
+			State &s = *state_;
+			std::call_once(s.once, [&s] {
+				s.value.emplace(s.thunk());
+				s.thunk = nullptr;
+				s.computed.store(true, std::memory_order_release);
+			});
+		}
+		return *state_->value;
+	}
+
+	/// As for `get()`.
+	operator const V&() const {
+		return get();
+	}
+
+	/// `true` once the value has been computed.
+	bool ready() const {
+		return state_->computed.load(std::memory_order_acquire);
+	}
+};
@@ -0,0 +1,91 @@
+#pragma once
+/************************************************************************************
+ * @file lookup-result.hpp Non-throwing lookup results, and support for building
+ * without exceptions (`HMAP_NO_EXCEPTIONS`).
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
+
+#include <boost/optional/optional.hpp>
+
+#if !defined(HMAP_NO_EXCEPTIONS) && !defined(__cpp_exceptions)
+/// Defined when building without exceptions (or by the `HMAP_NO_EXCEPTIONS` CMake option): errors which would throw abort instead.
+#define HMAP_NO_EXCEPTIONS
+#endif
+
+namespace detail {
+	/// `throw e`, or print `e.what()` and abort if built with `HMAP_NO_EXCEPTIONS`.
+	template<typename E>
+	[[noreturn]] void fail(const E& e) {
+#ifdef HMAP_NO_EXCEPTIONS
+		std::fputs(e.what(), stderr);
+		std::fputc('\n', stderr);
+		std::abort();
+#else
+		throw e;
+#endif
+	}
+}
+
+/// Why a lookup failed.
+enum class LookupError {
+	KeyNotFound, ///< No entry has the key.
+	TypeMismatch ///< The key names a different type than was asked for.
+};
+
+/****************************************************
+ * The result of a lookup which reports failure by
+ * value, rather than by throwing: either a `T`
+ * (which may be a reference), or a `LookupError`.
+ * Modelled on `std::expected<T, LookupError>`.
+ ****************************************************/
+template<typename T>
+class LookupResult {
+	boost::optional<T> value_;
+	LookupError error_ = LookupError::KeyNotFound;
+
+  public:
+	LookupResult(T value)
+	: value_(std::forward<T>(value)) {}
+	LookupResult(LookupError error)
+	: error_(error) {}
+
+	bool has_value() const { return bool(value_); } ///< `true` if the lookup succeeded.
+	explicit operator bool() const { return has_value(); } ///< As for `has_value()`.
+	/// @pre `has_value()`
+	decltype(auto) operator*() const { return *value_; }
+	/// @pre `has_value()`
+	decltype(auto) operator*() { return *value_; }
+	/// @pre `has_value()`
+	auto operator->() const { return value_.get_ptr(); }
+	/// @pre `has_value()`
+	auto operator->() { return value_.get_ptr(); }
+	/// @pre `!has_value()`. @return Why the lookup failed.
+	LookupError error() const { return error_; }
+	/// @return A copy of the value if present, or `fallback` converted to the value type otherwise. Returned by value, so that a temporary `fallback` can't leave a dangling reference.
+	template<typename U>
+	std::remove_cv_t<std::remove_reference_t<T> > value_or(U &&fallback) const {
+		using Value = std::remove_cv_t<std::remove_reference_t<T> >;
+		return value_ ? Value(*value_) : Value(std::forward<U>(fallback));
+	}
+};
@@ -0,0 +1,380 @@
+#pragma once
+/************************************************************************************
+ * @file mapped-dynamic-hmap.hpp A compact binary record format for the maps of
+ * @ref dynamic-hmap.hpp, and a read-only view serving lookups straight from a
+ * (memory-mapped) buffer of such records.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <any>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/iterator/transform_iterator.hpp>
+#include <boost/optional/optional.hpp>
+
+#include <hmap/dynamic-hmap.hpp>
+
+namespace detail {
+	/// How to (de)serialize values of one type, as registered with `TypeRegistry`.
+	struct TypeCodec {
+		std::uint32_t id; ///< Stable (cross-process) identifier, written to records in place of the type tag's address.
+		const KeyTagBase *tag; ///< The type's `KeyTag`.
+		std::size_t size; ///< `sizeof` a value which can be read in place from a record, or 0 if it must be decoded.
+		std::size_t align; ///< Alignment of encoded values within a record.
+		std::function<void(const std::any&, std::string&)> encode; ///< Append the bytes of a value.
+		std::function<std::any(std::string_view)> decode; ///< Rebuild a value from the bytes written by `encode`.
+
+		/// `true` if values are stored as their object representation, and can be used without decoding.
+		bool inPlace() const { return size != 0; }
+	};
+
+	constexpr std::size_t kMappedAlign = 16; ///< Alignment of each record, and the most any in-place value may need.
+
+	/// Codec for a trivially copyable `V`, storing its object representation.
+	template<typename V>
+	TypeCodec inPlaceCodec(std::uint32_t id) {
+		static_assert(std::is_trivially_copyable_v<V>, "Types which aren't trivially copyable need an explicit codec");
+		static_assert(alignof(V) <= kMappedAlign, "Over-aligned types can't be read in place");
+		return TypeCodec{id, &KeyTag<V>::tag(), sizeof(V), alignof(V),
+		    [](const std::any& a, std::string& out) {
+		        out.append(reinterpret_cast<const char*>(&std::any_cast<const V&>(a)), sizeof(V));
+		    },
+		    [](std::string_view bytes) {
+		        alignas(V) unsigned char buf[sizeof(V)];
+		        std::memcpy(buf, bytes.data(), sizeof(V));
+		        return std::any{*std::launder(reinterpret_cast<const V*>(buf))};
+		    }};
+	}
+}
+
+/******************************************************
+ * A process-wide registry assigning each value type a
+ * stable id and a codec, so that maps may be written
+ * to (and read back from) the binary record format of
+ * `serialize` and `MappedDynamicHMapView`.
+ *
+ * Trivially copyable types are stored as their object
+ * representation (in native byte order), and so can
+ * be read in place. Other types need an explicit
+ * codec. `bool`, `char`, the fixed-width integers,
+ * `float`, `double` and `std::string` are
+ * pre-registered, with ids below `kFirstUserId`.
+ *
+ * Registration is thread-safe, and codecs are never
+ * unregistered.
+ ******************************************************/
+class TypeRegistry {
+	/// Insert `codec`, unless its type or id is already registered. @throws std::invalid_argument on a conflicting registration.
+	static const detail::TypeCodec& insert(detail::TypeCodec &&codec);
+
+  public:
+	static constexpr std::uint32_t kFirstUserId = 256; ///< Ids below this are reserved for the pre-registered types.
+
+	/// Register a trivially copyable `V`, to be stored (and read) in place.
+	template<typename V>
+	static const detail::TypeCodec& add(std::uint32_t id) {
+		return insert(detail::inPlaceCodec<V>(id));
+	}
+
+	/// Register `V` with an explicit codec. Values must be decoded (e.g. with `MappedDynamicHMapView::get`) to be read.
+	template<typename V>
+	static const detail::TypeCodec& add(std::uint32_t id,
+	                                    std::function<void(const V&, std::string&)> encode,
+	                                    std::function<V(std::string_view)> decode) {
+		return insert(detail::TypeCodec{id, &KeyTag<V>::tag(), 0, 1,
+		    [encode = std::move(encode)](const std::any& a, std::string& out) {
+		        encode(std::any_cast<const V&>(a), out);
+		    },
+		    [decode = std::move(decode)](std::string_view bytes) {
+		        return std::any{std::in_place_type<V>, decode(bytes)};
+		    }});
+	}
+
+	/// @return The codec registered for `tag`'s type, or `nullptr`.
+	static const detail::TypeCodec* find(const detail::KeyTagBase &tag);
+	/// @return The codec registered with `id`, or `nullptr`.
+	static const detail::TypeCodec* find(std::uint32_t id);
+
+	/// As for `find(KeyTag<V>::tag())`, but only takes the registry's lock until `V` is registered.
+	template<typename V>
+	static const detail::TypeCodec* find() {
+		static std::atomic<const detail::TypeCodec*> cached{nullptr};
+		const detail::TypeCodec *codec = cached.load(std::memory_order_acquire);
+		if(!codec) {
+			codec = find(KeyTag<V>::tag());
+			cached.store(codec, std::memory_order_release);
+		}
+		return codec;
+	}
+};
+
+namespace detail {
+	/*****************************************************************************
+	 * @defgroup MappedFormat The binary record format.
+	 *
+	 * A record is a `MappedHeader`, then `count` `MappedDirEntry`s sorted by
+	 * (name, type id), then the key names, then the values, each aligned as
+	 * its codec requires. Offsets are relative to the start of the record,
+	 * which is aligned to `kMappedAlign`, as is its size, so that
+	 * records may simply be concatenated. Everything is in native byte order.
+	 * @{
+	 **/
+	constexpr std::uint32_t kMappedMagic = 0x50414d48u; ///< "HMAP" when written little-endian.
+	constexpr std::uint16_t kMappedVersion = 1;
+
+	struct MappedHeader {
+		std::uint32_t magic; ///< `kMappedMagic`, which also detects a foreign byte order.
+		std::uint16_t version; ///< `kMappedVersion`
+		std::uint16_t reserved;
+		std::uint32_t count; ///< Number of directory entries.
+		std::uint32_t reserved2;
+		std::uint64_t size; ///< Size of the whole record, including padding.
+	};
+
+	struct MappedDirEntry {
+		std::uint64_t valueOffset;
+		std::uint64_t valueSize;
+		std::uint32_t nameOffset;
+		std::uint32_t nameSize;
+		std::uint32_t typeId; ///< `TypeCodec::id`
+		std::uint32_t reserved;
+	};
+	static_assert(sizeof(MappedHeader) == 24 && sizeof(MappedDirEntry) == 32, "Unexpected padding in record format");
+	/**
+	 * @}
+	 ****************************************************************************/
+
+	/// Append a record of `entries` to `out`, after padding `out` to a multiple of `kMappedAlign`.
+	void appendRecord(std::vector<std::pair<const KeyBase*, const std::any*> > &entries, std::string &out);
+}
+
+/*************************************************
+ * Append `m` to `out` as one binary record.
+ * `Map` may be any of the dynamic maps, or anything
+ * else iterating over `std::pair<const KeyBase, std::any>`.
+ * @throws std::invalid_argument if a value's type has
+ * not been registered with `TypeRegistry`.
+ *************************************************/
+template<typename Map>
+void serialize(const Map &m, std::string &out) {
+	std::vector<std::pair<const detail::KeyBase*, const std::any*> > entries;
+	for(auto it = m.cbegin(); it != m.cend(); ++it) {
+		entries.emplace_back(&it->first, &it->second);
+	}
+	detail::appendRecord(entries, out);
+}
+
+/******************************************************
+ * A read-only `DynamicHMap` view of one binary record
+ * (cf. `serialize`), typically inside a `MappedFile`.
+ *
+ * Construction only checks the record's header, and
+ * lookups binary search its directory, so viewing a
+ * record costs nothing in proportion to its contents.
+ * Values of in-place types are returned by reference
+ * into the buffer; others are decoded by `get`, or
+ * may be inspected as raw bytes through `find`.
+ *
+ * Walk a buffer of concatenated records like so:
+ * <pre class="markdeep">
+ * ```c++
+ * MappedFile file("records.bin");
+ * for(size_t offset = 0; offset < file.size(); ) {
+ *     MappedDynamicHMapView record(file.data() + offset, file.size() - offset);
+ *     offset += record.record_size();
+ * }
+ * ```
+ * </pre>
+ *
+ * @warning Must not outlive the buffer it views.
+ ******************************************************/
+class MappedDynamicHMapView : public detail::DynamicHMapBase {
+  public:
+	/// A key-value pair, with the value still encoded.
+	struct value_type {
+		std::string_view key; ///< The key's name.
+		std::uint32_t type_id; ///< The `detail::TypeCodec::id` of the value's type.
+		std::string_view bytes; ///< The encoded value.
+	};
+
+  private:
+	/// Functor for use with boost::transform_iterator
+	struct EntryReader {
+		const char *base = nullptr;
+		std::size_t size = 0;
+		value_type operator()(const detail::MappedDirEntry &e) const;
+	};
+
+  public:
+	using const_iterator = boost::transform_iterator<EntryReader, const detail::MappedDirEntry*>; ///< const iterator over contents, in (name, type id) order.
+
+  private:
+	EntryReader reader_;
+	const detail::MappedHeader *header_;
+	const detail::MappedDirEntry *dir_;
+
+	const_iterator lookup(std::string_view k, const detail::TypeCodec *codec) const;
+
+	/// The in-place value at `it`, or `nullptr` if `it` is `cend()`.
+	template<typename V>
+	static const V* inPlace(const const_iterator &it, const_iterator end, const detail::TypeCodec &codec) {
+		if(end == it) {
+			return nullptr;
+		}
+		if(!codec.inPlace()) {
+			detail::fail(std::invalid_argument("MappedDynamicHMapView: values of this type must be decoded with get()"));
+		}
+		const std::string_view bytes = (*it).bytes;
+		if(bytes.size() != sizeof(V)) {
+			detail::fail(std::invalid_argument("MappedDynamicHMapView: value has the wrong size for its type"));
+		} else if(reinterpret_cast<std::uintptr_t>(bytes.data()) % codec.align) {
+			detail::fail(std::invalid_argument("MappedDynamicHMapView: value is misaligned for its type"));
+		}
+		return reinterpret_cast<const V*>(bytes.data());
+	}
+
+  public:
+	/// View the record at the start of `data`, which must be aligned to `detail::kMappedAlign`. @throws std::invalid_argument if it is malformed or truncated.
+	MappedDynamicHMapView(const void *data, std::size_t size);
+
+	/// Return an iterator to the located key-value pair, or to `cend()` if none exists. Never allocates.
+	const_iterator find(const detail::KeyView &kv) const {
+		return lookup(kv.key, TypeRegistry::find(kv.tag.get()));
+	}
+	/// Return an iterator to the located key-value pair, or to `cend()` if none exists.
+	const_iterator find(const detail::KeyBase &kb) const {
+		return lookup(kb.key.view(), TypeRegistry::find(kb.tag.get()));
+	}
+	/// Return an iterator to the key-value pair located by `(k, tag)`, or to `cend()` if none exists. Never allocates.
+	template<typename V>
+	const_iterator find(std::string_view k, const KeyTag<V>&) const {
+		return lookup(k, TypeRegistry::find<V>());
+	}
+
+	/// Find the in-place `V` mapped by `k`, if present, as a reference into the viewed buffer.
+	template<typename V>
+	boost::optional<const V&> operator()(const detail::Key<V>& k) const {
+		return (*this)(k.key.view(), KeyTag<V>::tag());
+	}
+
+	/// Find the in-place `V` mapped by `(k, tag)`, if present, without building a `detail::Key`.
+	template<typename V>
+	boost::optional<const V&> operator()(std::string_view k, const KeyTag<V>&) const {
+		static_assert(std::is_trivially_copyable_v<V>, "Only trivially copyable values can be read in place: use get()");
+		const detail::TypeCodec *codec = TypeRegistry::find<V>();
+		if(!codec) {
+			return boost::none;
+		}
+		const V *found = inPlace<V>(lookup(k, codec), cend(), *codec);
+		return found ? boost::optional<const V&>(*found) : boost::none;
+	}
+
+	/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of optional references.
+	template <typename... Vs>
+	auto operator()(multi_tag, const detail::Key<Vs>& ...ks) const {
+		return std::make_tuple((*this)(ks)...);
+	}
+
+	/// Find the in-place `V` mapped by `k`, and return a reference to it.
+	template<typename V>
+	const V& at(const detail::Key<V>& k) const {
+		const auto found = (*this)(k);
+		if(!found) {
+			keyNotFound(k);
+		}
+		return *found;
+	}
+
+	/// Decode a copy of the `V` mapped by `k`, if present. Works for any registered `V`.
+	template<typename V>
+	boost::optional<V> get(const detail::Key<V>& k) const {
+		const detail::TypeCodec *codec = TypeRegistry::find<V>();
+		const auto it = codec ? lookup(k.key.view(), codec) : cend();
+		if(cend() == it) {
+			return boost::none;
+		}
+		return std::any_cast<V>(codec->decode((*it).bytes));
+	}
+
+	/// Decode the contents into a new mutable map (by default, a `DynamicHMap`). @throws std::invalid_argument if a type id is not registered.
+	template<typename Map = DynamicHMap>
+	Map toMutable() const {
+		Map m;
+		for(auto it = cbegin(); it != cend(); ++it) {
+			const value_type entry = *it;
+			const detail::TypeCodec *codec = TypeRegistry::find(entry.type_id);
+			if(!codec) {
+				detail::fail(std::invalid_argument("MappedDynamicHMapView: unregistered type id"));
+			}
+			m.unsafe_insert_or_assign(detail::KeyBase(entry.key, *codec->tag), codec->decode(entry.bytes));
+		}
+		return m;
+	}
+
+	const_iterator cbegin() const { return const_iterator(dir_, reader_); }
+	const_iterator cend() const { return const_iterator(dir_ + header_->count, reader_); }
+
+	size_t size() const { return header_->count; } ///< Number of entries
+	bool empty() const { return header_->count == 0; } ///< `true` if `size() == 0`, `false` otherwise.
+	/// Bytes occupied by this record, including padding, i.e. the offset of the next record in the buffer.
+	size_t record_size() const { return header_->size; }
+};
+
+/******************************************************
+ * A read-only file mapped into memory (with `mmap` on
+ * POSIX systems, or read into a buffer elsewhere),
+ * e.g. for viewing with `MappedDynamicHMapView`.
+ ******************************************************/
+class MappedFile {
+	const char *data_ = nullptr;
+	std::size_t size_ = 0;
+
+	void release();
+
+  public:
+	/// @throws std::system_error if `path` can't be opened or mapped.
+	explicit MappedFile(const std::string &path);
+	MappedFile(MappedFile &&m)
+	: data_(std::exchange(m.data_, nullptr)), size_(std::exchange(m.size_, 0)) {}
+	MappedFile& operator=(MappedFile &&m) {
+		if(this != &m) {
+			release();
+			data_ = std::exchange(m.data_, nullptr);
+			size_ = std::exchange(m.size_, 0);
+		}
+		return *this;
+	}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { release(); }
+
+	const char* data() const { return data_; } ///< Page-aligned contents of the file (`nullptr` if it is empty).
+	std::size_t size() const { return size_; } ///< Size of the file
+};
@@ -0,0 +1,307 @@
+#pragma once
+/************************************************************************************
+ * @file persistent-dynamic-hmap.hpp An immutable, structurally-shared counterpart
+ * to @ref dynamic-hmap.hpp, for cheaply deriving many maps from a common base.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <any>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/optional/optional.hpp>
+
+#include <hmap/dynamic-hmap.hpp>
+
+/******************************************************
+ * A persistent (immutable) `DynamicHMap`, backed by an
+ * AVL tree with path copying.
+ *
+ * Copying (or calling `snapshot()`) is O(1), and
+ * `with`/`without` return a new map in O(log N) time,
+ * sharing every node (and every value) not on the path
+ * to the modified key with the original.
+ *
+ * Iterates in the same order as `DynamicHMap`.
+ ******************************************************/
+class PersistentDynamicHMap : public detail::DynamicHMapBase {
+  public:
+	using value_type = std::pair<const detail::KeyBase, std::any>; ///< Type-unsafe key-value pairs
+
+  private:
+	struct Node;
+	using NodePtr = std::shared_ptr<const Node>;
+	using EntryPtr = std::shared_ptr<const value_type>;
+
+	/// Entries are held by pointer, so that rebalancing a copied path never copies values.
+	struct Node {
+		EntryPtr entry;
+		NodePtr left;
+		NodePtr right;
+		int height;
+
+		Node(EntryPtr e, NodePtr l, NodePtr r)
+		: entry(std::move(e)), left(std::move(l)), right(std::move(r)),
+		  height(1 + std::max(heightOf(left), heightOf(right))) {}
+	};
+
+	NodePtr root_; ///< Shared with every map derived from this one.
+	size_t size_ = 0; ///< Number of entries
+
+	PersistentDynamicHMap(NodePtr root, size_t size)
+	: root_(std::move(root)), size_(size) {}
+
+	static int heightOf(const NodePtr& n) {
+		return n ? n->height : 0;
+	}
+
+	static NodePtr make(EntryPtr e, NodePtr l, NodePtr r) {
+		return std::make_shared<const Node>(std::move(e), std::move(l), std::move(r));
+	}
+
+	/// Build a node from `e`, `l` and `r`, whose heights differ by at most 2, restoring the AVL invariant.
+	static NodePtr balance(EntryPtr e, NodePtr l, NodePtr r) {
+		const int diff = heightOf(l) - heightOf(r);
+		if(diff > 1) {
+			if(heightOf(l->left) >= heightOf(l->right)) {
+				return make(l->entry, l->left, make(std::move(e), l->right, std::move(r)));
+			} else {
+				return make(l->right->entry,
+				            make(l->entry, l->left, l->right->left),
+				            make(std::move(e), l->right->right, std::move(r)));
+			}
+		} else if(diff < -1) {
+			if(heightOf(r->right) >= heightOf(r->left)) {
+				return make(r->entry, make(std::move(e), std::move(l), r->left), r->right);
+			} else {
+				return make(r->left->entry,
+				            make(std::move(e), std::move(l), r->left->left),
+				            make(r->entry, r->left->right, r->right));
+			}
+		}
+		return make(std::move(e), std::move(l), std::move(r));
+	}
+
+	/// Path-copying insert (or replace), setting `inserted` if the key was not already present.
+	static NodePtr insert(const NodePtr& n, EntryPtr e, bool& inserted) {
+		if(!n) {
+			inserted = true;
+			return make(std::move(e), nullptr, nullptr);
+		}
+		if(e->first < n->entry->first) {
+			return balance(n->entry, insert(n->left, std::move(e), inserted), n->right);
+		} else if(n->entry->first < e->first) {
+			return balance(n->entry, n->left, insert(n->right, std::move(e), inserted));
+		}
+		return make(std::move(e), n->left, n->right);
+	}
+
+	/// Path-copying removal of the least entry in `n`, which is returned through `min`.
+	static NodePtr removeMin(const NodePtr& n, EntryPtr& min) {
+		if(!n->left) {
+			min = n->entry;
+			return n->right;
+		}
+		return balance(n->entry, removeMin(n->left, min), n->right);
+	}
+
+	/// Path-copying removal, setting `removed` if the key was present. Returns `n` itself if not.
+	template<typename K>
+	static NodePtr remove(const NodePtr& n, const K& k, bool& removed) {
+		if(!n) {
+			return n;
+		}
+		const detail::KeyBaseLess less;
+		if(less(k, n->entry->first)) {
+			NodePtr l = remove(n->left, k, removed);
+			return removed ? balance(n->entry, std::move(l), n->right) : n;
+		} else if(less(n->entry->first, k)) {
+			NodePtr r = remove(n->right, k, removed);
+			return removed ? balance(n->entry, n->left, std::move(r)) : n;
+		}
+		removed = true;
+		if(!n->right) {
+			return n->left;
+		}
+		EntryPtr successor;
+		NodePtr r = removeMin(n->right, successor);
+		return balance(std::move(successor), n->left, std::move(r));
+	}
+
+	/// Build a perfectly balanced tree from sorted entries in O(N).
+	static NodePtr build(std::vector<EntryPtr>& sorted, size_t lo, size_t hi) {
+		if(lo == hi) {
+			return nullptr;
+		}
+		const size_t mid = lo + (hi - lo) / 2;
+		return make(std::move(sorted[mid]), build(sorted, lo, mid), build(sorted, mid + 1, hi));
+	}
+
+	template<typename K>
+	const value_type* lookup(const K& k) const {
+		const detail::KeyBaseLess less;
+		const Node* n = root_.get();
+		while(n) {
+			if(less(k, n->entry->first)) {
+				n = n->left.get();
+			} else if(less(n->entry->first, k)) {
+				n = n->right.get();
+			} else {
+				return n->entry.get();
+			}
+		}
+		return nullptr;
+	}
+
+  public:
+	/// In-order iterator over (immutable) key-value pairs.
+	class const_iterator {
+		friend class PersistentDynamicHMap;
+		std::vector<const Node*> path_; ///< Ancestors still to be visited, current node last.
+
+		explicit const_iterator(const Node* root) {
+			descend(root);
+		}
+		void descend(const Node* n) {
+			for(; n; n = n->left.get()) {
+				path_.push_back(n);
+			}
+		}
+	  public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = PersistentDynamicHMap::value_type;
+		using difference_type = std::ptrdiff_t;
+		using reference = const value_type&;
+		using pointer = const value_type*;
+
+		const_iterator() = default;
+		reference operator*() const { return *path_.back()->entry; }
+		pointer operator->() const { return path_.back()->entry.get(); }
+		const_iterator& operator++() {
+			const Node* n = path_.back();
+			path_.pop_back();
+			descend(n->right.get());
+			return *this;
+		}
+		const_iterator operator++(int) {
+			const_iterator old = *this;
+			++*this;
+			return old;
+		}
+		friend bool operator==(const const_iterator& a, const const_iterator& b) {
+			return a.path_.empty() ? b.path_.empty() : (!b.path_.empty() && a.path_.back() == b.path_.back());
+		}
+		friend bool operator!=(const const_iterator& a, const const_iterator& b) { return !(a == b); }
+	};
+
+	PersistentDynamicHMap() = default;
+
+	/// Copy the contents of a mutable map, sharing nothing with it. O(N) for ordered backends.
+	template<typename Backend>
+	explicit PersistentDynamicHMap(const BasicDynamicHMap<Backend>& m) {
+		std::vector<EntryPtr> sorted;
+		sorted.reserve(m.size());
+		for(auto it = m.cbegin(); it != m.cend(); ++it) {
+			sorted.push_back(std::make_shared<const value_type>(*it));
+		}
+		if(!std::is_sorted(sorted.begin(), sorted.end(), [](const EntryPtr& l, const EntryPtr& r) { return l->first < r->first; })) {
+			std::sort(sorted.begin(), sorted.end(), [](const EntryPtr& l, const EntryPtr& r) { return l->first < r->first; });
+		}
+		size_ = sorted.size();
+		root_ = build(sorted, 0, sorted.size());
+	}
+
+	/// Copy the contents into a new mutable map (by default, a `DynamicHMap`), in O(N) time, since they are already in order.
+	template<typename Map = DynamicHMap>
+	Map toMutable() const {
+		return Map(Map::sorted_unique, cbegin(), cend());
+	}
+
+	/// O(1). Equivalent to copying.
+	PersistentDynamicHMap snapshot() const {
+		return *this;
+	}
+
+	/// A new map, with `k` mapped to a `V` constructed from `args`, sharing all other entries with this one.
+	template<typename V, typename ...Args>
+	PersistentDynamicHMap with(const detail::Key<V>& k, Args&& ...args) const {
+		bool inserted = false;
+		NodePtr root = insert(root_, std::make_shared<const value_type>(
+		                                 k, detail::makeValue<V>(std::allocator<V>(), std::forward<Args>(args)...)),
+		                      inserted);
+		return PersistentDynamicHMap(std::move(root), size_ + (inserted ? 1 : 0));
+	}
+
+	/// A new map without `kb`, sharing all other entries with this one.
+	PersistentDynamicHMap without(const detail::KeyBase& kb) const {
+		bool removed = false;
+		NodePtr root = remove(root_, kb, removed);
+		return PersistentDynamicHMap(std::move(root), size_ - (removed ? 1 : 0));
+	}
+
+	/// Find the `V` mapped by `k`, if present.
+	template<typename V>
+	boost::optional<const V&> operator()(const detail::Key<V>& k) const {
+		const value_type* found = lookup(k);
+		return found ? boost::optional<const V&>(std::any_cast<const V&>(found->second)) : boost::none;
+	}
+
+	/// Find the `V` mapped by `(k, tag)`, if present, without building a `detail::Key`.
+	template<typename V>
+	boost::optional<const V&> operator()(std::string_view k, const KeyTag<V>& tag) const {
+		const value_type* found = lookup(detail::KeyView(k, tag));
+		return found ? boost::optional<const V&>(std::any_cast<const V&>(found->second)) : boost::none;
+	}
+
+	/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of optional references.
+	template <typename... Vs>
+	auto operator()(multi_tag, const detail::Key<Vs>& ...ks) const {
+		return std::make_tuple((*this)(ks)...);
+	}
+
+	/// Find a matching key value pair and return a reference to the value
+	template<typename V>
+	const V& at(const detail::Key<V>& k) const {
+		const value_type* found = lookup(k);
+		if(!found) {
+			keyNotFound(k);
+		}
+		return std::any_cast<const V&>(found->second);
+	}
+	/// Find a matching key value pair and return a `const` reference to the type-erased value.
+	const std::any& at(const detail::KeyBase& kb) const {
+		const value_type* found = lookup(kb);
+		if(!found) {
+			keyNotFound(kb);
+		}
+		return found->second;
+	}
+
+	const_iterator cbegin() const { return const_iterator(root_.get()); }
+	const_iterator cend() const { return const_iterator(); }
+
+	size_t size() const { return size_; } ///< Number of entries
+	bool empty() const { return size_ == 0; } ///< `true` if `size() == 0`, `false` otherwise.
+};
@@ -0,0 +1,315 @@
+#pragma once
+/************************************************************************************
+ * @file shaped-dynamic-hmap.hpp A counterpart to @ref dynamic-hmap.hpp for small
+ * maps, whose key sets are interned and shared as "shapes" (cf. hidden classes).
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <any>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/iterator/counting_iterator.hpp>
+#include <boost/iterator/transform_iterator.hpp>
+#include <boost/optional/optional.hpp>
+
+#include <hmap/dynamic-hmap.hpp>
+
+namespace detail {
+	/******************************************************
+	 * An interned, immutable, sorted set of keys, shared by
+	 * every `ShapedDynamicHMap` holding exactly those keys.
+	 * One per distinct key set, never freed.
+	 *
+	 * Each shape caches its transitions, i.e. the shapes
+	 * reached by adding or removing one key, so that maps
+	 * which are repeatedly rebuilt with the same keys find
+	 * their next shape without consulting the (global,
+	 * thread-safe) shape table.
+	 *
+	 * @warning As with `KeyAtom`, avoid building unbounded
+	 * numbers of distinct key sets.
+	 ******************************************************/
+	class Shape {
+		/// A cached edge to the shape with `key` added (if `add`) or removed. Immutable once published.
+		struct Transition {
+			const KeyBase *key; ///< Points into the keys of whichever shape has `key`, which is never freed.
+			bool add;
+			const Shape *to;
+			std::size_t index; ///< Index of `key` in whichever shape has it.
+			const Transition *next; ///< The transition cached before this one.
+		};
+
+		std::vector<KeyBase> keys_; ///< Sorted by `KeyBase::operator<`.
+		mutable std::atomic<const Transition*> transitions_{nullptr}; ///< Newest first. Read without locking: shapes of small maps have few neighbours.
+		mutable std::mutex mutex_; ///< Serializes caching new transitions.
+		mutable std::vector<std::unique_ptr<Transition> > owned_; ///< Every transition in `transitions_`. Guarded by `mutex_`.
+
+		/// Find or insert the shape for `keys`, which must be sorted and distinct, in the global shape table.
+		static const Shape& intern(std::vector<KeyBase> &&keys);
+		/// Find or insert, and cache, the shape reached by adding `k` (if `add`), or removing `keys()[index]`.
+		std::pair<const Shape*, std::size_t> follow(const KeyBase &k, bool add, std::size_t index) const;
+
+	  public:
+		explicit Shape(std::vector<KeyBase> &&keys)
+		: keys_(std::move(keys)) {}
+		Shape(const Shape&) = delete;
+		Shape& operator=(const Shape&) = delete;
+
+		/// The shape with no keys.
+		static const Shape& empty();
+		/// The shape for `keys`, in any order. @throws std::invalid_argument if a key repeats.
+		static const Shape& of(std::vector<KeyBase> keys);
+
+		/// The keys, in ascending order.
+		const std::vector<KeyBase>& keys() const { return keys_; }
+		size_t size() const { return keys_.size(); } ///< Number of keys
+
+		/// `K` is a `KeyBase` or `KeyView`. @return The index of `k` in `keys()`, or `size()` if it is absent.
+		template<typename K>
+		std::size_t indexOf(const K& k) const {
+			// No more than a handful of keys: scanning cached hashes beats bisecting strings.
+			const KeyBaseEqual eq;
+			for(std::size_t i = 0; i < keys_.size(); ++i) {
+				if(eq(keys_[i], k)) {
+					return i;
+				}
+			}
+			return keys_.size();
+		}
+
+		/// @pre `k` is absent. @return The shape with `k` added, and the index of `k` in it.
+		std::pair<const Shape*, std::size_t> with(const KeyBase &k) const;
+		/// @pre `i < size()`. @return The shape with `keys()[i]` removed, and `i`.
+		std::pair<const Shape*, std::size_t> without(std::size_t i) const;
+	};
+}
+
+/******************************************************
+ * A `DynamicHMap` alternative for small maps (up to a
+ * dozen or so keys) which are built over and over with
+ * similar key sets.
+ *
+ * Each map holds just a pointer to its `detail::Shape`,
+ * which is shared by every map with the same keys, and a
+ * dense array of values, one per key and in key order.
+ * Lookups scan the shape's (cache-hot) keys, comparing
+ * cached hashes, and adding or removing a key follows one
+ * of the shape's cached transitions, so neither builds
+ * nor frees any per-map nodes.
+ *
+ * @warning References to values are invalidated by any
+ * insertion or erasure.
+ ******************************************************/
+class ShapedDynamicHMap : public detail::DynamicHMapBase {
+  public:
+	using const_reference = std::pair<const detail::KeyBase&, const std::any&>; ///< Type-unsafe key-value pairs.
+
+  private:
+	const detail::Shape *shape_ = &detail::Shape::empty();
+	std::vector<std::any> values_; ///< `values_[i]` is mapped by `shape_->keys()[i]`.
+
+	static constexpr std::size_t kMinCapacity = 4; ///< Skip the smallest reallocations while a map is being built up.
+
+	/// Insert a new value for a key which is known to be absent.
+	template<typename V, typename ...Args>
+	V& append(const detail::Key<V>& k, Args&& ...args) {
+		std::any value{std::in_place_type<V>, std::forward<Args>(args)...};
+		const auto [next, i] = shape_->with(k);
+		if(values_.capacity() == values_.size()) {
+			values_.reserve(std::max<std::size_t>(kMinCapacity, 2 * values_.size()));
+		}
+		values_.insert(values_.begin() + i, std::move(value));
+		shape_ = next;
+		return *std::any_cast<V>(&values_[i]);
+	}
+
+	/// Functor for use with boost::transform_iterator
+	struct EntryMaker {
+		const ShapedDynamicHMap *map;
+		const_reference operator()(std::size_t i) const {
+			return const_reference(map->shape_->keys()[i], map->values_[i]);
+		}
+	};
+
+  public:
+	using const_iterator = boost::transform_iterator<EntryMaker, boost::counting_iterator<std::size_t> >; ///< const iterator over contents, in key order.
+
+	ShapedDynamicHMap() = default;
+
+	/// Copy the contents of `m`.
+	template<typename Backend>
+	explicit ShapedDynamicHMap(const BasicDynamicHMap<Backend>& m) {
+		std::vector<std::pair<detail::KeyBase, std::any> > staging(m.cbegin(), m.cend());
+		std::sort(staging.begin(), staging.end(), [](const auto& l, const auto& r) { return l.first < r.first; });
+		std::vector<detail::KeyBase> keys;
+		keys.reserve(staging.size());
+		values_.reserve(staging.size());
+		for(auto& [key, value] : staging) {
+			keys.push_back(key);
+			values_.push_back(std::move(value));
+		}
+		shape_ = &detail::Shape::of(std::move(keys));
+	}
+
+	/// Find the `V` mapped by `k`, if present.
+	template<typename V>
+	boost::optional<const V&> operator()(const detail::Key<V>& k) const {
+		const std::size_t i = shape_->indexOf(static_cast<const detail::KeyBase&>(k));
+		return (i != values_.size()) ? boost::optional<const V&>(*std::any_cast<V>(&values_[i])) : boost::none;
+	}
+
+	/// Find the `V` mapped by `k`, if present.
+	template<typename V>
+	boost::optional<V&> operator()(const detail::Key<V>& k) {
+		const std::size_t i = shape_->indexOf(static_cast<const detail::KeyBase&>(k));
+		return (i != values_.size()) ? boost::optional<V&>(*std::any_cast<V>(&values_[i])) : boost::none;
+	}
+
+	/// Find the `V` mapped by `(k, tag)`, if present, without building a `detail::Key`.
+	template<typename V>
+	boost::optional<const V&> operator()(std::string_view k, const KeyTag<V>& tag) const {
+		const std::size_t i = shape_->indexOf(detail::KeyView(k, tag));
+		return (i != values_.size()) ? boost::optional<const V&>(*std::any_cast<V>(&values_[i])) : boost::none;
+	}
+
+	/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of optional references.
+	template <typename... Vs>
+	auto operator()(multi_tag, const detail::Key<Vs>& ...ks) {
+		return std::make_tuple((*this)(ks)...);
+	}
+
+	/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of optional references.
+	template <typename... Vs>
+	auto operator()(multi_tag, const detail::Key<Vs>& ...ks) const {
+		return std::make_tuple((*this)(ks)...);
+	}
+
+	/// Find a matching key value pair, _or_ default construct one, and return a reference to the value
+	template<typename V>
+	V& operator[](const detail::Key<V>& k) {
+		const std::size_t i = shape_->indexOf(static_cast<const detail::KeyBase&>(k));
+		return (i != values_.size()) ? *std::any_cast<V>(&values_[i]) : append(k);
+	}
+
+	/// Find a matching key value pair and return a reference to the value
+	template<typename V>
+	V& at(const detail::Key<V>& k) {
+		const boost::optional<V&> found = (*this)(k);
+		if(!found) {
+			keyNotFound(k);
+		}
+		return *found;
+	}
+	/// Find a matching key value pair and return a reference to the value
+	template<typename V>
+	const V& at(const detail::Key<V>& k) const {
+		const boost::optional<const V&> found = (*this)(k);
+		if(!found) {
+			keyNotFound(k);
+		}
+		return *found;
+	}
+	/// Find a matching key value pair and return a `const` reference to the type-erased value.
+	const std::any& at(const detail::KeyBase& kb) const {
+		const std::size_t i = shape_->indexOf(kb);
+		if(i == values_.size()) {
+			keyNotFound(kb);
+		}
+		return values_[i];
+	}
+	/// As for `at(k)`, but reports a miss as `LookupError::KeyNotFound` rather than throwing.
+	template<typename V>
+	LookupResult<V&> try_at(const detail::Key<V>& k) {
+		const std::size_t i = shape_->indexOf(static_cast<const detail::KeyBase&>(k));
+		if(i == values_.size()) {
+			return LookupError::KeyNotFound;
+		}
+		return *std::any_cast<V>(&values_[i]);
+	}
+	/// As for `at(k)`, but reports a miss as `LookupError::KeyNotFound` rather than throwing.
+	template<typename V>
+	LookupResult<const V&> try_at(const detail::Key<V>& k) const {
+		const std::size_t i = shape_->indexOf(static_cast<const detail::KeyBase&>(k));
+		if(i == values_.size()) {
+			return LookupError::KeyNotFound;
+		}
+		return *std::any_cast<V>(&values_[i]);
+	}
+
+	/// cf. `std::map::try_emplace`, but returns a reference to the mapped value rather than an iterator.
+	template<typename V, typename ...Args>
+	std::pair<V&, bool> try_emplace(const detail::Key<V>& k, Args&& ...args) {
+		const std::size_t i = shape_->indexOf(static_cast<const detail::KeyBase&>(k));
+		if(i != values_.size()) {
+			return {*std::any_cast<V>(&values_[i]), false};
+		}
+		return {append(k, std::forward<Args>(args)...), true};
+	}
+	/// cf. `std::map::insert_or_assign`, but returns a reference to the mapped value rather than an iterator.
+	template<typename V, typename A>
+	std::pair<V&, bool> insert_or_assign(const detail::Key<V>& k, A&& a) {
+		const std::size_t i = shape_->indexOf(static_cast<const detail::KeyBase&>(k));
+		if(i != values_.size()) {
+			V& v = *std::any_cast<V>(&values_[i]);
+			v = std::forward<A>(a);
+			return {v, false};
+		}
+		return {append(k, std::forward<A>(a)), true};
+	}
+
+	/// cf. `std::map::erase`.
+	template<typename V>
+	size_t erase(const detail::Key<V>& k) {
+		const std::size_t i = shape_->indexOf(static_cast<const detail::KeyBase&>(k));
+		if(i == values_.size()) {
+			return 0;
+		}
+		const detail::Shape *next = shape_->without(i).first;
+		values_.erase(values_.begin() + i);
+		shape_ = next;
+		return 1;
+	}
+
+	/// Copy the contents into a `DynamicHMap`, in O(N) time.
+	DynamicHMap toMap() const {
+		return DynamicHMap(sorted_unique, cbegin(), cend());
+	}
+
+	const_iterator cbegin() const { return const_iterator(boost::counting_iterator<std::size_t>(0), EntryMaker{this}); }
+	const_iterator cend() const { return const_iterator(boost::counting_iterator<std::size_t>(values_.size()), EntryMaker{this}); }
+
+	/// The shape shared by every map with the same keys.
+	const detail::Shape& shape() const { return *shape_; }
+
+	size_t size() const { return values_.size(); } ///< Number of entries
+	bool empty() const { return values_.empty(); } ///< `true` if `size() == 0`, `false` otherwise.
+	/// Clear the map, retaining value capacity.
+	void clear() {
+		values_.clear();
+		shape_ = &detail::Shape::empty();
+	}
+};
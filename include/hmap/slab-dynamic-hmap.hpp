@@ -0,0 +1,329 @@
+#pragma once
+/************************************************************************************
+ * @file slab-dynamic-hmap.hpp A variant of @ref dynamic-hmap.hpp which stores mapped
+ * values in contiguous, per-type "slabs" rather than one `std::any` per entry.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/optional/optional.hpp>
+
+#include <hmap/dynamic-hmap.hpp>
+
+namespace detail {
+	/// Type-erased base class for `Slab`.
+	struct SlabBase {
+		virtual ~SlabBase() = default;
+		virtual std::unique_ptr<SlabBase> clone() const = 0;
+		/// Remove the value at `i`, moving the last value into its place. @return The key whose value moved.
+		virtual const KeyBase* swapRemove(std::size_t i) = 0;
+		virtual void clear() = 0;
+	};
+
+	/// A `bool` in a `Slab<bool>`, which would otherwise be a `std::vector<bool>`, whose elements can't be referenced.
+	struct SlabBool {
+		bool value = false;
+
+		SlabBool() = default;
+		SlabBool(bool v) : value(v) {}
+		operator bool() const { return value; }
+	};
+
+	/// How a `Slab<V>` stores each `V`: as itself, except for `bool`.
+	template<typename V>
+	struct SlabStorage {
+		using type = V;
+		static V& get(V& v) { return v; }
+		static const V& get(const V& v) { return v; }
+	};
+	template<>
+	struct SlabStorage<bool> {
+		using type = SlabBool;
+		static bool& get(SlabBool& b) { return b.value; }
+		static const bool& get(const SlabBool& b) { return b.value; }
+	};
+
+	/// Contiguous storage for every value of type `V` in a `BasicSlabDynamicHMap`, and the keys that own them.
+	template<typename V>
+	struct Slab : SlabBase {
+		std::vector<typename SlabStorage<V>::type> values; ///< The mapped values, in no particular order.
+		std::vector<KeyBase> owners; ///< `owners[i]` maps to `values[i]`.
+
+		/// The value at `i`.
+		V& at(std::size_t i) { return SlabStorage<V>::get(values[i]); }
+		const V& at(std::size_t i) const { return SlabStorage<V>::get(values[i]); }
+
+		std::unique_ptr<SlabBase> clone() const override {
+			return std::make_unique<Slab<V> >(*this);
+		}
+		const KeyBase* swapRemove(std::size_t i) override {
+			const bool moved = (i + 1 != values.size());
+			if(moved) {
+				values[i] = std::move(values.back());
+				owners[i] = std::move(owners.back());
+			}
+			values.pop_back();
+			owners.pop_back();
+			return moved ? &owners[i] : nullptr;
+		}
+		void clear() override {
+			values.clear();
+			owners.clear();
+		}
+	};
+
+	/// Ordered index for `SlabDynamicHMap`.
+	using OrderedIndexStore = std::map<KeyBase, std::size_t, KeyBaseLess>;
+	/// Hashed index for `HashedSlabDynamicHMap`.
+	using HashedIndexStore = FlatHashMap<KeyBase, std::size_t, KeyHash, KeyBaseEqual>;
+}
+
+/******************************************************
+ * A `BasicDynamicHMap` alternative which keeps all values
+ * of each type `V` together in a `detail::Slab<V>`, a
+ * contiguous `std::vector<V>` (of `detail::SlabBool`s for
+ * `bool`, rather than a `std::vector<bool>`, so that
+ * values can be referenced). The backing `Backend`
+ * then only maps each `detail::KeyBase` to an index into
+ * its type's slab.
+ *
+ * Compared to one `std::any` per entry, this performs
+ * far fewer allocations, and iterating all of the values
+ * of a single type (via `values<V>()`) is a linear scan.
+ * Since a `detail::Key<V>` already proves the type of its
+ * mapped value, typed access performs no checked casts.
+ *
+ * @warning As with `std::vector`, references to values of
+ * type `V` are invalidated by any insertion or erasure of
+ * another value of type `V`.
+ *
+ * @note Type-erased stores (cf.
+ * `BasicDynamicHMap::unsafe_insert_or_assign`) are not
+ * supported, since there is nowhere to put a value whose
+ * type is only known at runtime.
+ ******************************************************/
+template<typename Backend>
+class BasicSlabDynamicHMap : public detail::DynamicHMapBase {
+	using Slabs = std::vector<std::pair<const detail::KeyTagBase*, std::unique_ptr<detail::SlabBase> > >;
+
+	Backend index_; ///< Maps keys to indices into their type's slab.
+	Slabs slabs_; ///< One slab per type, searched linearly since there are typically only a handful.
+
+	/// @return The slab for `tag`, or `nullptr` if no value of that type has been stored.
+	detail::SlabBase* findSlab(const detail::KeyTagBase& tag) const {
+		for(const auto& [slabTag, slab] : slabs_) {
+			if(slabTag == &tag) {
+				return slab.get();
+			}
+		}
+		return nullptr;
+	}
+
+	template<typename V>
+	detail::Slab<V>* findSlab() const {
+		// No check required: slabs are only ever stored against their own `KeyTag`.
+		return static_cast<detail::Slab<V>*>(findSlab(KeyTag<V>::tag()));
+	}
+
+	template<typename V>
+	detail::Slab<V>& slab() {
+		if(detail::Slab<V>* found = findSlab<V>()) {
+			return *found;
+		}
+		slabs_.emplace_back(&KeyTag<V>::tag(), std::make_unique<detail::Slab<V> >());
+		return static_cast<detail::Slab<V>&>(*slabs_.back().second);
+	}
+
+	/// Insert a new value for a key which is known to be absent, popping the slab back to its old size on failure.
+	template<typename V, typename ...Args>
+	V& append(const detail::Key<V>& k, Args&& ...args) {
+		detail::Slab<V>& s = slab<V>();
+		struct Rollback {
+			detail::Slab<V> *slab;
+			std::size_t size;
+			~Rollback() {
+				if(slab) {
+					if(slab->values.size() > size) {
+						slab->values.pop_back();
+					}
+					if(slab->owners.size() > size) {
+						slab->owners.pop_back();
+					}
+				}
+			}
+		} rollback{&s, s.values.size()};
+		s.values.emplace_back(std::forward<Args>(args)...);
+		s.owners.emplace_back(k);
+		index_.try_emplace(k, s.values.size() - 1);
+		rollback.slab = nullptr;
+		return s.at(s.values.size() - 1);
+	}
+
+  public:
+	BasicSlabDynamicHMap() = default;
+	BasicSlabDynamicHMap(BasicSlabDynamicHMap &&) = default;
+	BasicSlabDynamicHMap& operator=(BasicSlabDynamicHMap &&) = default;
+	BasicSlabDynamicHMap(const BasicSlabDynamicHMap &other)
+	: index_(other.index_) {
+		slabs_.reserve(other.slabs_.size());
+		for(const auto& [tag, slab] : other.slabs_) {
+			slabs_.emplace_back(tag, slab->clone());
+		}
+	}
+	BasicSlabDynamicHMap& operator=(const BasicSlabDynamicHMap &other) {
+		if(this != &other) {
+			BasicSlabDynamicHMap copy(other);
+			*this = std::move(copy);
+		}
+		return *this;
+	}
+
+	/// Find the `V` mapped by `k`, if present.
+	template<typename V>
+	boost::optional<const V&> operator()(const detail::Key<V>& k) const {
+		const auto found = index_.find(k);
+		return ((index_.end() != found)
+		         ? boost::optional<const V&>(findSlab<V>()->at(found->second))
+		         : boost::none);
+	}
+
+	/// Find the `V` mapped by `k`, if present.
+	template<typename V>
+	boost::optional<V&> operator()(const detail::Key<V>& k) {
+		const auto found = index_.find(k);
+		return ((index_.end() != found)
+		         ? boost::optional<V&>(findSlab<V>()->at(found->second))
+		         : boost::none);
+	}
+
+	/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of optional references.
+	template <typename... Vs>
+	auto operator()(multi_tag, const detail::Key<Vs>& ...ks) {
+		return std::make_tuple((*this)(ks)...);
+	}
+
+	/// Convenience method to lookup multiple keys simultaneously. Returns a tuple of optional references.
+	template <typename... Vs>
+	auto operator()(multi_tag, const detail::Key<Vs>& ...ks) const {
+		return std::make_tuple((*this)(ks)...);
+	}
+
+	/// Find a matching key value pair, _or_ default construct one, and return a reference to the value
+	template<typename V>
+	V& operator[](const detail::Key<V>& k) {
+		const auto found = index_.find(k);
+		return (index_.end() != found) ? findSlab<V>()->at(found->second) : append(k);
+	}
+
+	/// Find a matching key value pair and return a reference to the value
+	template<typename V>
+	V& at(const detail::Key<V>& k) {
+		const auto found = index_.find(k);
+		if(index_.end() == found) {
+			keyNotFound(k);
+		}
+		return findSlab<V>()->at(found->second);
+	}
+	/// Find a matching key value pair and return a reference to the value
+	template<typename V>
+	const V& at(const detail::Key<V>& k) const {
+		const auto found = index_.find(k);
+		if(index_.end() == found) {
+			keyNotFound(k);
+		}
+		return findSlab<V>()->at(found->second);
+	}
+
+	/// cf. `std::map::try_emplace`, but returns a reference to the mapped value rather than an iterator.
+	template<typename V, typename ...Args>
+	std::pair<V&, bool> try_emplace(const detail::Key<V>& k, Args&& ...args) {
+		const auto found = index_.find(k);
+		if(index_.end() != found) {
+			return {findSlab<V>()->at(found->second), false};
+		}
+		return {append(k, std::forward<Args>(args)...), true};
+	}
+	/// cf. `std::map::insert_or_assign`, but returns a reference to the mapped value rather than an iterator.
+	template<typename V, typename A>
+	std::pair<V&, bool> insert_or_assign(const detail::Key<V>& k, A&& a) {
+		const auto found = index_.find(k);
+		if(index_.end() != found) {
+			V& v = findSlab<V>()->at(found->second);
+			v = std::forward<A>(a);
+			return {v, false};
+		}
+		return {append(k, std::forward<A>(a)), true};
+	}
+
+	/// cf. `std::map::erase`. Relocates at most one other value of type `V`.
+	template<typename V>
+	size_t erase(const detail::Key<V>& k) {
+		const auto found = index_.find(k);
+		if(index_.end() == found) {
+			return 0;
+		}
+		const std::size_t i = found->second;
+		index_.erase(found);
+		if(const detail::KeyBase* moved = findSlab<V>()->swapRemove(i)) {
+			index_.find(*moved)->second = i;
+		}
+		return 1;
+	}
+
+	/// All values of type `V`, contiguously, in no particular order.
+	template<typename V>
+	const std::vector<typename detail::SlabStorage<V>::type>& values() const {
+		static const std::vector<typename detail::SlabStorage<V>::type> none;
+		const detail::Slab<V>* s = findSlab<V>();
+		return s ? s->values : none;
+	}
+	/// The keys owning `values<V>()`, index-for-index.
+	template<typename V>
+	const std::vector<detail::KeyBase>& keys() const {
+		static const std::vector<detail::KeyBase> none;
+		const detail::Slab<V>* s = findSlab<V>();
+		return s ? s->owners : none;
+	}
+
+	/// Iterate over keys (mapped to their slab indices), in `Backend` order.
+	auto cbegin() const { return index_.cbegin(); }
+	/// Iterate over keys (mapped to their slab indices), in `Backend` order.
+	auto cend() const { return index_.cend(); }
+
+	size_t size() const { return index_.size(); } ///< Number of entries
+	bool empty() const { return index_.empty(); } ///< `true` if `size() == 0`, `false` otherwise.
+	/// Clear the map, retaining slab capacity.
+	void clear() {
+		index_.clear();
+		for(auto& [tag, slab] : slabs_) {
+			slab->clear();
+		}
+	}
+};
+
+/// `BasicSlabDynamicHMap` ordered by `detail::KeyBase::operator<`.
+using SlabDynamicHMap = BasicSlabDynamicHMap<detail::OrderedIndexStore>;
+/// `BasicSlabDynamicHMap` indexed by an open-addressing hash table.
+using HashedSlabDynamicHMap = BasicSlabDynamicHMap<detail::HashedIndexStore>;
@@ -0,0 +1,304 @@
+#pragma once
+/************************************************************************************
+ * @file tracked-dynamic-hmap.hpp Dynamic maps which record the keys changed since
+ * they were last replicated, and the patches which replay those changes elsewhere.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/optional/optional.hpp>
+
+#include <hmap/dynamic-hmap.hpp>
+#include <hmap/mapped-dynamic-hmap.hpp>
+
+/******************************************************
+ * The changes made to a map: the entries set (or
+ * reset), and the keys erased. `serialize` writes both
+ * out, to replicate the changes to another process
+ * (cf. `deserialize_patch`), at a cost proportional to
+ * the number of keys changed rather than to the size
+ * of the map.
+ ******************************************************/
+struct DynamicHMapPatch {
+	DynamicHMap upserts; ///< Current values of the keys set.
+	std::vector<detail::KeyBase> erased; ///< Keys removed.
+
+	/// `true` if applying the patch would change nothing.
+	bool empty() const {
+		return upserts.empty() && erased.empty();
+	}
+};
+
+namespace detail {
+	constexpr std::uint32_t kErasedMagic = 0x4c454448u; ///< "HDEL" when written little-endian.
+
+	/// Header of the block of erased keys following a patch's `upserts` record. Each key follows as its type's `KeyTagBase::id` (8 bytes), its name's size (4 bytes), then its name.
+	struct ErasedHeader {
+		std::uint32_t magic; ///< `kErasedMagic`
+		std::uint32_t count; ///< Number of keys.
+		std::uint64_t size; ///< Size of the whole block, including padding to `kMappedAlign`.
+	};
+	static_assert(sizeof(ErasedHeader) == 16, "Unexpected padding in patch format");
+
+	/// Append the bytes of `v` to `out`, in native byte order.
+	template<typename T>
+	void appendRaw(std::string &out, const T &v) {
+		out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+	}
+
+	/// Read a `T` from `*p`, advancing `*p`, if it fits before `end`.
+	template<typename T>
+	bool readRaw(const char *&p, const char *end, T &v) {
+		if(std::size_t(end - p) < sizeof(T)) {
+			return false;
+		}
+		std::memcpy(&v, p, sizeof(T));
+		p += sizeof(T);
+		return true;
+	}
+
+	[[noreturn]] inline void malformedPatch(const char *what) {
+		fail(std::invalid_argument(std::string("deserialize_patch: ") + what));
+	}
+}
+
+/******************************************************
+ * Append `patch` to `out`: `upserts` as one record (cf.
+ * `serialize`), then a block of the erased keys, each
+ * written as its name and the stable id of its type
+ * (`detail::KeyTagBase::id`), so that erasing a key
+ * doesn't need its type registered with `TypeRegistry`.
+ * Both are padded to `detail::kMappedAlign`, so patches
+ * may be concatenated like records.
+ * @throws std::invalid_argument as for `serialize`.
+ ******************************************************/
+inline void serialize(const DynamicHMapPatch &patch, std::string &out) {
+	serialize(patch.upserts, out);
+	const std::size_t base = out.size();
+	detail::appendRaw(out, detail::ErasedHeader{detail::kErasedMagic, std::uint32_t(patch.erased.size()), 0});
+	for(const detail::KeyBase &k : patch.erased) {
+		const std::string_view name = k.key.view();
+		detail::appendRaw(out, k.tag.get().id);
+		detail::appendRaw(out, std::uint32_t(name.size()));
+		out.append(name);
+	}
+	out.resize(base + (out.size() - base + detail::kMappedAlign - 1) / detail::kMappedAlign * detail::kMappedAlign, '\0');
+	const std::uint64_t size = out.size() - base;
+	std::memcpy(&out[base + offsetof(detail::ErasedHeader, size)], &size, sizeof(size));
+}
+
+/******************************************************
+ * Read a patch written by `serialize(const
+ * DynamicHMapPatch&, ...)` from the start of `data`,
+ * which must be aligned as for `MappedDynamicHMapView`.
+ * Erased keys whose type isn't in use in this process
+ * (cf. `KeyTagRegistry`) are dropped, since no map here
+ * can hold them.
+ * @return The patch, and the number of bytes it occupied
+ * (i.e. the offset of whatever follows it).
+ * @throws std::invalid_argument if the patch is
+ * malformed or truncated, or an erased key's type id
+ * is shared by several types in use.
+ ******************************************************/
+inline std::pair<DynamicHMapPatch, std::size_t> deserialize_patch(const void *data, std::size_t size) {
+	DynamicHMapPatch patch;
+	const MappedDynamicHMapView upserts(data, size);
+	patch.upserts = upserts.toMutable();
+	const char *base = static_cast<const char*>(data) + upserts.record_size();
+	const char *end = static_cast<const char*>(data) + size;
+	const char *p = base;
+	detail::ErasedHeader header;
+	if(!detail::readRaw(p, end, header) || header.magic != detail::kErasedMagic) {
+		detail::malformedPatch("missing erased keys");
+	} else if(header.size < sizeof(header) || header.size > std::size_t(end - base) || header.size % detail::kMappedAlign) {
+		detail::malformedPatch("bad erased keys size");
+	}
+	end = base + header.size;
+	patch.erased.reserve(header.count);
+	for(std::uint32_t i = 0; i < header.count; ++i) {
+		std::uint64_t id = 0;
+		std::uint32_t nameSize = 0;
+		if(!detail::readRaw(p, end, id) || !detail::readRaw(p, end, nameSize) || nameSize > std::size_t(end - p)) {
+			detail::malformedPatch("truncated erased key");
+		}
+		const std::string_view name(p, nameSize);
+		p += nameSize;
+		const std::vector<const detail::KeyTagBase*> tags = KeyTagRegistry::find(id);
+		if(tags.size() > 1) {
+			detail::malformedPatch("erased key's type id is ambiguous");
+		} else if(!tags.empty()) {
+			patch.erased.emplace_back(name, *tags.front());
+		}
+	}
+	return {std::move(patch), upserts.record_size() + header.size};
+}
+
+/// Apply `patch` to `m`: set every entry of `patch.upserts`, then erase every key in `patch.erased`.
+template<typename Backend>
+void apply_patch(BasicDynamicHMap<Backend>& m, const DynamicHMapPatch& patch) {
+	for(auto it = patch.upserts.cbegin(); it != patch.upserts.cend(); ++it) {
+		// Safe: `upserts` is a well-typed map, so each value matches its key's tag.
+		m.unsafe_insert_or_assign(it->first, it->second);
+	}
+	for(const detail::KeyBase& k : patch.erased) {
+		m.erase(k);
+	}
+}
+
+/******************************************************
+ * A `BasicDynamicHMap` which records the key of every
+ * entry it might have changed (its "dirty set") since
+ * the last `clear_dirty()`, so that `diff()` can produce
+ * a `DynamicHMapPatch` of just those entries.
+ *
+ * Reads go through the `const` interface of `map()`.
+ * Writes go through the members below, each of which
+ * marks its key dirty: a key is dirty if it *might*
+ * have changed, e.g. because `operator[]` or `modify`
+ * handed out a mutable reference to its value.
+ *
+ * @tparam Backend As for `BasicDynamicHMap`.
+ ******************************************************/
+template<typename Backend>
+class BasicTrackedDynamicHMap {
+  public:
+	using Map = BasicDynamicHMap<Backend>; ///< The tracked map.
+
+  private:
+	Map map_;
+	std::set<detail::KeyBase> dirty_; ///< Keys changed since `clear_dirty()`.
+
+  public:
+	BasicTrackedDynamicHMap() = default;
+	/// Track changes to `m`, which start out clean.
+	explicit BasicTrackedDynamicHMap(Map m) : map_(std::move(m)) {}
+
+	/// The tracked map, for reading.
+	const Map& map() const { return map_; }
+
+	/// As for `BasicDynamicHMap::operator()`.
+	template<typename V>
+	boost::optional<const V&> operator()(const detail::Key<V>& k) const {
+		return map_(k);
+	}
+
+	/// As for `BasicDynamicHMap::at`.
+	template<typename V>
+	const V& at(const detail::Key<V>& k) const {
+		return map_.at(k);
+	}
+
+	size_t size() const { return map_.size(); } ///< Number of entries
+	bool empty() const { return map_.empty(); } ///< `true` if `size() == 0`, `false` otherwise.
+
+	/// As for `BasicDynamicHMap::operator[]`, marking `k` dirty.
+	template<typename V>
+	V& operator[](const detail::Key<V>& k) {
+		dirty_.insert(k);
+		return map_[k];
+	}
+
+	/// A mutable reference to the value of `k`, if present, marking `k` dirty.
+	template<typename V>
+	boost::optional<V&> modify(const detail::Key<V>& k) {
+		boost::optional<V&> found = map_(k);
+		if(found) {
+			dirty_.insert(k);
+		}
+		return found;
+	}
+
+	/// As for `BasicDynamicHMap::insert_or_assign`, marking `k` dirty.
+	template<typename V, typename A>
+	auto insert_or_assign(const detail::Key<V>& k, A&& a) {
+		dirty_.insert(k);
+		return map_.insert_or_assign(k, std::forward<A>(a));
+	}
+
+	/// As for `BasicDynamicHMap::try_emplace`, marking `k` dirty if it was inserted.
+	template<typename V, typename ...Args>
+	auto try_emplace(const detail::Key<V>& k, Args&& ...args) {
+		auto result = map_.try_emplace(k, std::forward<Args>(args)...);
+		if(result.second) {
+			dirty_.insert(k);
+		}
+		return result;
+	}
+
+	/// As for `BasicDynamicHMap::erase`, marking `k` dirty if it was present.
+	template<typename V>
+	size_t erase(const detail::Key<V>& k) {
+		const size_t erased = map_.erase(k);
+		if(erased) {
+			dirty_.insert(k);
+		}
+		return erased;
+	}
+
+	/// Apply `patch` (cf. `::apply_patch`), marking every key it touches dirty.
+	void apply_patch(const DynamicHMapPatch& patch) {
+		::apply_patch(map_, patch);
+		for(auto it = patch.upserts.cbegin(); it != patch.upserts.cend(); ++it) {
+			dirty_.insert(it->first);
+		}
+		dirty_.insert(patch.erased.begin(), patch.erased.end());
+	}
+
+	/// The keys changed since the last `clear_dirty()`, in key order.
+	const std::set<detail::KeyBase>& dirty() const { return dirty_; }
+
+	/// Forget every change so far, e.g. once they have been replicated.
+	void clear_dirty() { dirty_.clear(); }
+
+	/************************************************************
+	 * The changes since the last `clear_dirty()`, as a patch:
+	 * dirty keys still present are set to their current values,
+	 * and the rest are erased. Applying it to a copy of the map
+	 * as it was at that `clear_dirty()` reproduces the map now.
+	 * Takes O(D log N) time for D dirty keys.
+	 ************************************************************/
+	DynamicHMapPatch diff() const {
+		DynamicHMapPatch patch;
+		std::vector<std::pair<detail::KeyBase, std::any> > upserts;
+		for(const detail::KeyBase& k : dirty_) {
+			const auto found = map_.find(k);
+			if(map_.cend() == found) {
+				patch.erased.push_back(k);
+			} else {
+				upserts.emplace_back(found->first, found->second);
+			}
+		}
+		// `dirty_` is ordered, so the upserts are already sorted, and unique.
+		patch.upserts = DynamicHMap(DynamicHMap::sorted_unique, upserts.begin(), upserts.end());
+		return patch;
+	}
+};
+
+/// `BasicTrackedDynamicHMap` of a `DynamicHMap`.
+using TrackedDynamicHMap = BasicTrackedDynamicHMap<detail::OrderedStore>;
+/// `BasicTrackedDynamicHMap` of a `HashedDynamicHMap`.
+using TrackedHashedDynamicHMap = BasicTrackedDynamicHMap<detail::HashedStore>;
@@ -0,0 +1,61 @@
+#pragma once
+/************************************************************************************
+ * @file type-id.hpp Compile-time identifiers for types, which are the same in every
+ * process (built by the same compiler), for ordering and hashing @ref dynamic-hmap.hpp
+ * keys without relying on addresses.
+ *
+ * @author Thomas Dickerson
+ * @copyright 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <cstdint>
+#include <string_view>
+
+namespace detail {
+	/// FNV-1a, 64 bit.
+	constexpr std::uint64_t fnv1a(std::string_view s) {
+		std::uint64_t h = 0xCBF29CE484222325ull;
+		for(char c : s) {
+			h = (h ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+		}
+		return h;
+	}
+
+	/****************************************************
+	 * A compile-time spelling of `V`: the signature of
+	 * this function, as the compiler prints it, which
+	 * names `V` in full. Not demangled or trimmed, so
+	 * only meaningful as the input to `typeId`.
+	 * 
+	 * Identical for every translation unit (and process)
+	 * built by the same compiler, unlike `typeid(V)`,
+	 * which is neither constexpr nor comparable across
+	 * processes.
+	 ****************************************************/
+	template<typename V>
+	constexpr std::string_view typeSignature() {
+#if defined(_MSC_VER) && !defined(__clang__)
+		return __FUNCSIG__;
+#else
+		return __PRETTY_FUNCTION__;
+#endif
+	}
+
+	/// A 64 bit hash of `typeSignature<V>()`. Distinct types collide if they are spelled alike (e.g. in anonymous namespaces), and are otherwise very unlikely to.
+	template<typename V>
+	constexpr std::uint64_t typeId = fnv1a(typeSignature<V>());
+}
@@ -20,27 +20,84 @@
 
 #include <hmap/dynamic-hmap.hpp>
 
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 
-DynamicHMap::iterator DynamicHMap::begin() {
-	return map_.begin();
+#ifdef HMAP_NO_EXCEPTIONS
+#include <boost/throw_exception.hpp>
+#endif
+
+template class BasicDynamicHMap<detail::OrderedStore>;
+template class BasicDynamicHMap<detail::HashedStore>;
+template class BasicDynamicHMap<detail::PmrOrderedStore>;
+template class BasicDynamicHMap<detail::PmrHashedStore>;
+template class BasicDynamicHMap<detail::TagIndexedOrderedStore>;
+
+[[noreturn]] void detail::DynamicHMapBase::keyNotFound(const detail::KeyBase& k) {
+	std::stringstream msg;
+	msg << "DynamicHMap: '" << k.key << "' (type '" << k.info().name() << "') not present." << std::endl;
+	detail::fail(std::out_of_range(msg.str()));
 }
-DynamicHMap::iterator DynamicHMap::end() {
-	return map_.end();
+[[noreturn]] void detail::DynamicHMapBase::keyNotFound(const detail::KeyView& k) {
+	std::stringstream msg;
+	msg << "DynamicHMap: '" << k.key << "' (type '" << k.info().name() << "') not present." << std::endl;
+	detail::fail(std::out_of_range(msg.str()));
 }
+namespace {
+	/// Every registered `KeyTag`, one per distinct type, by `id`.
+	struct TagRegistry {
+		std::mutex mutex;
+		std::unordered_multimap<std::uint64_t, const detail::KeyTagBase*> tags;
+		std::vector<std::pair<const detail::KeyTagBase*, const detail::KeyTagBase*> > collisions;
+	};
 
-DynamicHMap::const_iterator DynamicHMap::cbegin() const {
-	return map_.cbegin();
+	/// Never destroyed, since tags register themselves during static initialization, and may be used during static destruction.
+	TagRegistry& tagRegistry() {
+		static TagRegistry *r = new TagRegistry;
+		return *r;
+	}
 }
-DynamicHMap::const_iterator DynamicHMap::cend() const {
-	return map_.cend();
+
+detail::TypeIdRegistration::TypeIdRegistration(const detail::KeyTagBase &tag) {
+	TagRegistry &r = tagRegistry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	const auto [first, last] = r.tags.equal_range(tag.id);
+	for(auto it = first; it != last; ++it) {
+		// The same type may have one tag per shared object; only distinct types are a collision.
+		if(it->second->info() == tag.info()) {
+			return;
+		}
+	}
+	for(auto it = first; it != last; ++it) {
+		r.collisions.emplace_back(it->second, &tag);
+	}
+	r.tags.emplace(tag.id, &tag);
 }
 
-size_t DynamicHMap::size() const { return map_.size(); }
-bool DynamicHMap::empty() const { return map_.empty(); }
-void DynamicHMap::clear() { map_.clear(); }
-[[noreturn]] void DynamicHMap::keyNotFound(const detail::KeyBase& k) {
-	std::stringstream msg;
-	msg << "DynamicHMap: '" << k.key << "' (type '" << k.info().name() << "') not present." << std::endl;
-	throw std::out_of_range(msg.str());
-}
\ No newline at end of file
+std::vector<const detail::KeyTagBase*> KeyTagRegistry::find(std::uint64_t id) {
+	TagRegistry &r = tagRegistry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	std::vector<const detail::KeyTagBase*> result;
+	const auto [first, last] = r.tags.equal_range(id);
+	for(auto it = first; it != last; ++it) {
+		result.push_back(it->second);
+	}
+	return result;
+}
+
+std::vector<std::pair<const detail::KeyTagBase*, const detail::KeyTagBase*> > KeyTagRegistry::collisions() {
+	TagRegistry &r = tagRegistry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	return r.collisions;
+}
+
+#ifdef HMAP_NO_EXCEPTIONS
+// Boost calls these, rather than throwing, when exceptions are disabled; clients must not define them too.
+void boost::throw_exception(const std::exception& e) {
+	::detail::fail(e);
+}
+void boost::throw_exception(const std::exception& e, const boost::source_location&) {
+	::detail::fail(e);
+}
+#endif
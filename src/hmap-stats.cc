@@ -0,0 +1,120 @@
+/************************************************************************************
+ *
+ * Author: Thomas Dickerson
+ * Copyright: 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <hmap/hmap-stats.hpp>
+
+#ifdef HMAP_ENABLE_STATS
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+	struct Registry {
+		std::mutex mutex; ///< Guards `labelled` and `spills`.
+		std::unordered_set<const detail::InstanceStats*> labelled;
+		std::unordered_map<const detail::KeyTagBase*, std::atomic<std::uint64_t>*> spills;
+		std::deque<std::atomic<std::uint64_t> > spillCounters; ///< Never relocated, so counters can be cached per type.
+		std::atomic<std::uint64_t> lookups{0}, misses{0}, inserts{0}, nodes{0}, erases{0}; ///< Retired counters.
+	};
+
+	/// Never destroyed, since maps with static storage duration may outlive any static registry.
+	Registry& registry() {
+		static Registry *r = new Registry;
+		return *r;
+	}
+}
+
+detail::InstanceStats::~InstanceStats() {
+	Registry &r = registry();
+	const DynamicHMapStats s = stats();
+	r.lookups.fetch_add(s.lookups, std::memory_order_relaxed);
+	r.misses.fetch_add(s.misses, std::memory_order_relaxed);
+	r.inserts.fetch_add(s.inserts, std::memory_order_relaxed);
+	r.nodes.fetch_add(s.nodes, std::memory_order_relaxed);
+	r.erases.fetch_add(s.erases, std::memory_order_relaxed);
+	if(!label_.empty()) {
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.labelled.erase(this);
+	}
+}
+
+void detail::InstanceStats::set_stats_label(std::string label) {
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	label_ = std::move(label);
+	r.labelled.insert(this);
+}
+
+std::atomic<std::uint64_t>& detail::spillCounter(const detail::KeyTagBase &tag) {
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	std::atomic<std::uint64_t>*& counter = r.spills[&tag];
+	if(!counter) {
+		counter = &r.spillCounters.emplace_back(0);
+	}
+	return *counter;
+}
+
+DynamicHMapStats DynamicHMapStatsRegistry::retired() {
+	Registry &r = registry();
+	DynamicHMapStats s;
+	s.lookups = r.lookups.load(std::memory_order_relaxed);
+	s.misses = r.misses.load(std::memory_order_relaxed);
+	s.inserts = r.inserts.load(std::memory_order_relaxed);
+	s.nodes = r.nodes.load(std::memory_order_relaxed);
+	s.erases = r.erases.load(std::memory_order_relaxed);
+	return s;
+}
+
+std::vector<std::pair<std::string, DynamicHMapStats> > DynamicHMapStatsRegistry::labelled() {
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	std::vector<std::pair<std::string, DynamicHMapStats> > result;
+	result.reserve(r.labelled.size());
+	for(const detail::InstanceStats *stats : r.labelled) {
+		result.emplace_back(stats->label_, stats->stats());
+	}
+	return result;
+}
+
+std::vector<std::pair<const detail::KeyTagBase*, std::uint64_t> > DynamicHMapStatsRegistry::spills() {
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	std::vector<std::pair<const detail::KeyTagBase*, std::uint64_t> > result;
+	result.reserve(r.spills.size());
+	for(const auto& [tag, counter] : r.spills) {
+		result.emplace_back(tag, counter->load(std::memory_order_relaxed));
+	}
+	return result;
+}
+#else
+DynamicHMapStats DynamicHMapStatsRegistry::retired() {
+	return {};
+}
+
+std::vector<std::pair<std::string, DynamicHMapStats> > DynamicHMapStatsRegistry::labelled() {
+	return {};
+}
+
+std::vector<std::pair<const detail::KeyTagBase*, std::uint64_t> > DynamicHMapStatsRegistry::spills() {
+	return {};
+}
+#endif
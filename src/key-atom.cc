@@ -0,0 +1,62 @@
+/************************************************************************************
+ *
+ * Author: Thomas Dickerson
+ * Copyright: 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <hmap/key-atom.hpp>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace {
+	/// Records are heap-allocated individually so their addresses survive rehashing; keys view the record's own text.
+	struct InternTable {
+		std::shared_mutex mutex;
+		std::unordered_map<std::string_view, std::unique_ptr<detail::AtomRecord> > records;
+	};
+
+	/// Never destroyed, so that atoms stay valid during static destruction and in detached threads.
+	InternTable& internTable() {
+		static InternTable *table = new InternTable;
+		return *table;
+	}
+}
+
+const detail::AtomRecord* detail::KeyAtom::intern(std::string_view s) {
+	InternTable& table = internTable();
+	{
+		std::shared_lock<std::shared_mutex> lock(table.mutex);
+		const auto found = table.records.find(s);
+		if(table.records.end() != found) {
+			return found->second.get();
+		}
+	}
+	std::unique_lock<std::shared_mutex> lock(table.mutex);
+	// Somebody else may have interned `s` while we were unlocked.
+	const auto found = table.records.find(s);
+	if(table.records.end() != found) {
+		return found->second.get();
+	}
+	auto record = std::make_unique<AtomRecord>(AtomRecord{std::string(s), std::hash<std::string_view>{}(s)});
+	const AtomRecord *retval = record.get();
+	table.records.emplace(retval->text, std::move(record));
+	return retval;
+}
@@ -0,0 +1,273 @@
+/************************************************************************************
+ *
+ * Author: Thomas Dickerson
+ * Copyright: 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <hmap/mapped-dynamic-hmap.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <system_error>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HMAP_HAVE_MMAP 1
+#else
+#include <fstream>
+#endif
+
+namespace {
+	/// Codecs are heap-allocated individually so their addresses survive rehashing.
+	struct CodecTable {
+		std::shared_mutex mutex;
+		std::unordered_map<const detail::KeyTagBase*, std::unique_ptr<detail::TypeCodec> > byTag;
+		std::unordered_map<std::uint32_t, const detail::TypeCodec*> byId;
+
+		/// Caller must hold `mutex` exclusively (or be the constructor).
+		const detail::TypeCodec& insert(detail::TypeCodec &&codec) {
+			const auto foundTag = byTag.find(codec.tag);
+			const auto foundId = byId.find(codec.id);
+			if(byTag.end() != foundTag && byId.end() != foundId && foundId->second == foundTag->second.get()) {
+				return *foundTag->second;
+			} else if(byTag.end() != foundTag || byId.end() != foundId) {
+				std::stringstream msg;
+				msg << "TypeRegistry: type '" << codec.tag->info().name() << "' or id " << codec.id << " is already registered." << std::endl;
+				detail::fail(std::invalid_argument(msg.str()));
+			}
+			auto record = std::make_unique<detail::TypeCodec>(std::move(codec));
+			const detail::TypeCodec *retval = record.get();
+			byId.emplace(retval->id, retval);
+			byTag.emplace(retval->tag, std::move(record));
+			return *retval;
+		}
+
+		CodecTable() {
+			std::uint32_t id = 1;
+			insert(detail::inPlaceCodec<bool>(id++));
+			insert(detail::inPlaceCodec<char>(id++));
+			insert(detail::inPlaceCodec<std::int8_t>(id++));
+			insert(detail::inPlaceCodec<std::int16_t>(id++));
+			insert(detail::inPlaceCodec<std::int32_t>(id++));
+			insert(detail::inPlaceCodec<std::int64_t>(id++));
+			insert(detail::inPlaceCodec<std::uint8_t>(id++));
+			insert(detail::inPlaceCodec<std::uint16_t>(id++));
+			insert(detail::inPlaceCodec<std::uint32_t>(id++));
+			insert(detail::inPlaceCodec<std::uint64_t>(id++));
+			insert(detail::inPlaceCodec<float>(id++));
+			insert(detail::inPlaceCodec<double>(id++));
+			insert(detail::TypeCodec{id++, &KeyTag<std::string>::tag(), 0, 1,
+			    [](const std::any& a, std::string& out) { out.append(std::any_cast<const std::string&>(a)); },
+			    [](std::string_view bytes) { return std::any{std::in_place_type<std::string>, bytes}; }});
+		}
+	};
+
+	CodecTable& codecTable() {
+		static CodecTable table;
+		return table;
+	}
+
+	[[noreturn]] void malformed(const char *what) {
+		detail::fail(std::invalid_argument(std::string("MappedDynamicHMapView: ") + what));
+	}
+
+	void padTo(std::string &out, std::size_t base, std::size_t align) {
+		out.resize(base + (((out.size() - base) + align - 1) / align) * align, '\0');
+	}
+}
+
+const detail::TypeCodec& TypeRegistry::insert(detail::TypeCodec &&codec) {
+	CodecTable& table = codecTable();
+	std::unique_lock<std::shared_mutex> lock(table.mutex);
+	return table.insert(std::move(codec));
+}
+
+const detail::TypeCodec* TypeRegistry::find(const detail::KeyTagBase &tag) {
+	CodecTable& table = codecTable();
+	std::shared_lock<std::shared_mutex> lock(table.mutex);
+	const auto found = table.byTag.find(&tag);
+	return (table.byTag.end() != found) ? found->second.get() : nullptr;
+}
+
+const detail::TypeCodec* TypeRegistry::find(std::uint32_t id) {
+	CodecTable& table = codecTable();
+	std::shared_lock<std::shared_mutex> lock(table.mutex);
+	const auto found = table.byId.find(id);
+	return (table.byId.end() != found) ? found->second : nullptr;
+}
+
+void detail::appendRecord(std::vector<std::pair<const KeyBase*, const std::any*> > &entries, std::string &out) {
+	struct Pending {
+		std::string_view name;
+		const TypeCodec *codec;
+		const std::any *value;
+	};
+	std::vector<Pending> pending;
+	pending.reserve(entries.size());
+	for(const auto& [kb, value] : entries) {
+		const TypeCodec *codec = TypeRegistry::find(kb->tag.get());
+		if(!codec) {
+			std::stringstream msg;
+			msg << "serialize: '" << kb->key << "' has unregistered type '" << kb->info().name() << "'." << std::endl;
+			detail::fail(std::invalid_argument(msg.str()));
+		}
+		pending.push_back(Pending{kb->key.view(), codec, value});
+	}
+	std::sort(pending.begin(), pending.end(), [](const Pending& l, const Pending& r) {
+		const int c = l.name.compare(r.name);
+		return c < 0 || (c == 0 && l.codec->id < r.codec->id);
+	});
+	if(pending.size() > std::numeric_limits<std::uint32_t>::max()) {
+		detail::fail(std::length_error("serialize: too many entries for one record"));
+	}
+
+	padTo(out, 0, kMappedAlign);
+	const std::size_t base = out.size();
+	std::vector<MappedDirEntry> dir(pending.size());
+	out.resize(base + sizeof(MappedHeader) + dir.size() * sizeof(MappedDirEntry), '\0');
+	for(std::size_t i = 0; i < pending.size(); ++i) {
+		if(out.size() - base + pending[i].name.size() > std::numeric_limits<std::uint32_t>::max()) {
+			detail::fail(std::length_error("serialize: key names too long for one record"));
+		}
+		dir[i].nameOffset = std::uint32_t(out.size() - base);
+		dir[i].nameSize = std::uint32_t(pending[i].name.size());
+		dir[i].typeId = pending[i].codec->id;
+		out.append(pending[i].name);
+	}
+	for(std::size_t i = 0; i < pending.size(); ++i) {
+		padTo(out, base, pending[i].codec->align);
+		dir[i].valueOffset = out.size() - base;
+		pending[i].codec->encode(*pending[i].value, out);
+		dir[i].valueSize = out.size() - base - dir[i].valueOffset;
+	}
+	padTo(out, base, kMappedAlign);
+
+	const MappedHeader header{kMappedMagic, kMappedVersion, 0, std::uint32_t(dir.size()), 0, out.size() - base};
+	std::memcpy(&out[base], &header, sizeof(header));
+	if(!dir.empty()) {
+		std::memcpy(&out[base + sizeof(header)], dir.data(), dir.size() * sizeof(MappedDirEntry));
+	}
+}
+
+MappedDynamicHMapView::value_type MappedDynamicHMapView::EntryReader::operator()(const detail::MappedDirEntry &e) const {
+	if(e.nameOffset > size || e.nameSize > size - e.nameOffset
+	   || e.valueOffset > size || e.valueSize > size - e.valueOffset) {
+		malformed("entry out of bounds");
+	}
+	return value_type{std::string_view(base + e.nameOffset, e.nameSize), e.typeId,
+	                  std::string_view(base + e.valueOffset, e.valueSize)};
+}
+
+MappedDynamicHMapView::MappedDynamicHMapView(const void *data, std::size_t size) {
+	const char *base = static_cast<const char*>(data);
+	if(reinterpret_cast<std::uintptr_t>(base) % detail::kMappedAlign) {
+		malformed("record is misaligned");
+	} else if(size < sizeof(detail::MappedHeader)) {
+		malformed("record is truncated");
+	}
+	header_ = reinterpret_cast<const detail::MappedHeader*>(base);
+	if(header_->magic != detail::kMappedMagic) {
+		malformed("bad magic number (or foreign byte order)");
+	} else if(header_->version != detail::kMappedVersion) {
+		malformed("unsupported version");
+	} else if(header_->size > size) {
+		malformed("record is truncated");
+	} else if(header_->size < sizeof(detail::MappedHeader) || header_->size % detail::kMappedAlign) {
+		// Also guarantees `record_size() > 0`, so walking a buffer of records always advances.
+		malformed("bad record size");
+	} else if((header_->size - sizeof(detail::MappedHeader)) / sizeof(detail::MappedDirEntry) < header_->count) {
+		malformed("directory is truncated");
+	}
+	dir_ = reinterpret_cast<const detail::MappedDirEntry*>(base + sizeof(detail::MappedHeader));
+	reader_ = EntryReader{base, std::size_t(header_->size)};
+}
+
+MappedDynamicHMapView::const_iterator MappedDynamicHMapView::lookup(std::string_view k, const detail::TypeCodec *codec) const {
+	if(!codec) {
+		return cend();
+	}
+	const std::uint32_t id = codec->id;
+	const detail::MappedDirEntry *end = dir_ + header_->count;
+	const detail::MappedDirEntry *found = std::lower_bound(dir_, end, k, [this, id](const detail::MappedDirEntry& e, std::string_view k) {
+		const int c = reader_(e).key.compare(k);
+		return c < 0 || (c == 0 && e.typeId < id);
+	});
+	if(end != found && found->typeId == id && reader_(*found).key == k) {
+		return const_iterator(found, reader_);
+	}
+	return cend();
+}
+
+MappedFile::MappedFile(const std::string &path) {
+#ifdef HMAP_HAVE_MMAP
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0) {
+		detail::fail(std::system_error(errno, std::generic_category(), path));
+	}
+	struct stat st;
+	if(::fstat(fd, &st) < 0) {
+		const int err = errno;
+		::close(fd);
+		detail::fail(std::system_error(err, std::generic_category(), path));
+	}
+	size_ = std::size_t(st.st_size);
+	if(size_ > 0) {
+		void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(MAP_FAILED == mapping) {
+			const int err = errno;
+			::close(fd);
+			detail::fail(std::system_error(err, std::generic_category(), path));
+		}
+		data_ = static_cast<const char*>(mapping);
+	}
+	::close(fd);
+#else
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	if(!in) {
+		detail::fail(std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), path));
+	}
+	size_ = std::size_t(in.tellg());
+	if(size_ > 0) {
+		char *buffer = static_cast<char*>(::operator new(size_, std::align_val_t(detail::kMappedAlign)));
+		in.seekg(0);
+		in.read(buffer, std::streamsize(size_));
+		data_ = buffer;
+	}
+#endif
+}
+
+void MappedFile::release() {
+	if(!data_) {
+		return;
+	}
+#ifdef HMAP_HAVE_MMAP
+	::munmap(const_cast<char*>(data_), size_);
+#else
+	::operator delete(const_cast<char*>(data_), std::align_val_t(detail::kMappedAlign));
+#endif
+	data_ = nullptr;
+	size_ = 0;
+}
@@ -0,0 +1,139 @@
+/************************************************************************************
+ *
+ * Author: Thomas Dickerson
+ * Copyright: 2019 - 2022, Geopipe, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************************/
+
+#include <hmap/shaped-dynamic-hmap.hpp>
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <boost/container_hash/hash.hpp>
+
+namespace {
+	/// Shapes are heap-allocated individually so their addresses survive rehashing.
+	struct ShapeTable {
+		std::shared_mutex mutex;
+		std::unordered_multimap<std::size_t, std::unique_ptr<detail::Shape> > byHash;
+	};
+
+	ShapeTable& shapeTable() {
+		static ShapeTable table;
+		return table;
+	}
+
+	std::size_t hashOf(const std::vector<detail::KeyBase> &keys) {
+		std::size_t h = keys.size();
+		for(const detail::KeyBase &k : keys) {
+			boost::hash_combine(h, k.hash);
+		}
+		return h;
+	}
+
+	/// @return The shape for `keys` in `table`, or `nullptr`. Caller must hold `table.mutex`.
+	const detail::Shape* findShape(const ShapeTable &table, std::size_t h, const std::vector<detail::KeyBase> &keys) {
+		const auto [first, last] = table.byHash.equal_range(h);
+		for(auto it = first; it != last; ++it) {
+			if(it->second->keys() == keys) {
+				return it->second.get();
+			}
+		}
+		return nullptr;
+	}
+}
+
+const detail::Shape& detail::Shape::intern(std::vector<KeyBase> &&keys) {
+	ShapeTable& table = shapeTable();
+	const std::size_t h = hashOf(keys);
+	{
+		std::shared_lock<std::shared_mutex> lock(table.mutex);
+		if(const Shape *found = findShape(table, h, keys)) {
+			return *found;
+		}
+	}
+	std::unique_lock<std::shared_mutex> lock(table.mutex);
+	// Somebody else may have interned `keys` while we were unlocked.
+	if(const Shape *found = findShape(table, h, keys)) {
+		return *found;
+	}
+	return *table.byHash.emplace(h, std::make_unique<Shape>(std::move(keys)))->second;
+}
+
+const detail::Shape& detail::Shape::empty() {
+	static const Shape& theEmpty = intern(std::vector<KeyBase>());
+	return theEmpty;
+}
+
+const detail::Shape& detail::Shape::of(std::vector<KeyBase> keys) {
+	std::sort(keys.begin(), keys.end());
+	const auto repeat = std::adjacent_find(keys.begin(), keys.end());
+	if(keys.end() != repeat) {
+		std::stringstream msg;
+		msg << "Shape: key '" << repeat->key << "' of type '" << repeat->info().name() << "' is repeated." << std::endl;
+		detail::fail(std::invalid_argument(msg.str()));
+	}
+	return intern(std::move(keys));
+}
+
+std::pair<const detail::Shape*, std::size_t> detail::Shape::follow(const KeyBase &k, bool add, std::size_t index) const {
+	const KeyBaseEqual eq;
+	const auto cached = [&](const Transition *t) -> const Transition* {
+		for(; t; t = t->next) {
+			if(t->add == add && eq(*t->key, k)) {
+				return t;
+			}
+		}
+		return nullptr;
+	};
+	if(const Transition *t = cached(transitions_.load(std::memory_order_acquire))) {
+		return {t->to, t->index};
+	}
+	std::vector<KeyBase> keys;
+	keys.reserve(keys_.size() + 1);
+	keys.assign(keys_.begin(), keys_.end());
+	if(add) {
+		index = std::lower_bound(keys.begin(), keys.end(), k) - keys.begin();
+		keys.insert(keys.begin() + index, k);
+	} else {
+		keys.erase(keys.begin() + index);
+	}
+	const Shape &to = intern(std::move(keys));
+	std::lock_guard<std::mutex> lock(mutex_);
+	// Somebody else may have cached this transition while we were unlocked.
+	const Transition *head = transitions_.load(std::memory_order_relaxed);
+	if(const Transition *t = cached(head)) {
+		return {t->to, t->index};
+	}
+	// Point at a copy of the key which lives as long as the shapes do, rather than the caller's.
+	const KeyBase *key = add ? &to.keys_[index] : &keys_[index];
+	owned_.push_back(std::make_unique<Transition>(Transition{key, add, &to, index, head}));
+	transitions_.store(owned_.back().get(), std::memory_order_release);
+	return {&to, index};
+}
+
+std::pair<const detail::Shape*, std::size_t> detail::Shape::with(const KeyBase &k) const {
+	return follow(k, true, 0);
+}
+
+std::pair<const detail::Shape*, std::size_t> detail::Shape::without(std::size_t i) const {
+	return follow(keys_[i], false, i);
+}